@@ -0,0 +1,66 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+// Times the logging calls of a hot loop at the default (warning) severity:
+//
+//     bench_logging [n_calls]
+//
+// A disabled LOG_DEBUG is compared to the same message built with an always
+// constructed MessageLogger, which is what LOG did before checking the
+// severity first.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "mamba/core/output.hpp"
+
+using namespace mamba;  // NOLINT(build/namespaces)
+
+namespace
+{
+    template <class F>
+    double time_it(F&& f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+
+    // an operand which is not free to evaluate, as a path or a package name
+    std::string operand(std::size_t i)
+    {
+        return "lib/python3.9/site-packages/pkg/module" + std::to_string(i) + ".py";
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    std::size_t n_calls = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    MessageLogger::global_log_severity() = LogSeverity::kWarning;
+
+    std::cout << n_calls << " disabled debug messages" << std::endl;
+    double always = time_it([&]() {
+        for (std::size_t i = 0; i < n_calls; ++i)
+        {
+            MessageLogger(__FILE__, __LINE__, LogSeverity::kDebug).stream()
+                << "Linking " << operand(i) << " " << i;
+        }
+    });
+    double checked = time_it([&]() {
+        for (std::size_t i = 0; i < n_calls; ++i)
+        {
+            LOG_DEBUG << "Linking " << operand(i) << " " << i;
+        }
+    });
+
+    std::cout << "MessageLogger: " << always * 1e9 / n_calls << " ns/call" << std::endl;
+    std::cout << "LOG_DEBUG: " << checked * 1e9 / n_calls << " ns/call" << std::endl;
+    return 0;
+}
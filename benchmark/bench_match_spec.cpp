@@ -0,0 +1,143 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+// Times the parsing of conda-forge dependency strings:
+//
+//     bench_match_spec [n_rounds]
+//
+// MatchSpec is compared to the std::regex searches the parser did before
+// tokenizing the specs by hand (brackets, parens, key-values and the
+// name / version split), which were its main cost.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "mamba/core/match_spec.hpp"
+
+using namespace mamba;  // NOLINT(build/namespaces)
+
+namespace
+{
+    // dependencies of conda-forge packages, as in their repodata
+    const std::vector<std::string> corpus = {
+        "_libgcc_mutex 0.1 conda_forge",
+        "_openmp_mutex >=4.5",
+        "ca-certificates",
+        "libgcc-ng >=9.3.0",
+        "libstdcxx-ng >=9.3.0",
+        "libzlib >=1.2.11,<1.3.0a0",
+        "openssl >=1.1.1k,<1.1.2a",
+        "python >=3.9,<3.10.0a0",
+        "python_abi 3.9.* *_cp39",
+        "numpy >=1.19.5,<2.0a0",
+        "libblas >=3.8.0,<4.0a0",
+        "libcblas 3.9.0 8_openblas",
+        "liblapack >=3.8.0,<4.0a0",
+        "setuptools",
+        "six >=1.5",
+        "pytz >=2017.2",
+        "python-dateutil >=2.7.3",
+        "certifi >=2020.06.20",
+        "libffi >=3.3,<3.4.0a0",
+        "ncurses >=6.2,<7.0a0",
+        "readline >=8.1,<9.0a0",
+        "sqlite >=3.35.5,<4.0a0",
+        "tk >=8.6.10,<8.7.0a0",
+        "xz >=5.2.5,<6.0a0",
+        "tzdata",
+        "pip",
+        "wheel",
+        "cudatoolkit >=11.1,<11.2",
+        "blas * openblas",
+        "libblas=*=*mkl",
+        "mkl >=2021.2.0,<2022.0a0",
+        "intel-openmp",
+        "__glibc >=2.17",
+        "__osx >=10.9",
+        "libcxx >=11.1.0",
+        "jpeg >=9d,<10a",
+        "libpng >=1.6.37,<1.7.0a0",
+        "freetype >=2.10.4,<3.0a0",
+        "pytorch 1.8.* *cuda*",
+        "conda-forge::xtensor==0.21.5=h4bd325d_0",
+        "scipy[version='>=1.5.2', build=py38*]",
+        "pyqt >=5.12 (optional)",
+    };
+
+    template <class F>
+    double time_it(F&& f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+
+    // the searches of the former parser
+    std::size_t regex_steps(const std::string& spec)
+    {
+        static std::regex brackets_re(".*(?:(\\[.*\\]))");
+        static std::regex parens_re(".*(?:(\\(.*\\)))");
+        static std::regex kv_re("([a-zA-Z0-9_-]+?)=([\"\']?)([^\'\"]*?)(\\2)(?:[\'\", ]|$)");
+        static std::regex version_build_re("([^ =<>!~]+)?([><!=~ ].+)?");
+
+        std::string spec_str = spec;
+        std::size_t found = 0;
+        std::smatch match;
+        for (const auto* re : { &brackets_re, &parens_re })
+        {
+            if (std::regex_search(spec_str, match, *re))
+            {
+                std::string group = match[1].str();
+                std::cmatch kv_match;
+                for (const char* it = group.c_str(); std::regex_search(it, kv_match, kv_re);
+                     it += kv_match.position() + kv_match.length())
+                {
+                    ++found;
+                }
+                spec_str.erase(match.position(1), match.length(1));
+            }
+        }
+        found += std::regex_match(spec_str, match, version_build_re);
+        return found;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    std::size_t n_rounds = argc > 1 ? std::atoi(argv[1]) : 2000;
+    std::size_t n_specs = n_rounds * corpus.size();
+
+    std::cout << n_specs << " specs" << std::endl;
+    std::size_t sink = 0;
+    double regex = time_it([&]() {
+        for (std::size_t i = 0; i < n_rounds; ++i)
+        {
+            for (const auto& spec : corpus)
+            {
+                sink += regex_steps(spec);
+            }
+        }
+    });
+    double parse = time_it([&]() {
+        for (std::size_t i = 0; i < n_rounds; ++i)
+        {
+            for (const auto& spec : corpus)
+            {
+                sink += MatchSpec(spec).name.size();
+            }
+        }
+    });
+
+    std::cout << "regex searches only: " << regex * 1e9 / n_specs << " ns/spec" << std::endl;
+    std::cout << "MatchSpec: " << parse * 1e9 / n_specs << " ns/spec" << std::endl;
+    return sink == 0;
+}
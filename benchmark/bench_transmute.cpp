@@ -0,0 +1,113 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+// Times the conversion of packages to the '.conda' format:
+//
+//     bench_transmute [-l compression_level] [-j max_threads] pkg.tar.bz2 [pkg.tar.bz2 ...]
+//
+// Each package is first converted one at a time with single-threaded zstd,
+// then with multi-threaded zstd, then all the packages at once with the bulk API.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mamba/core/package_handling.hpp"
+#include "mamba/core/thread_utils.hpp"
+#include "mamba/core/util.hpp"
+
+using namespace mamba;  // NOLINT(build/namespaces)
+
+namespace
+{
+    template <class F>
+    double time_it(F&& f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+
+    void report(const std::string& name, double seconds, std::size_t bytes)
+    {
+        std::cout << name << ": " << seconds << " s ("
+                  << static_cast<double>(bytes) / (1024 * 1024) / seconds << " MiB/s)"
+                  << std::endl;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    int compression_level = 22;
+    std::size_t max_threads = 0;
+    std::vector<fs::path> sources;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-l" && i + 1 < argc)
+        {
+            compression_level = std::atoi(argv[++i]);
+        }
+        else if (arg == "-j" && i + 1 < argc)
+        {
+            max_threads = static_cast<std::size_t>(std::atoi(argv[++i]));
+        }
+        else
+        {
+            sources.push_back(fs::absolute(arg));
+        }
+    }
+    if (sources.empty())
+    {
+        std::cerr << "usage: " << argv[0]
+                  << " [-l compression_level] [-j max_threads] pkg.tar.bz2 [pkg.tar.bz2 ...]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::size_t total_size = 0;
+    for (const auto& s : sources)
+    {
+        total_size += fs::file_size(s);
+    }
+
+    TemporaryDirectory out_dir;
+    std::vector<std::pair<fs::path, fs::path>> pkgs;
+    for (const auto& s : sources)
+    {
+        std::string fn = s.filename().string();
+        fn = fn.substr(0, fn.size() - std::string(".tar.bz2").size()) + ".conda";
+        pkgs.emplace_back(s, out_dir.path() / fn);
+    }
+
+    std::cout << sources.size() << " packages, " << default_thread_count() << " cores, "
+              << "zstd level " << compression_level << std::endl;
+
+    report("sequential, 1 zstd thread", time_it([&]() {
+               for (const auto& [source, target] : pkgs)
+               {
+                   transmute(source, target, compression_level, 1);
+               }
+           }),
+           total_size);
+
+    report("sequential, zstd threads", time_it([&]() {
+               for (const auto& [source, target] : pkgs)
+               {
+                   transmute(source, target, compression_level, 0);
+               }
+           }),
+           total_size);
+
+    report("bulk", time_it([&]() { transmute(pkgs, compression_level, 1, max_threads); }),
+           total_size);
+
+    return 0;
+}
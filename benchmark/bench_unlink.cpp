@@ -0,0 +1,94 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+// Times the removal of all the packages of a synthetic environment:
+//
+//     bench_unlink [n_packages] [n_files_per_package]
+//
+// One UnlinkPackage per package (the transaction path) is compared
+// to the bulk unlink_packages (the 'remove --all' path).
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+#include "mamba/core/link.hpp"
+#include "mamba/core/package_info.hpp"
+#include "mamba/core/transaction_context.hpp"
+#include "mamba/core/util.hpp"
+
+using namespace mamba;  // NOLINT(build/namespaces)
+
+namespace
+{
+    std::vector<PackageInfo> make_env(const fs::path& prefix,
+                                      std::size_t n_packages,
+                                      std::size_t n_files)
+    {
+        std::vector<PackageInfo> pkgs;
+        fs::create_directories(prefix / "conda-meta");
+        for (std::size_t i = 0; i < n_packages; ++i)
+        {
+            PackageInfo pkg("pkg" + std::to_string(i), "1.0", "0", 0);
+            nlohmann::json record = pkg.json();
+            record["files"] = nlohmann::json::array();
+            record["paths_data"]["paths"] = nlohmann::json::array();
+            for (std::size_t f = 0; f < n_files; ++f)
+            {
+                std::string path = concat("lib/", pkg.name, "/sub", std::to_string(f % 4), "/file",
+                                          std::to_string(f), ".txt");
+                fs::create_directories((prefix / path).parent_path());
+                std::ofstream(prefix / path) << path;
+                record["files"].push_back(path);
+                record["paths_data"]["paths"].push_back(
+                    { { "_path", path }, { "path_type", "hardlink" } });
+            }
+            std::ofstream(prefix / "conda-meta" / (pkg.str() + ".json")) << record.dump(4);
+            pkgs.push_back(pkg);
+        }
+        return pkgs;
+    }
+
+    template <class F>
+    double time_it(F&& f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    std::size_t n_packages = argc > 1 ? std::atoi(argv[1]) : 800;
+    std::size_t n_files = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    TemporaryDirectory tmp_dir;
+    fs::path prefix = tmp_dir.path() / "env";
+    TransactionContext context(prefix, "");
+
+    std::cout << n_packages << " packages, " << n_files << " files per package" << std::endl;
+
+    auto pkgs = make_env(prefix, n_packages, n_files);
+    std::cout << "UnlinkPackage: " << time_it([&]() {
+        for (const auto& pkg : pkgs)
+        {
+            UnlinkPackage(pkg, "", &context).execute();
+        }
+    }) << " s" << std::endl;
+
+    pkgs = make_env(prefix, n_packages, n_files);
+    std::cout << "unlink_packages: "
+              << time_it([&]() { unlink_packages(pkgs, &context); }) << " s" << std::endl;
+
+    return 0;
+}
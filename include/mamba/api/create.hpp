@@ -7,10 +7,16 @@
 #ifndef MAMBA_API_CREATE_HPP
 #define MAMBA_API_CREATE_HPP
 
+#include <string>
 
 namespace mamba
 {
     void create();
+
+    namespace detail
+    {
+        void clone_environment(const std::string& source);
+    }
 }
 
 #endif
@@ -0,0 +1,18 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_API_QUERY_SERVER_HPP
+#define MAMBA_API_QUERY_SERVER_HPP
+
+#include <string>
+
+
+namespace mamba
+{
+    void query_server(const std::string& socket_path);
+}
+
+#endif
@@ -18,6 +18,8 @@ namespace mamba
     namespace detail
     {
         void remove_specs(const std::vector<std::string>& specs);
+        // Removes all the packages of the target prefix, without solving
+        void remove_all_packages();
     }
 }
 
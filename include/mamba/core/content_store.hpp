@@ -0,0 +1,50 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_CONTENT_STORE_HPP
+#define MAMBA_CORE_CONTENT_STORE_HPP
+
+#include <string>
+#include <vector>
+
+#include "mamba_fs.hpp"
+
+#define CONTENT_STORE_DIR "cas"
+
+namespace mamba
+{
+    // Content-addressed store of the files of the extracted packages of a
+    // package cache, located in `<pkgs_dir>/cas`. Files are keyed by the
+    // sha256 from `paths.json` and their permissions masked by the umask, as
+    // applied to the files on disk. Extracted packages hardlink to the
+    // stored blobs instead of holding their own copy.
+    //
+    // The reference count of a blob is its hardlink count: a blob only
+    // linked from the store is not used anymore and can be collected.
+    class ContentStore
+    {
+    public:
+        explicit ContentStore(const fs::path& pkgs_dir);
+
+        const fs::path& path() const;
+        fs::path blob_path(const std::string& sha256, fs::perms perms) const;
+
+        // Hardlinks the blob to target, returns false if there is no such blob
+        bool link(const std::string& sha256, fs::perms perms, const fs::path& target) const;
+
+        // Replaces the files of an extracted package by links to the store,
+        // adding the ones that are not stored yet
+        void deduplicate(const fs::path& extract_dir) const;
+
+        std::vector<fs::path> unreferenced_blobs() const;
+
+    private:
+        fs::path m_path;
+        fs::perms m_umask;
+    };
+}  // namespace mamba
+
+#endif
@@ -110,13 +110,27 @@ namespace mamba
         // TODO check writable and add other potential dirs
         std::vector<fs::path> envs_dirs = { root_prefix / "envs" };
         std::vector<fs::path> pkgs_dirs = { root_prefix / "pkgs" };
+        // read-only package caches, searched after pkgs_dirs
+        std::vector<fs::path> readonly_pkgs_dirs = {};
 
         bool use_index_cache = false;
         std::size_t local_repodata_ttl = 1;  // take from header
         bool offline = false;
         bool quiet = false;
         bool json = false;
+        // file receiving the log messages along with stderr, see LogSink
+        fs::path log_file = "";
+        // Chrome trace of the operation written at exit, see Tracer
+        fs::path trace_file = "";
+        // performance counters written at exit, see Metrics
+        fs::path metrics_file = "";
         ChannelPriority channel_priority = ChannelPriority::kFlexible;
+        // reuse the solutions of identical solves, see SolutionCache
+        bool solution_cache = false;
+        // exclude the packages that cannot be installed, see MPool::prune_incompatible
+        bool prune_incompatible = false;
+        // solve over the dependency closure of the request, see MPool::prune_unreachable
+        bool prune_unreachable = false;
         bool auto_activate_base = false;
 
         long max_parallel_downloads = 5;
@@ -131,12 +145,21 @@ namespace mamba
         bool allow_softlinks = false;
         bool always_copy = false;
         bool always_softlink = false;
+        // journal the changes to the prefix to roll back interrupted transactions
+        bool transaction_journal = false;
+
+        // deduplicate the extracted files in a content-addressed store
+        bool use_content_store = false;
+        // size budget of the writable package caches (e.g. "20G"), empty for no limit
+        std::string package_cache_max_size = "";
 
         // add start menu shortcuts on Windows (not implemented on Linux / macOS)
         bool shortcuts = true;
 
         VerificationLevel safety_checks = VerificationLevel::kWarn;
         bool extra_safety_checks = false;
+        // 0 means one thread per available core
+        std::size_t validation_threads = 0;
         bool verify_artifacts = false;
 
         // debug helpers
@@ -91,8 +91,6 @@ namespace mamba
         // validation
         std::size_t m_expected_size = 0;
 
-        std::chrono::steady_clock::time_point m_progress_throttle_time;
-
         // retry & backoff
         std::chrono::steady_clock::time_point m_next_retry;
         std::size_t m_retry_wait_seconds = Context::instance().retry_timeout;
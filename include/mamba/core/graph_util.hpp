@@ -30,6 +30,7 @@ namespace mamba
         using cycle_list = std::vector<node_list>;
 
         const node_list& get_node_list() const;
+        const node& get_node(node_id id) const;
         const edge_list& get_edge_list(node_id id) const;
 
         node_id add_node(const node& value);
@@ -147,6 +148,12 @@ namespace mamba
         return m_node_list;
     }
 
+    template <class T>
+    inline auto graph<T>::get_node(node_id id) const -> const node&
+    {
+        return m_node_list[id];
+    }
+
     template <class T>
     inline auto graph<T>::get_edge_list(node_id id) const -> const edge_list&
     {
@@ -24,6 +24,7 @@
 namespace mamba
 {
     std::string replace_long_shebang(const std::string& shebang);
+    fs::path pyc_path(const fs::path& py_path, const std::string& py_ver);
     std::tuple<std::vector<std::string>, std::unique_ptr<TemporaryFile>> prepare_wrapped_call(
         const fs::path& prefix, const std::vector<std::string>& cmd);
 
@@ -32,6 +33,34 @@ namespace mamba
         std::string command, module, func;
     };
 
+    // Compiles the python files of the noarch packages linked with
+    // 'defer_pyc_compilation' at once, and adds the pyc files to the
+    // conda-meta records of their packages. Returns the packages (name-version-build)
+    // with files that could not be compiled.
+    std::vector<std::string> compile_deferred_pyc_files(TransactionContext* context);
+
+    // Runs the post-link scripts of the packages linked with 'defer_post_link'.
+    // Scripts of independent packages run concurrently, a script only starts
+    // once the scripts of its dependencies are done, and is not run if one of
+    // them failed. Outputs and errors are reported in the linking order.
+    // Returns the packages (name-version-build) whose script failed or was
+    // not run, the packages stay linked as with an immediate post-link script.
+    std::vector<std::string> run_deferred_post_link_scripts(TransactionContext* context);
+
+    // Removes installed packages at once, without undo: the files of all
+    // the packages are deleted concurrently, then the emptied directories
+    // in a single bottom-up pass. Returns the number of removed files.
+    std::size_t unlink_packages(const std::vector<PackageInfo>& pkgs, TransactionContext* context);
+
+    // Installs the packages of the source prefix into the target prefix of
+    // the context from the files of source, without the package cache: files
+    // are hardlinked (or reflinked, or copied) and the ones holding the source
+    // prefix are rewritten. Returns the number of cloned files; on failure the
+    // cloned files are removed before the error is rethrown.
+    std::size_t clone_packages(const fs::path& source,
+                               const std::vector<PackageInfo>& pkgs,
+                               TransactionContext* context);
+
     class UnlinkPackage
     {
     public:
@@ -0,0 +1,104 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_LOG_SINK_HPP
+#define MAMBA_CORE_LOG_SINK_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "mamba_fs.hpp"
+#include "output.hpp"
+
+namespace mamba
+{
+    // Destination of the messages of MessageLogger.
+    //
+    // Logging threads push formatted records into a bounded lock-free
+    // ring buffer (multiple producers, single consumer), and a dedicated
+    // thread writes them to stderr and to the log file, so that workers
+    // never wait on terminal I/O and messages do not interleave.
+    //
+    // When the ring is full, messages below the error severity are dropped
+    // and counted, the count being reported with the next written messages;
+    // errors are written directly, after the records already in the ring.
+    // The records are flushed on interruption, on exit and before a fatal
+    // message aborts.
+    class LogSink
+    {
+    public:
+        explicit LogSink(std::size_t capacity = 4096);
+        ~LogSink();
+
+        LogSink(const LogSink&) = delete;
+        LogSink& operator=(const LogSink&) = delete;
+
+        // Never destroyed, it is stopped at exit
+        static LogSink& instance();
+
+        void push(LogSeverity severity, std::string message);
+
+        // Waits until the records pushed so far are written
+        void flush();
+        // Closes the ring to new records, writes the remaining ones and stops
+        // the writer thread, the records pushed afterwards are written directly
+        void stop();
+
+        void set_log_file(const fs::path& path);
+        void set_stderr(bool enabled);
+
+        std::size_t dropped() const;
+
+    private:
+        struct Record
+        {
+            LogSeverity severity;
+            std::string message;
+        };
+
+        struct Slot
+        {
+            std::atomic<std::size_t> sequence;
+            Record record;
+        };
+
+        bool try_push(Record& record);
+        bool try_pop(Record& record);
+
+        void run();
+        std::size_t write_pending();
+        // pops and writes the records of the ring, under m_output_mutex
+        std::size_t write_ring();
+        void write(const Record& record);
+
+        std::size_t m_capacity;
+        std::unique_ptr<Slot[]> m_slots;
+        std::atomic<std::size_t> m_push_pos;
+        std::atomic<std::size_t> m_pop_pos;
+        std::atomic<std::size_t> m_dropped;
+        std::size_t m_reported_dropped;
+        // pushes in progress, waited for by stop()
+        std::atomic<std::size_t> m_pushing;
+
+        // the output streams are used under m_output_mutex
+        std::mutex m_output_mutex;
+        std::ofstream m_log_file;
+        bool m_stderr;
+
+        std::mutex m_wait_mutex;
+        std::condition_variable m_pushed;
+        std::condition_variable m_written;
+        std::atomic<bool> m_stopped;
+        std::thread m_writer;
+    };
+}  // namespace mamba
+
+#endif
@@ -0,0 +1,113 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_METRICS_HPP
+#define MAMBA_CORE_METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+#include "mamba_fs.hpp"
+
+namespace mamba
+{
+    // Performance counters of an operation, written at exit to the
+    // 'metrics_file' to aggregate them across many runs.
+    //
+    // The counters are atomics updated by the threads doing the work and
+    // always collected, they are only written when the file is set: in the
+    // Prometheus text format, or as JSON when the file ends with '.json'.
+    class Metrics
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+
+        // Never destroyed, the metrics are written at exit
+        static Metrics& instance();
+
+        // Writes the metrics to file when stop() is called
+        void start(const fs::path& file);
+        void stop();
+
+        // A transfer of a DownloadTarget, counted per host
+        void add_download(const std::string& url, std::size_t bytes, std::size_t avg_speed);
+
+        nlohmann::json json() const;
+        std::string prometheus() const;
+
+        // repodata read from the cache or not modified, or downloaded
+        std::atomic<std::size_t> repodata_cache_hits{ 0 };
+        std::atomic<std::size_t> repodata_cache_misses{ 0 };
+        // packages found in a package cache, or downloaded
+        std::atomic<std::size_t> package_cache_hits{ 0 };
+        std::atomic<std::size_t> package_cache_misses{ 0 };
+
+        std::atomic<std::size_t> extracted_packages{ 0 };
+        std::atomic<std::size_t> linked_packages{ 0 };
+        std::atomic<std::size_t> linked_files{ 0 };
+
+        // cumulated over the threads, in nanoseconds
+        std::atomic<std::int64_t> solve_time{ 0 };
+        std::atomic<std::int64_t> extract_time{ 0 };
+        std::atomic<std::int64_t> link_time{ 0 };
+
+    private:
+        Metrics() = default;
+
+        struct HostDownloads
+        {
+            std::size_t count = 0;
+            std::size_t bytes = 0;
+            double seconds = 0;
+        };
+
+        fs::path m_file;
+        std::map<std::string, HostDownloads> m_downloads;
+        mutable std::mutex m_mutex;
+    };
+
+    // Adds the time spent in its scope to a counter of Metrics
+    class MetricsTimer
+    {
+    public:
+        explicit MetricsTimer(std::atomic<std::int64_t>& counter);
+        ~MetricsTimer();
+
+        MetricsTimer(const MetricsTimer&) = delete;
+        MetricsTimer& operator=(const MetricsTimer&) = delete;
+
+    private:
+        std::atomic<std::int64_t>& m_counter;
+        Metrics::clock::time_point m_start;
+    };
+
+    // Peak resident set size of the process, in bytes
+    std::size_t peak_rss();
+
+    inline MetricsTimer::MetricsTimer(std::atomic<std::int64_t>& counter)
+        : m_counter(counter)
+        , m_start(Metrics::clock::now())
+    {
+    }
+
+    inline MetricsTimer::~MetricsTimer()
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Metrics::clock::now()
+                                                                            - m_start);
+        m_counter.fetch_add(elapsed.count(), std::memory_order_relaxed);
+    }
+}  // namespace mamba
+
+#endif
@@ -8,6 +8,7 @@
 #define MAMBA_CORE_OUTPUT_HPP
 
 #include <chrono>
+#include <condition_variable>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -15,6 +16,7 @@
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -231,29 +233,28 @@ namespace mamba
 
         ProgressProxy add_progress_bar(const std::string& name, size_t expected_total = 0);
         void init_multi_progress(ProgressBarMode mode = ProgressBarMode::multi);
+        // Draws the pending updates of the progress bars without waiting for
+        // the next frame of the render thread
+        void render_progress();
 
         static std::string hide_secrets(const std::string_view& str);
 
     private:
         Console();
-        ~Console() = default;
+        ~Console();
 
-        void deactivate_progress_bar(std::size_t idx, const std::string_view& msg = "");
-        void print_progress(std::size_t idx);
+        void render_loop();
         bool skip_progress_bars() const;
 
         std::mutex m_mutex;
         std::unique_ptr<ProgressBarManager> p_progress_manager;
 
-        friend class ProgressProxy;
+        // draws the progress bars, started with the first one
+        std::thread m_render_thread;
+        std::condition_variable m_render_cv;
+        bool m_render_stop = false;
     };
 
-    inline void ProgressProxy::set_postfix(const std::string& s)
-    {
-        p_bar->set_postfix(s);
-        Console::instance().print_progress(m_idx);
-    }
-
 #undef TRACE
 #undef DEBUG
 #undef INFO
@@ -280,6 +281,7 @@ namespace mamba
         std::stringstream& stream();
 
         static LogSeverity& global_log_severity();
+        static bool enabled(LogSeverity severity);
 
     private:
         std::string m_file;
@@ -288,6 +290,20 @@ namespace mamba
         std::stringstream m_stream;
     };
 
+    // Turns the stream expression of LOG into void, so that it can be
+    // an operand of the conditional operator
+    struct LogVoidify
+    {
+        void operator&(std::ostream&)
+        {
+        }
+    };
+
+    inline bool MessageLogger::enabled(LogSeverity severity)
+    {
+        return severity >= global_log_severity();
+    }
+
     class JsonLogger
     {
     public:
@@ -299,6 +315,7 @@ namespace mamba
 
         static JsonLogger& instance();
 
+        // the document, built as the entries are written
         nlohmann::json json_log;
         void json_write(const nlohmann::json& j);
         void json_append(const std::string& value);
@@ -310,8 +327,10 @@ namespace mamba
         JsonLogger();
         ~JsonLogger() = default;
 
-        std::string json_hier;
-        unsigned int json_index;
+        nlohmann::json& json_current();
+
+        std::vector<std::string> json_hier;
+        unsigned int json_index = 0;
     };
 }  // namespace mamba
 
@@ -319,7 +338,12 @@ namespace mamba
 #undef WARNING
 #undef FATAL
 
-#define LOG(severity) mamba::MessageLogger(__FILE__, __LINE__, severity).stream()
+// The severity is checked first: a disabled message creates no stream and
+// its operands are not evaluated
+#define LOG(severity)                                                                              \
+    !mamba::MessageLogger::enabled(severity)                                                       \
+        ? (void) 0                                                                                 \
+        : mamba::LogVoidify() & mamba::MessageLogger(__FILE__, __LINE__, severity).stream()
 #define LOG_TRACE LOG(mamba::LogSeverity::kTrace)
 #define LOG_DEBUG LOG(mamba::LogSeverity::kDebug)
 #define LOG_INFO LOG(mamba::LogSeverity::kInfo)
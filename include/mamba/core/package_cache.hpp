@@ -7,9 +7,13 @@
 #ifndef MAMBA_CORE_PACKAGE_CACHE
 #define MAMBA_CORE_PACKAGE_CACHE
 
+#include <ctime>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "context.hpp"
@@ -19,6 +23,8 @@
 #include "package_info.hpp"
 
 #define PACKAGE_CACHE_MAGIC_FILE "urls.txt"
+#define PACKAGE_CACHE_USAGE_FILE "usage.json"
+#define PACKAGE_CACHE_MANIFEST_FILE "manifest.json"
 
 namespace mamba
 {
@@ -30,15 +36,54 @@ namespace mamba
         DIR_DOES_NOT_EXIST
     };
 
-    // TODO layered package caches
+    // Prebuilt index of a read-only package cache, stored in `<pkgs_dir>/manifest.json`.
+    // It maps each extracted package (name-version-build) to its checksums and size,
+    // so that lookups do not need to access the cache itself, which may live on a
+    // slow network filesystem.
+    class PackageCacheManifest
+    {
+    public:
+        struct Entry
+        {
+            std::string fn;
+            std::string url;
+            std::string sha256;
+            std::string md5;
+            std::size_t size = 0;
+        };
+
+        PackageCacheManifest(const fs::path& pkgs_dir);
+
+        fs::path path() const;
+        // Returns false if the manifest does not exist or is invalid
+        bool load();
+        void save() const;
+        // Indexes the extracted packages of the cache from their 'repodata_record.json'
+        void build();
+
+        const Entry* find(const std::string& pkg) const;
+        // Whether the extracted package is in the cache, with the expected checksum
+        bool contains(const PackageInfo& s) const;
+        std::size_t size() const;
+
+    private:
+        fs::path m_pkgs_dir;
+        std::unordered_map<std::string, Entry> m_entries;
+    };
+
+    // A package cache is either writable, or a read-only layer searched after the
+    // writable ones. Read-only layers are never modified, and are looked up in their
+    // manifest when they have one instead of being validated.
     class PackageCacheData
     {
     public:
-        PackageCacheData(const fs::path& pkgs_dir);
+        PackageCacheData(const fs::path& pkgs_dir, bool read_only = false);
 
         bool create_directory();
         void set_writable(Writable writable);
         Writable is_writable();
+        bool is_read_only() const;
+        bool has_manifest() const;
         fs::path get_pkgs_dir() const;
         void clear_query_cache(const PackageInfo& s);
 
@@ -48,19 +93,29 @@ namespace mamba
 
     private:
         void check_writable();
+        bool check_validity(const PackageInfo& s);
 
         std::map<std::string, bool> m_valid_cache;
         Writable m_writable = Writable::UNKNOWN;
         fs::path m_pkgs_dir;
+        bool m_read_only = false;
+        std::shared_ptr<const PackageCacheManifest> m_manifest;
+
+        friend class MultiPackageCache;
     };
 
     class MultiPackageCache
     {
     public:
+        // The read-only layers from the context ('readonly_pkgs_dirs') are
+        // searched after pkgs_dirs
         MultiPackageCache(const std::vector<fs::path>& pkgs_dirs);
         PackageCacheData& first_writable();
 
         fs::path query(const PackageInfo& s);
+        // Validates the packages concurrently, returns the path of the
+        // first valid cache for each of them (empty if none)
+        std::vector<fs::path> query(const std::vector<PackageInfo>& pkgs);
         fs::path first_cache_path(const PackageInfo& s, bool return_empty = true);
         std::vector<PackageCacheData*> writable_caches();
 
@@ -70,6 +125,54 @@ namespace mamba
         std::vector<PackageCacheData> m_caches;
         std::map<std::string, std::string> m_path_cache;
     };
+
+    // Persistent usage index of a package cache, stored in `<pkgs_dir>/usage.json`.
+    // It records when each package was last linked, its size and the prefixes it
+    // is linked into, so that the cache can be pruned without scanning every
+    // environment. Callers must hold a lock on the index between load and save.
+    class PackageCacheUsage
+    {
+    public:
+        struct Entry
+        {
+            std::time_t last_used = 0;
+            // size of the extracted package
+            std::size_t size = 0;
+            std::set<std::string> prefixes;
+            // not persisted, refreshed by scan
+            std::size_t tarballs_size = 0;
+        };
+
+        PackageCacheUsage(const fs::path& pkgs_dir);
+
+        fs::path lock_path() const;
+        void load();
+        void save() const;
+
+        void record_link(const std::string& pkg, const fs::path& prefix);
+        void record_unlink(const std::string& pkg, const fs::path& prefix);
+
+        // Synchronizes the index with the content of the package cache
+        void scan();
+        std::size_t total_size() const;
+        // Least recently used packages, not linked in any prefix, to remove
+        // for the cache to fit in max_size bytes
+        std::vector<std::string> lru_candidates(std::size_t max_size) const;
+        // Removes the extracted package and its tarballs
+        void remove_package(const std::string& pkg);
+
+        const std::map<std::string, Entry>& entries() const;
+
+    private:
+        void seed_prefixes();
+
+        fs::path m_pkgs_dir;
+        std::map<std::string, Entry> m_entries;
+    };
+
+    // Removes unused packages from the writable caches that exceed max_size
+    // bytes, returns the number of bytes freed
+    std::size_t prune_package_caches(MultiPackageCache& caches, std::size_t max_size);
 }  // namespace mamba
 
 #endif
@@ -9,6 +9,7 @@
 
 #include <string>
 #include <system_error>
+#include <utility>
 #include <vector>
 
 #include "mamba_fs.hpp"
@@ -22,18 +23,33 @@ namespace mamba
         zstd
     };
 
+    // compression_threads is only used by zstd, 0 means one thread per core
     void create_archive(const fs::path& directory,
                         const fs::path& destination,
                         compression_algorithm,
-                        int compression_level);
-    void create_package(const fs::path& directory, const fs::path& out_file, int compression_level);
+                        int compression_level,
+                        int compression_threads = 1,
+                        bool (*filter)(const std::string&) = nullptr);
+    void create_package(const fs::path& directory,
+                        const fs::path& out_file,
+                        int compression_level,
+                        int compression_threads = 1);
 
     void extract_archive(const fs::path& file, const fs::path& destination);
     void extract_conda(const fs::path& file,
                        const fs::path& dest_dir,
                        const std::vector<std::string>& parts = { "info", "pkg" });
     fs::path extract(const fs::path& file);
-    bool transmute(const fs::path& pkg_file, const fs::path& target, int compression_level);
+    bool transmute(const fs::path& pkg_file,
+                   const fs::path& target,
+                   int compression_level,
+                   int compression_threads = 1);
+    // Converts many (source, target) packages using up to max_threads
+    // threads, 0 means one thread per core
+    bool transmute(const std::vector<std::pair<fs::path, fs::path>>& pkgs,
+                   int compression_level,
+                   int compression_threads = 1,
+                   std::size_t max_threads = 0);
     bool validate(const fs::path& pkg_folder);
 }  // namespace mamba
 
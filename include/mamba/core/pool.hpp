@@ -7,6 +7,11 @@
 #ifndef MAMBA_CORE_POOL_HPP
 #define MAMBA_CORE_POOL_HPP
 
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "context.hpp"
 
 extern "C"
@@ -16,6 +21,8 @@ extern "C"
 
 namespace mamba
 {
+    class Channel;
+
     class MPool
     {
     public:
@@ -30,10 +37,47 @@ namespace mamba
         void set_debuglevel();
         void create_whatprovides();
 
+        // Channel of the repos of the pool, resolved once when the repo is
+        // created so that channel specific jobs compare pointers instead of URLs
+        void add_repo_channel(Repo* repo, const Channel& channel);
+        void remove_repo_channel(Repo* repo);
+        const Channel* repo_channel(Repo* repo);
+
+        // The pruning excludes packages of the channels from the solve, it must
+        // be done once all the repos are loaded and before the creation of the
+        // solver. Both return the number of excluded packages.
+        //
+        // Exclude the packages that cannot be installed: the ones requiring
+        // virtual packages (the "__" packages of the installed repo) that are
+        // missing or do not match, and the ones of a pinned package not
+        // matching the pins.
+        std::size_t prune_incompatible(const std::vector<std::string>& pins);
+        // Exclude the packages whose name is not reachable through dependencies
+        // and constraints from the requested specs and the installed packages.
+        std::size_t prune_unreachable(const std::vector<std::string>& specs);
+        std::size_t pruned_solvables() const;
+
+        // Reverse dependency index: the solvables requiring a package name,
+        // built once for the pool and again when solvables are added
+        const std::vector<Id>& whatrequires(Id name);
+
+        // Time spent loading the repos into the pool, added by MRepo, see SolverStats
+        void add_loading_time(std::chrono::steady_clock::duration duration);
+        std::chrono::steady_clock::duration loading_time() const;
+
         operator Pool*();
 
     private:
+        bool is_considered(Id id) const;
+        void exclude(Id id);
+
         Pool* m_pool;
+        std::chrono::steady_clock::duration m_loading_time{ 0 };
+        std::unordered_map<Repo*, const Channel*> m_repo_channels;
+        Map m_considered;
+        std::size_t m_pruned_solvables = 0;
+        std::unordered_map<Id, std::vector<Id>> m_reverse_deps;
+        int m_reverse_deps_nsolvables = 0;
     };
 }  // namespace mamba
 
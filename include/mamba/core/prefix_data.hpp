@@ -9,6 +9,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "history.hpp"
 #include "package_info.hpp"
@@ -26,6 +27,8 @@ namespace mamba
         void load();
         void add_virtual_packages(const std::vector<PackageInfo>& packages);
         const package_map& records() const;
+        // records sorted with the dependencies before their dependents
+        std::vector<PackageInfo> sorted_records() const;
         void load_single_record(const fs::path& path);
 
         History& history();
@@ -7,7 +7,13 @@
 #ifndef MAMBA_CORE_PROGRESS_BAR_HPP
 #define MAMBA_CORE_PROGRESS_BAR_HPP
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace mamba
 {
@@ -17,11 +23,14 @@ namespace mamba
      * Public API of progress bars *
      *******************************/
 
+    // The updates only store the state of the bar, they are cheap enough to be
+    // called from the download callbacks and the extract workers. The bars are
+    // drawn by the render thread of the Console.
     class ProgressProxy
     {
     public:
         ProgressProxy() = default;
-        ProgressProxy(ProgressBar* ptr, std::size_t idx);
+        ProgressProxy(ProgressBar* ptr);
         ~ProgressProxy() = default;
 
         ProgressProxy(const ProgressProxy&) = default;
@@ -33,12 +42,14 @@ namespace mamba
         void set_progress(size_t current, size_t total);
         void elapsed_time_to_stream(std::stringstream& s);
         void set_postfix(const std::string& s);
+        // Postfix of a download, formatted when the bar is drawn. A total of
+        // SIZE_MAX means that the size is unknown.
+        void set_transfer(std::size_t current, std::size_t total, std::size_t speed);
         void mark_as_completed(const std::string_view& final_message = "");
         void mark_as_extracted();
 
     private:
         ProgressBar* p_bar;
-        std::size_t m_idx;
     };
 
     class ProgressBarManager
@@ -53,9 +64,10 @@ namespace mamba
 
         virtual ProgressProxy add_progress_bar(const std::string& name, size_t expected_total = 0)
             = 0;
-        virtual void print_progress(std::size_t idx) = 0;
-        virtual void deactivate_progress_bar(std::size_t idx, const std::string_view& msg = "") = 0;
 
+        // Draws the changes of the bars since the previous call, the final
+        // messages of the completed bars are printed above the active ones
+        virtual void render(bool skip_progress_bars) = 0;
         virtual void print(const std::string_view& str, bool skip_progress_bars) = 0;
 
     protected:
@@ -82,18 +94,19 @@ namespace mamba
         virtual ~MultiBarManager() = default;
 
         ProgressProxy add_progress_bar(const std::string& name, size_t expected_total) override;
-        void print_progress(std::size_t idx) override;
-        void deactivate_progress_bar(std::size_t idx, const std::string_view& msg = "") override;
 
+        void render(bool skip_progress_bars) override;
         void print(const std::string_view& str, bool skip_progress_bars) override;
 
     private:
-        void print_progress();
+        void update(bool skip_progress_bars);
+        void draw();
 
         using progress_bar_ptr = std::unique_ptr<ProgressBar>;
         std::vector<progress_bar_ptr> m_progress_bars;
         std::vector<ProgressBar*> m_active_progress_bars;
-        bool m_progress_started;
+        // lines of the bars drawn on the console
+        std::size_t m_drawn;
     };
 
     class AggregatedBarManager : public ProgressBarManager
@@ -103,16 +116,16 @@ namespace mamba
         virtual ~AggregatedBarManager() = default;
 
         ProgressProxy add_progress_bar(const std::string& name, size_t expected_total) override;
-        void print_progress(std::size_t idx) override;
-        void deactivate_progress_bar(std::size_t idx, const std::string_view& msg = "") override;
 
+        void render(bool skip_progress_bars) override;
         void print(const std::string_view& str, bool skip_progress_bars) override;
 
         void update_download_bar(std::size_t current_diff);
         void update_extract_bar();
 
     private:
-        void print_progress();
+        void update(bool skip_progress_bars);
+        void draw();
         bool is_complete() const;
 
         std::chrono::time_point<std::chrono::high_resolution_clock> m_start_time;
@@ -122,11 +135,12 @@ namespace mamba
         progress_bar_ptr p_download_bar;
         progress_bar_ptr p_extract_bar;
         size_t m_completed;
-        size_t m_extracted;
-        std::mutex m_main_mutex;
-        size_t m_current;
+        std::atomic<size_t> m_extracted;
+        std::atomic<size_t> m_current;
         size_t m_total;
+        std::atomic<bool> m_updated;
         bool m_progress_started;
+        std::size_t m_drawn;
     };
 
     class ProgressBar
@@ -145,19 +159,41 @@ namespace mamba
 
         void set_start();
         void set_postfix(const std::string& postfix_text);
+        void set_transfer(std::size_t current, std::size_t total, std::size_t speed);
         void elapsed_time_to_stream(std::stringstream& s);
         const std::string& prefix() const;
 
+        // The bar is drawn from the next frame on
+        void activate();
+        void complete(const std::string_view& final_message);
+
+        bool is_active() const;
+        // True once per completion of the bar, with its final message
+        bool take_completion(std::string& final_message);
+
     protected:
         ProgressBar(const std::string& prefix);
 
-        std::chrono::nanoseconds m_elapsed_ns;
-        std::chrono::time_point<std::chrono::high_resolution_clock> m_start_time;
+        std::chrono::nanoseconds elapsed() const;
+        std::string postfix();
+
+        // since the epoch of the clock, zero until the start
+        std::atomic<std::chrono::nanoseconds::rep> m_start_time;
 
         std::string m_prefix;
+        std::atomic<bool> m_activate_bob;
+        std::atomic<bool> m_active;
+        std::atomic<bool> m_completed;
+
+        std::atomic<bool> m_transfer_postfix;
+        std::atomic<std::size_t> m_transfer_current;
+        std::atomic<std::size_t> m_transfer_total;
+        std::atomic<std::size_t> m_transfer_speed;
+
+        // the text postfix and the final message
+        std::mutex m_text_mutex;
         std::string m_postfix;
-        bool m_start_time_saved;
-        bool m_activate_bob;
+        std::string m_final_message;
     };
 
     class DefaultProgressBar : public ProgressBar
@@ -172,7 +208,7 @@ namespace mamba
         void set_extracted() override;
 
     private:
-        size_t m_progress;
+        std::atomic<size_t> m_progress;
         int m_width_cap;
     };
 
@@ -191,7 +227,7 @@ namespace mamba
 
     private:
         AggregatedBarManager* p_manager;
-        std::size_t m_current;
+        std::atomic<std::size_t> m_current;
         std::size_t m_total;
     };
 }
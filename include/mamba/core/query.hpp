@@ -11,6 +11,7 @@
 #include <deque>
 #include <functional>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <string_view>
@@ -63,19 +64,44 @@ namespace mamba
         Whoneeds
     };
 
+    // Node of the dependency graph, either a solvable of the pool or a
+    // dependency which could not be found. The PackageInfo of a solvable is
+    // only created when it is needed, the fields used to render and order
+    // the results are read from the solvable. The pool must outlive the node.
+    class package_node
+    {
+    public:
+        package_node(Pool* pool, Id id);
+        explicit package_node(const std::string& missing_name);
+
+        Id id() const;
+
+        std::string name() const;
+        std::string version() const;
+        std::string field(const std::string& name) const;
+        const PackageInfo& info() const;
+
+    private:
+        Solvable* solvable() const;
+
+        Pool* m_pool = nullptr;
+        Id m_id = 0;
+        mutable std::shared_ptr<const PackageInfo> m_info;
+    };
+
     class query_result
     {
     public:
-        using dependency_graph = graph<PackageInfo>;
+        using dependency_graph = graph<package_node>;
         using package_list = dependency_graph::node_list;
-        using package_view_list = std::vector<package_list::const_iterator>;
+        using package_view_list = std::vector<dependency_graph::node_id>;
 
         query_result(QueryType type, const std::string& query, dependency_graph&& dep_graph);
 
         ~query_result() = default;
 
-        query_result(const query_result&);
-        query_result& operator=(const query_result&);
+        query_result(const query_result&) = default;
+        query_result& operator=(const query_result&) = default;
         query_result(query_result&&) = default;
         query_result& operator=(query_result&&) = default;
 
@@ -95,7 +121,7 @@ namespace mamba
 
     private:
         void reset_pkg_view_list();
-        std::string get_package_repr(const PackageInfo& pkg) const;
+        std::string get_package_repr(const package_node& pkg) const;
 
         QueryType m_type;
         std::string m_query;
@@ -0,0 +1,65 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_QUERY_SERVER_HPP
+#define MAMBA_CORE_QUERY_SERVER_HPP
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mamba_fs.hpp"
+
+namespace mamba
+{
+    // Long lived server answering repoquery requests from pools kept loaded,
+    // one per set of channels.
+    //
+    // A request is a JSON object on a single line:
+    //     {"type": "find" | "whoneeds" | "depends", "query": "<spec>",
+    //      "tree": false, "channels": ["conda-forge"]}
+    // where "channels" defaults to the configured channels. The answer, on a
+    // single line as well, is the JSON output of the query. The request
+    // {"type": "shutdown"} stops the server.
+    //
+    // The pool of a set of channels is loaded by its first request (the one of
+    // the configured channels when serving starts) and then kept as is. The
+    // request {"type": "reload"} loads the repodata of all the kept pools again
+    // as MSubdirData does for any command (using the cache while it is valid),
+    // a pool is only created again when its repodata changed.
+    class QueryServer
+    {
+    public:
+        QueryServer();
+        ~QueryServer();
+
+        QueryServer(const QueryServer&) = delete;
+        QueryServer& operator=(const QueryServer&) = delete;
+
+        std::string handle(const std::string& request);
+
+        // Answers the requests sent on a Unix socket until a shutdown request
+        // or an interruption. The clients are served concurrently, one request
+        // at a time, and the ones idle for longer than idle_timeout are closed.
+        void serve(const fs::path& socket_path,
+                   std::chrono::milliseconds idle_timeout = std::chrono::seconds(60));
+
+        std::size_t pool_count() const;
+
+    private:
+        struct ChannelPool;
+
+        ChannelPool& channel_pool(const std::vector<std::string>& channels);
+        void load_pool(const std::vector<std::string>& channels);
+
+        std::map<std::vector<std::string>, std::unique_ptr<ChannelPool>> m_pools;
+        bool m_shutdown = false;
+    };
+}  // namespace mamba
+
+#endif
@@ -24,6 +24,9 @@ extern "C"
 
 namespace mamba
 {
+    // Version of mamba and libsolv, written to the solv files
+    const char* mamba_tool_version();
+
     /**
      * Represents a channel subdirectory
      * index.
@@ -106,6 +109,7 @@ namespace mamba
 
         RepoMetadata m_metadata;
 
+        MPool* m_pool;
         Repo* m_repo;
     };
 }  // namespace mamba
@@ -0,0 +1,54 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_SOLUTION_CACHE_HPP
+#define MAMBA_CORE_SOLUTION_CACHE_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mamba_fs.hpp"
+
+extern "C"
+{
+#include "solv/pool.h"
+#include "solv/queue.h"
+}
+
+#define SOLUTION_CACHE_DIR "solutions"
+
+namespace mamba
+{
+    // Cache of the solver results, in `<pkgs_dir>/cache/solutions`.
+    //
+    // A solve is keyed by a hash of the identity of the repos of the pool
+    // (ETag and modification date of the repodata, or the packages when they
+    // are unknown), the installed packages, the solver flags and the jobs,
+    // which include the pins. The cached value is the list of the packages
+    // installed after the solve.
+    class SolutionCache
+    {
+    public:
+        explicit SolutionCache(const fs::path& cache_dir);
+
+        static std::string key(Pool* pool,
+                               const Queue& jobs,
+                               const std::vector<std::pair<int, int>>& flags);
+
+        fs::path path(const std::string& key) const;
+
+        // Solvables installed by the cached solution, false if there is none
+        // or if one of its packages is not in the pool anymore
+        bool load(const std::string& key, Pool* pool, std::vector<Id>& solution) const;
+        void store(const std::string& key, Pool* pool, const std::vector<Id>& solution) const;
+
+    private:
+        fs::path m_cache_dir;
+    };
+}  // namespace mamba
+
+#endif
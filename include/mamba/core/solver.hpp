@@ -7,6 +7,7 @@
 #ifndef MAMBA_CORE_SOLVER_HPP
 #define MAMBA_CORE_SOLVER_HPP
 
+#include <set>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -23,6 +24,7 @@ extern "C"
 #include "solv/queue.h"
 #include "solv/solver.h"
 #include "solv/solverdebug.h"
+#include "solv/transaction.h"
 }
 
 #define MAMBA_NO_DEPS 0b0001
@@ -31,6 +33,25 @@ extern "C"
 
 namespace mamba
 {
+    // Wall times in milliseconds of the phases of a solve, and the size of the problem
+    struct SolverStats
+    {
+        // loading of the repos into the pool, see MPool::loading_time
+        double pool_creation = 0;
+        double whatprovides = 0;
+        double rule_generation = 0;
+        double solving = 0;
+        double transaction_ordering = 0;
+
+        int solvables = 0;
+        int pruned_solvables = 0;
+        int rules = 0;
+        int learnt_rules = 0;
+        int decisions = 0;
+
+        nlohmann::json to_json() const;
+    };
+
     class MSolver
     {
     public:
@@ -52,13 +73,24 @@ namespace mamba
         void set_postsolve_flags(const std::vector<std::pair<int, int>>& flags);
         bool is_solved();
         bool solve();
+        // empty for a solution from the cache
         std::string problems_to_str();
 
+        // Transaction of the solution, also when it comes from the solution cache
+        Transaction* create_transaction();
+        bool from_cache() const;
+        Pool* pool() const;
+
+        // filled by solve, and by MTransaction for the transaction ordering
+        SolverStats& stats();
+        const SolverStats& stats() const;
+
         const std::vector<MatchSpec>& install_specs() const;
         const std::vector<MatchSpec>& remove_specs() const;
         const std::vector<MatchSpec>& neuter_specs() const;
         const std::vector<MatchSpec>& pinned_specs() const;
 
+        // throws for a solution from the cache, no libsolv solver is created
         operator Solver*();
 
         bool only_deps = false;
@@ -68,6 +100,7 @@ namespace mamba
     private:
         void add_channel_specific_job(const MatchSpec& ms, int job_flag);
         void add_reinstall_job(MatchSpec& ms, int job_flag);
+        std::set<Repo*> channel_repos(const std::string& channel);
 
         std::vector<std::pair<int, int>> m_flags;
         std::vector<MatchSpec> m_install_specs;
@@ -75,8 +108,13 @@ namespace mamba
         std::vector<MatchSpec> m_neuter_specs;
         std::vector<MatchSpec> m_pinned_specs;
         bool m_is_solved;
+        // solvables installed by a solution from the cache, see SolutionCache
+        bool m_from_cache = false;
+        std::vector<Id> m_cached_solution;
+        SolverStats m_stats;
         Solver* m_solver;
         Pool* m_pool;
+        MPool& m_mpool;
         Queue m_jobs;
         const PrefixData* m_prefix_data = nullptr;
     };
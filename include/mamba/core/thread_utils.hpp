@@ -7,14 +7,17 @@
 #ifndef MAMBA_CORE_THREAD_UTILS_HPP
 #define MAMBA_CORE_THREAD_UTILS_HPP
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <csignal>
+#include <cstddef>
 #include <exception>
 #include <functional>
 #include <mutex>
 #include <thread>
 #include <utility>
+#include <vector>
 
 namespace mamba
 {
@@ -135,6 +138,92 @@ namespace mamba
         m_cleanup_function = std::bind(std::forward<Function>(func), std::forward<Args>(args)...);
     }
 
+    /****************
+     * parallel_for *
+     ****************/
+
+    // Number of worker threads to use when max_threads is 0
+    std::size_t default_thread_count();
+
+    namespace detail
+    {
+        // True in threads spawned by parallel_for
+        bool& in_parallel_for();
+    }
+
+    // Calls func(i) for each i in [0, size) with at most max_threads threads,
+    // the calling thread being one of them. A max_threads of 0 uses all the
+    // available cores. Nested calls made from a worker run sequentially to
+    // avoid oversubscription. The first exception thrown by func is rethrown
+    // in the calling thread once all workers have returned; the remaining
+    // indices are skipped.
+    template <class Function>
+    void parallel_for(std::size_t size, std::size_t max_threads, Function&& func);
+
+    template <class Function>
+    inline void parallel_for(std::size_t size, std::size_t max_threads, Function&& func)
+    {
+        if (max_threads == 0)
+        {
+            max_threads = default_thread_count();
+        }
+        std::size_t n_threads = std::min(size, max_threads);
+
+        if (n_threads <= 1 || detail::in_parallel_for())
+        {
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                func(i);
+            }
+            return;
+        }
+
+        std::atomic<std::size_t> next(0);
+        std::atomic<bool> failed(false);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto work = [&]() {
+            bool& nested = detail::in_parallel_for();
+            bool was_nested = nested;
+            nested = true;
+            try
+            {
+                for (std::size_t i = next++; i < size && !failed.load(); i = next++)
+                {
+                    func(i);
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+                failed.store(true);
+            }
+            nested = was_nested;
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(n_threads - 1);
+        for (std::size_t t = 1; t < n_threads; ++t)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto& w : workers)
+        {
+            w.join();
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
 }  // namespace mamba
 
 #endif
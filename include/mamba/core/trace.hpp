@@ -0,0 +1,141 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_TRACE_HPP
+#define MAMBA_CORE_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+#include "mamba_fs.hpp"
+
+namespace mamba
+{
+    // Timeline of an operation (fetch, repodata loading, solve, download,
+    // extraction, link, scripts), written at exit as a Chrome trace that
+    // can be opened in Perfetto or chrome://tracing.
+    //
+    // Recording is enabled by the 'trace_file' configurable; when it is
+    // disabled, a span costs a check of an atomic flag and its arguments
+    // are ignored.
+    class Tracer
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+
+        // Never destroyed, the trace is written at exit
+        static Tracer& instance();
+
+        bool enabled() const;
+
+        // Records the events until stop() writes them to file
+        void start(const fs::path& file);
+        void stop();
+
+        // Span of the calling thread
+        void complete(const char* category,
+                      const char* name,
+                      clock::time_point start,
+                      clock::time_point end,
+                      nlohmann::json args = nlohmann::json::object());
+        // Span which overlaps others on the same thread, as the transfers of
+        // a MultiDownloadTarget, displayed on its own track
+        void async(const char* category,
+                   const std::string& name,
+                   clock::time_point start,
+                   clock::time_point end,
+                   nlohmann::json args = nlohmann::json::object());
+
+        // The recorded events, in the Chrome trace format
+        nlohmann::json trace() const;
+
+    private:
+        Tracer() = default;
+
+        double timestamp(clock::time_point time) const;
+        static int thread_id();
+
+        std::atomic<bool> m_enabled{ false };
+        fs::path m_file;
+        clock::time_point m_origin;
+        std::size_t m_async_id = 0;
+        std::vector<nlohmann::json> m_events;
+        mutable std::mutex m_mutex;
+    };
+
+    // Records the scope it lives in as a span of the current thread
+    class TraceSpan
+    {
+    public:
+        TraceSpan(const char* category, const char* name);
+        ~TraceSpan();
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+        bool active() const;
+
+        template <class T>
+        TraceSpan& arg(const char* key, const T& value);
+
+    private:
+        const char* m_category;
+        const char* m_name;
+        bool m_active;
+        Tracer::clock::time_point m_start;
+        nlohmann::json m_args;
+    };
+
+    inline bool Tracer::enabled() const
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    inline TraceSpan::TraceSpan(const char* category, const char* name)
+        : m_category(category)
+        , m_name(name)
+        , m_active(Tracer::instance().enabled())
+    {
+        if (m_active)
+        {
+            m_start = Tracer::clock::now();
+        }
+    }
+
+    inline TraceSpan::~TraceSpan()
+    {
+        if (m_active)
+        {
+            Tracer::instance().complete(
+                m_category, m_name, m_start, Tracer::clock::now(), std::move(m_args));
+        }
+    }
+
+    inline bool TraceSpan::active() const
+    {
+        return m_active;
+    }
+
+    template <class T>
+    inline TraceSpan& TraceSpan::arg(const char* key, const T& value)
+    {
+        if (m_active)
+        {
+            m_args[key] = value;
+        }
+        return *this;
+    }
+}  // namespace mamba
+
+#endif
@@ -7,8 +7,10 @@
 #ifndef MAMBA_CORE_TRANSACTION_HPP
 #define MAMBA_CORE_TRANSACTION_HPP
 
+#include <atomic>
 #include <future>
 #include <iomanip>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -72,7 +74,7 @@ namespace mamba
         std::exception m_decompress_exception;
 
     private:
-        bool m_finished;
+        std::atomic<bool> m_finished;
         PackageInfo m_package_info;
 
         std::string m_sha256, m_md5;
@@ -126,6 +128,10 @@ namespace mamba
         std::string find_python_version();
 
     private:
+        void update_cache_usage(
+            const std::map<fs::path, std::vector<std::pair<std::string, bool>>>& cache_usage,
+            const fs::path& prefix);
+
         FilterType m_filter_type = FilterType::none;
         std::set<Id> m_filter_name_ids;
 
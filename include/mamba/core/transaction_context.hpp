@@ -8,9 +8,12 @@
 #define MAMBA_CORE_TRANSACTION_CONTEXT
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "context.hpp"
 #include "mamba_fs.hpp"
+#include "package_info.hpp"
 
 namespace mamba
 {
@@ -22,6 +25,8 @@ namespace mamba
     fs::path get_python_noarch_target_path(const std::string& source_short_path,
                                            const fs::path& target_site_packages_short_path);
 
+    class TransactionJournal;
+
     class TransactionContext
     {
     public:
@@ -37,6 +42,21 @@ namespace mamba
         bool allow_softlinks = false;
         bool always_copy = false;
         bool always_softlink = false;
+
+        // compile the noarch python files of all the linked packages at once,
+        // see compile_deferred_pyc_files
+        bool defer_pyc_compilation = false;
+        // (conda-meta record, python files) of the packages waiting for compilation
+        std::vector<std::pair<fs::path, std::vector<fs::path>>> deferred_pyc_files;
+
+        // run the post-link scripts once all the packages are linked,
+        // see run_deferred_post_link_scripts
+        bool defer_post_link = false;
+        // all the linked packages, in linking order
+        std::vector<PackageInfo> deferred_post_link;
+
+        // when set, files are removed and created through the journal
+        TransactionJournal* journal = nullptr;
     };
 }  // namespace mamba
 
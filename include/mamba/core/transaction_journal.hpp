@@ -0,0 +1,84 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef MAMBA_CORE_TRANSACTION_JOURNAL_HPP
+#define MAMBA_CORE_TRANSACTION_JOURNAL_HPP
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mamba_fs.hpp"
+#include "util.hpp"
+
+#define TRANSACTION_JOURNAL_DIR ".transaction"
+
+namespace mamba
+{
+    // Crash-safe record of the changes made to a prefix by a transaction, kept
+    // in `<prefix>/conda-meta/.transaction`.
+    //
+    // Files removed from the prefix are moved to a backup folder of the same
+    // filesystem instead of being deleted, and files are journaled before being
+    // created. Rolling back removes the created files and moves the backups in
+    // place again, without reading the package records. Directories created for
+    // the new files are journaled too and removed with their content.
+    // Committing deletes the journal file, which is the single atomic step of
+    // the transaction.
+    //
+    // A journal left by a process that died is rolled back when the next write
+    // transaction of the prefix starts (see `recover`). Transactions and
+    // recoveries of a prefix are serialized across threads and processes.
+    class TransactionJournal
+    {
+    public:
+        explicit TransactionJournal(const fs::path& prefix);
+        ~TransactionJournal();
+
+        TransactionJournal(const TransactionJournal&) = delete;
+        TransactionJournal& operator=(const TransactionJournal&) = delete;
+
+        static fs::path journal_dir(const fs::path& prefix);
+        // Whether an interrupted transaction is waiting for a rollback
+        static bool pending(const fs::path& prefix);
+        // Rolls back an interrupted transaction, returns false if there was none.
+        // Waits for a transaction running on the prefix.
+        static bool recover(const fs::path& prefix);
+
+        const fs::path& prefix() const;
+
+        // Moves a file of the prefix to the backup instead of removing it
+        void remove(const fs::path& path);
+        // Journals files about to be written, backing up the existing ones
+        void create(const fs::path& path);
+        void create(const std::vector<fs::path>& paths);
+
+        void commit();
+        void rollback();
+
+    private:
+        class PrefixLock;
+
+        std::string relative(const fs::path& path) const;
+        void write(char op, const std::string& rel_path);
+
+        static void replay(const fs::path& prefix);
+
+        fs::path m_prefix;
+        fs::path m_dir;
+        std::unique_ptr<PrefixLock> m_lock;
+        std::ofstream m_journal;
+        std::set<std::string> m_created;
+        std::set<std::string> m_created_dirs;
+        std::mutex m_mutex;
+        bool m_active = true;
+    };
+}  // namespace mamba
+
+#endif
@@ -55,6 +55,8 @@ namespace mamba
     bool is_package_file(const std::string_view& fn);
 
     void to_human_readable_filesize(std::ostream& o, double bytes, std::size_t precision = 0);
+    // Parses sizes like "512", "300M" or "10GB" (powers of 1024)
+    std::size_t parse_human_readable_filesize(const std::string& size);
     bool lexists(const fs::path& p);
     std::vector<fs::path> filter_dir(const fs::path& dir, const std::string& suffix);
     bool paths_equal(const fs::path& lhs, const fs::path& rhs);
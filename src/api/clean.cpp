@@ -7,6 +7,7 @@
 #include "mamba/api/clean.hpp"
 #include "mamba/api/configuration.hpp"
 
+#include "mamba/core/content_store.hpp"
 #include "mamba/core/context.hpp"
 #include "mamba/core/package_cache.hpp"
 
@@ -25,8 +26,9 @@ namespace mamba
         bool clean_index = options & MAMBA_CLEAN_INDEX;
         bool clean_pkgs = options & MAMBA_CLEAN_PKGS;
         bool clean_tarballs = options & MAMBA_CLEAN_TARBALLS;
+        bool clean_lru = options & MAMBA_CLEAN_LRU;
 
-        if (!(clean_all || clean_index || clean_pkgs || clean_tarballs))
+        if (!(clean_all || clean_index || clean_pkgs || clean_tarballs || clean_lru))
         {
             std::cout << "Nothing to do." << std::endl;
             return;
@@ -235,6 +237,126 @@ namespace mamba
             }
         }
 
+        if (clean_lru)
+        {
+            if (ctx.package_cache_max_size.empty())
+            {
+                throw std::runtime_error(
+                    "No package cache size given, use '--max-size' or 'package_cache_max_size'");
+            }
+            std::size_t max_size = parse_human_readable_filesize(ctx.package_cache_max_size);
+
+            for (auto* pkg_cache : caches.writable_caches())
+            {
+                // the usage index avoids scanning every environment
+                PackageCacheUsage usage(pkg_cache->get_pkgs_dir());
+                LockFile lock(usage.lock_path());
+                usage.load();
+                usage.scan();
+
+                auto to_be_removed = usage.lru_candidates(max_size);
+                Console::stream() << "Package cache " << pkg_cache->get_pkgs_dir().string()
+                                  << ": " << get_file_size(usage.total_size()) << " (limit "
+                                  << get_file_size(max_size) << ")";
+                if (to_be_removed.empty())
+                {
+                    LOG_INFO << "Package cache fits in the size limit";
+                    continue;
+                }
+
+                std::vector<printers::FormattedString> header
+                    = { "Least recently used package", "Last used", "Size" };
+                mamba::printers::Table t(header);
+                t.set_alignment({ printers::alignment::left,
+                                  printers::alignment::left,
+                                  printers::alignment::right });
+                t.set_padding({ 2, 4, 4 });
+                std::size_t total_size = 0;
+                std::vector<std::vector<printers::FormattedString>> rows;
+                for (auto& pkg : to_be_removed)
+                {
+                    const auto& e = usage.entries().at(pkg);
+                    rows.push_back({ pkg,
+                                     timestamp(e.last_used),
+                                     get_file_size(e.size + e.tarballs_size) });
+                    total_size += e.size + e.tarballs_size;
+                }
+                t.add_rows(pkg_cache->get_pkgs_dir().string(), rows);
+                t.add_rows({}, { { "Total size: ", "", get_file_size(total_size) } });
+                t.print(std::cout);
+
+                if (!ctx.dry_run && Console::prompt("\nRemove least recently used packages", 'y'))
+                {
+                    for (auto& pkg : to_be_removed)
+                    {
+                        usage.remove_package(pkg);
+                    }
+                    usage.save();
+                }
+            }
+        }
+
+        // Files of the content store are referenced by hard links from the
+        // extracted packages, those left with a single link are unused
+        auto collect_store_files = [&]() {
+            std::vector<fs::path> res;
+            std::size_t total_size = 0;
+            std::vector<printers::FormattedString> header = { "Content store", "Files", "Size" };
+            mamba::printers::Table t(header);
+            t.set_alignment({ printers::alignment::left,
+                              printers::alignment::right,
+                              printers::alignment::right });
+            t.set_padding({ 2, 4, 4 });
+
+            for (auto* pkg_cache : caches.writable_caches())
+            {
+                ContentStore store(pkg_cache->get_pkgs_dir());
+                auto blobs = store.unreferenced_blobs();
+                if (blobs.empty())
+                {
+                    continue;
+                }
+
+                std::size_t store_size = 0;
+                for (auto& b : blobs)
+                {
+                    store_size += fs::file_size(b);
+                }
+                t.add_row({ store.path().string(),
+                            std::to_string(blobs.size()),
+                            get_file_size(store_size) });
+                total_size += store_size;
+                res.insert(res.end(), blobs.begin(), blobs.end());
+            }
+            if (total_size)
+            {
+                t.add_rows({}, { { "Total size: ", "", get_file_size(total_size) } });
+                t.print(std::cout);
+            }
+            return res;
+        };
+
+        if (clean_all || clean_pkgs || clean_lru)
+        {
+            auto to_be_removed = collect_store_files();
+            if (!ctx.dry_run)
+            {
+                Console::print("Cleaning content store..");
+
+                if (to_be_removed.size() == 0)
+                {
+                    LOG_INFO << "No unused content store files found";
+                }
+                else if (Console::prompt("\nRemove unused content store files", 'y'))
+                {
+                    for (auto& tbr : to_be_removed)
+                    {
+                        fs::remove(tbr);
+                    }
+                }
+            }
+        }
+
         config.operation_teardown();
     }
 }  // mamba
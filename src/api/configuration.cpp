@@ -11,6 +11,9 @@
 #include "mamba/core/environment.hpp"
 #include "mamba/core/fetch.hpp"
 #include "mamba/core/fsutil.hpp"
+#include "mamba/core/log_sink.hpp"
+#include "mamba/core/metrics.hpp"
+#include "mamba/core/trace.hpp"
 
 #include <reproc++/run.hpp>
 
@@ -67,6 +70,22 @@ namespace mamba
             }
         }
 
+        void package_cache_max_size_hook(std::string& value)
+        {
+            if (!value.empty())
+            {
+                parse_human_readable_filesize(value);
+            }
+        }
+
+        void readonly_pkgs_dirs_hook(std::vector<fs::path>& dirs)
+        {
+            for (auto& d : dirs)
+            {
+                d = fs::weakly_canonical(env::expand_user(d));
+            }
+        }
+
         void file_spec_env_name_hook(std::string& name)
         {
             if (name.find_first_of("/\\") != std::string::npos)
@@ -256,6 +275,33 @@ namespace mamba
             ctx.set_verbosity(lvl);
         }
 
+        void log_file_hook(fs::path& file)
+        {
+            if (!file.empty())
+            {
+                file = env::expand_user(file);
+            }
+            LogSink::instance().set_log_file(file);
+        }
+
+        void trace_file_hook(fs::path& file)
+        {
+            if (!file.empty())
+            {
+                file = env::expand_user(file);
+                Tracer::instance().start(file);
+            }
+        }
+
+        void metrics_file_hook(fs::path& file)
+        {
+            if (!file.empty())
+            {
+                file = env::expand_user(file);
+                Metrics::instance().start(file);
+            }
+        }
+
         void target_prefix_checks_hook(int& options)
         {
             auto& ctx = Context::instance();
@@ -499,6 +545,15 @@ namespace mamba
                    .set_single_op_lifetime()
                    .description("Packages specification"));
 
+        insert(Configurable("clone", std::string(""))
+                   .group("Basic")
+                   .set_single_op_lifetime()
+                   .description("Name or path of the environment to clone")
+                   .long_description(unindent(R"(
+                        Create the environment as a copy of an existing one, without
+                        solving nor downloading: the files of the existing environment
+                        are hard-linked and the ones holding its prefix are rewritten.)")));
+
         insert(Configurable("experimental", &ctx.experimental)
                    .group("Basic")
                    .description("Enable experimental features")
@@ -650,6 +705,42 @@ namespace mamba
                    .set_env_var_name()
                    .description("A list of package specs to pin for every environment resolution"));
 
+        insert(Configurable("solution_cache", &ctx.solution_cache)
+                   .group("Solver")
+                   .set_rc_configurable()
+                   .set_env_var_name()
+                   .description("Reuse the result of identical solves")
+                   .long_description(unindent(R"(
+                        Cache the solver results in the index cache of the package
+                        cache, keyed by the repodata (ETag and modification date),
+                        the installed packages, the pins, the solver flags and the
+                        requested specs. An identical solve then skips the solver.)")));
+
+        insert(Configurable("prune_incompatible", &ctx.prune_incompatible)
+                   .group("Solver")
+                   .set_rc_configurable()
+                   .set_env_var_name()
+                   .description("Remove the packages that cannot be installed before solving")
+                   .long_description(unindent(R"(
+                        Before solving, remove from the packages to consider the
+                        ones requiring virtual packages that are not available on
+                        this machine (e.g. __cuda without GPU or __osx on Linux),
+                        and the ones not matching the pins. This reduces the size
+                        of the problem, but unsatisfiable requests are then
+                        reported as missing packages.)")));
+
+        insert(Configurable("prune_unreachable", &ctx.prune_unreachable)
+                   .group("Solver")
+                   .set_rc_configurable()
+                   .set_env_var_name()
+                   .description("Only consider the packages the request can depend on")
+                   .long_description(unindent(R"(
+                        Before solving, remove from the packages to consider the
+                        ones whose name cannot be reached through the dependencies
+                        and the constraints of the requested and the installed
+                        packages, so that only the dependency closure of the
+                        request is part of the problem.)")));
+
         insert(Configurable("freeze_installed", &ctx.freeze_installed)
                    .group("Solver")
                    .description("Freeze already installed dependencies"));
@@ -693,6 +784,56 @@ namespace mamba
                         !WARNING: Using this option can result in corruption of long-lived
                         environments due to broken links (deleted cache).)")));
 
+        insert(Configurable("transaction_journal", &ctx.transaction_journal)
+                   .group("Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_name()
+                   .description("Journal the changes to the prefix during a transaction")
+                   .long_description(unindent(R"(
+                        Move the files removed by a transaction to a backup folder of the
+                        prefix and journal the files it creates, in 'conda-meta/.transaction'.
+                        An interrupted transaction, even by a crash of the process, is
+                        rolled back by moving the backup in place again, at the latest
+                        the next time the prefix is loaded.)")));
+
+        insert(Configurable("use_content_store", &ctx.use_content_store)
+                   .group("Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_name()
+                   .description("Deduplicate extracted package files across the package cache")
+                   .long_description(unindent(R"(
+                        Store the files of the extracted packages in a content-addressed
+                        store ('cas' folder of the package cache) keyed by their SHA-256
+                        checksum. Identical files of different packages are hard-linked
+                        to a single copy instead of being written again.
+                        Unused files are removed by 'clean --packages'.)")));
+
+        insert(Configurable("package_cache_max_size", &ctx.package_cache_max_size)
+                   .group("Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_name()
+                   .set_post_build_hook(detail::package_cache_max_size_hook)
+                   .description("Maximum size of the writable package caches (e.g. '20G')")
+                   .long_description(unindent(R"(
+                        When set, the least recently used packages that are not linked
+                        in any environment are removed from the writable package caches
+                        after each transaction, until each cache fits in this size.
+                        Usage is tracked in the 'usage.json' index of the package cache.)")));
+
+        insert(Configurable("readonly_pkgs_dirs", &ctx.readonly_pkgs_dirs)
+                   .group("Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_name()
+                   .set_post_build_hook(detail::readonly_pkgs_dirs_hook)
+                   .description("Read-only package caches searched after the writable ones")
+                   .long_description(unindent(R"(
+                        Package caches that are never written to, e.g. a shared cache
+                        on a network filesystem. They are searched in order after the
+                        writable package caches, and packages are hard-linked (or
+                        copied) from them. A read-only cache holding a 'manifest.json'
+                        index, written by 'micromamba constructor --write-manifest',
+                        is looked up in that index without accessing its packages.)")));
+
         insert(
             Configurable("shortcuts", &ctx.shortcuts)
                 .group("Link & Install")
@@ -719,6 +860,16 @@ namespace mamba
                         Spend extra time validating package contents. Currently, runs sha256
                         verification on every file within each package during installation.)")));
 
+        insert(Configurable("validation_threads", &ctx.validation_threads)
+                   .group("Link & Install")
+                   .set_rc_configurable()
+                   .set_env_var_name()
+                   .description("Number of threads used to verify package contents")
+                   .long_description(unindent(R"(
+                        Maximum number of threads used to compute the checksums of
+                        the files of cached packages when 'extra_safety_checks' is
+                        enabled. A value of 0 uses all the available cores.)")));
+
         insert(Configurable("verify_artifacts", &ctx.verify_artifacts)
                    .group("Link & Install")
                    .set_rc_configurable()
@@ -827,6 +978,39 @@ namespace mamba
                     fine-grained control, prefer 'log_level'.
                     'verbose' and 'log_level' are exclusive.)")));
 
+        insert(Configurable("log_file", &ctx.log_file)
+                   .group("Output, Prompt and Flow Control")
+                   .set_rc_configurable()
+                   .set_env_var_name()
+                   .set_post_build_hook(detail::log_file_hook)
+                   .description("Write the log messages to a file")
+                   .long_description(unindent(R"(
+                    Append the log messages to this file, in addition to the
+                    standard error. The verbosity applies to both.)")));
+
+        insert(Configurable("trace_file", &ctx.trace_file)
+                   .group("Output, Prompt and Flow Control")
+                   .set_env_var_name()
+                   .set_post_build_hook(detail::trace_file_hook)
+                   .description("Write a timeline of the operation to a file")
+                   .long_description(unindent(R"(
+                    Record the time spent fetching and loading the repodata,
+                    solving, downloading, extracting and linking the packages,
+                    and write it at exit to this file as a Chrome trace,
+                    which can be opened with https://ui.perfetto.dev.)")));
+
+        insert(Configurable("metrics_file", &ctx.metrics_file)
+                   .group("Output, Prompt and Flow Control")
+                   .set_env_var_name()
+                   .set_post_build_hook(detail::metrics_file_hook)
+                   .description("Write performance counters to a file")
+                   .long_description(unindent(R"(
+                    Write at exit the bytes downloaded per host, the repodata
+                    and package cache hits and misses, the time spent solving,
+                    extracting and linking, the linked files and the peak
+                    memory usage. The file is written as JSON when its name
+                    ends with '.json', in the Prometheus text format otherwise.)")));
+
         // Config
         insert(Configurable("rc_file", std::vector<fs::path>({}))
                    .group("Config sources")
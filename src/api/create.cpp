@@ -9,6 +9,11 @@
 #include "mamba/api/install.hpp"
 
 #include "mamba/core/context.hpp"
+#include "mamba/core/environment.hpp"
+#include "mamba/core/link.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/prefix_data.hpp"
+#include "mamba/core/transaction_context.hpp"
 
 
 namespace mamba
@@ -26,8 +31,15 @@ namespace mamba
 
         auto& create_specs = config.at("specs").value<std::vector<std::string>>();
         auto& use_explicit = config.at("explicit_install").value<bool>();
+        auto& clone_source = config.at("clone").value<std::string>();
 
-        if (!create_specs.empty())
+        if (!clone_source.empty() && !create_specs.empty())
+        {
+            LOG_ERROR << "Cannot clone an environment and install specs at the same time";
+            throw std::runtime_error("Aborting.");
+        }
+
+        if (!create_specs.empty() || !clone_source.empty())
         {
             if (ctx.target_prefix == ctx.root_prefix)
             {
@@ -56,7 +68,11 @@ namespace mamba
                 }
             }
 
-            if (use_explicit)
+            if (!clone_source.empty())
+            {
+                detail::clone_environment(clone_source);
+            }
+            else if (use_explicit)
             {
                 install_explicit_specs(create_specs);
             }
@@ -72,4 +88,90 @@ namespace mamba
 
         config.operation_teardown();
     }
+
+    namespace detail
+    {
+        void clone_environment(const std::string& source)
+        {
+            auto& ctx = Context::instance();
+
+            fs::path source_prefix;
+            if (source.find_first_of("/\\") == std::string::npos)
+            {
+                source_prefix = locate_prefix_by_name(source);
+            }
+            else
+            {
+                source_prefix = fs::weakly_canonical(env::expand_user(source));
+            }
+            if (!fs::exists(source_prefix / "conda-meta"))
+            {
+                LOG_ERROR << "No conda environment to clone at " << source_prefix;
+                throw std::runtime_error("Aborting.");
+            }
+            if (fs::weakly_canonical(ctx.target_prefix) == source_prefix)
+            {
+                LOG_ERROR << "Cannot clone an environment into itself";
+                throw std::runtime_error("Aborting.");
+            }
+
+            PrefixData source_data(source_prefix);
+            source_data.load();
+            auto pkgs = source_data.sorted_records();
+
+            if (ctx.json)
+            {
+                JsonLogger::instance().json_down("actions");
+                JsonLogger::instance().json_down("LINK");
+                for (const auto& pkg : pkgs)
+                {
+                    JsonLogger::instance().json_append(pkg.json());
+                }
+                JsonLogger::instance().json_up();
+                JsonLogger::instance().json_up();
+                JsonLogger::instance().json_write(
+                    { { "dry_run", ctx.dry_run }, { "prefix", ctx.target_prefix } });
+                Console::instance().print(JsonLogger::instance().json_log.dump(4), true);
+            }
+            else
+            {
+                Console::stream() << "\nCloning the " << pkgs.size() << " packages of "
+                                  << source_prefix.string() << "\n";
+                for (const auto& pkg : pkgs)
+                {
+                    Console::stream() << "  + " << pkg.name << " " << pkg.version << " "
+                                      << pkg.build_string;
+                }
+            }
+
+            if (ctx.dry_run)
+            {
+                Console::stream() << "Dry run. Not executing transaction.";
+                return;
+            }
+            if (!Console::prompt("Confirm changes", 'y'))
+            {
+                return;
+            }
+
+            // no repodata nor solve, the source environment is the package cache
+            Console::stream() << "\nTransaction starting";
+            detail::create_target_directory(ctx.target_prefix);
+            TransactionContext transaction_context(ctx.target_prefix, "");
+            clone_packages(source_prefix, pkgs, &transaction_context);
+
+            // the files created by the scripts of the source environment are not recorded
+            transaction_context.deferred_post_link = pkgs;
+            run_deferred_post_link_scripts(&transaction_context);
+
+            History::UserRequest ur = History::UserRequest::prefilled();
+            for (const auto& pkg : pkgs)
+            {
+                ur.link_dists.push_back(pkg.long_str());
+            }
+            PrefixData prefix_data(ctx.target_prefix);
+            prefix_data.history().add_entry(ur);
+            Console::stream() << "Transaction finished";
+        }
+    }
 }
@@ -19,6 +19,7 @@
 #include "mamba/core/subdirdata.hpp"
 #include "mamba/core/thread_utils.hpp"
 #include "mamba/core/transaction.hpp"
+#include "mamba/core/transaction_journal.hpp"
 #include "mamba/core/url.hpp"
 #include "mamba/core/util.hpp"
 #include "mamba/core/virtual_packages.hpp"
@@ -400,6 +401,8 @@ namespace mamba
             LOG_INFO << "Creating repo from pkgs_dir for offline";
             repos.push_back(detail::create_repo_from_pkgs_dir(pool, pkgs_dirs));
         }
+        // the state left by an interrupted transaction must not be solved for
+        TransactionJournal::recover(ctx.target_prefix);
         PrefixData prefix_data(ctx.target_prefix);
         prefix_data.load();
 
@@ -464,6 +467,31 @@ namespace mamba
             throw std::runtime_error("Could not load repodata. Cache corrupted?");
         }
 
+        std::vector<std::string> pins;
+        if (!no_pin)
+        {
+            pins = file_pins(prefix_data.path() / "conda-meta" / "pinned");
+            pins.insert(pins.end(), ctx.pinned_packages.begin(), ctx.pinned_packages.end());
+        }
+
+        if (!no_py_pin)
+        {
+            auto py_pin = python_pin(prefix_data, specs);
+            if (!py_pin.empty())
+            {
+                pins.push_back(py_pin);
+            }
+        }
+
+        if (ctx.prune_incompatible)
+        {
+            pool.prune_incompatible(pins);
+        }
+        if (ctx.prune_unreachable)
+        {
+            pool.prune_unreachable(specs);
+        }
+
         MSolver solver(pool,
                        { { SOLVER_FLAG_ALLOW_DOWNGRADE, 1 },
                          { SOLVER_FLAG_STRICT_REPO_PRIORITY,
@@ -476,21 +504,7 @@ namespace mamba
         }
 
         solver.add_jobs(specs, solver_flag);
-
-        if (!no_pin)
-        {
-            solver.add_pins(file_pins(prefix_data.path() / "conda-meta" / "pinned"));
-            solver.add_pins(ctx.pinned_packages);
-        }
-
-        if (!no_py_pin)
-        {
-            auto py_pin = python_pin(prefix_data, specs);
-            if (!py_pin.empty())
-            {
-                solver.add_pin(py_pin);
-            }
-        }
+        solver.add_pins(pins);
         if (!solver.pinned_specs().empty())
         {
             std::vector<std::string> pinned_str;
@@ -596,8 +610,7 @@ namespace mamba
             JsonLogger::instance().json_write({ { "success", true } });
 
             if (Context::instance().json)
-                Console::instance().print(JsonLogger::instance().json_log.unflatten().dump(4),
-                                          true);
+                Console::instance().print(JsonLogger::instance().json_log.dump(4), true);
         }
 
         void create_target_directory(const fs::path prefix)
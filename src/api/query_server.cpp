@@ -0,0 +1,29 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include "mamba/api/query_server.hpp"
+#include "mamba/api/configuration.hpp"
+
+#include "mamba/core/output.hpp"
+#include "mamba/core/query_server.hpp"
+
+
+namespace mamba
+{
+    void query_server(const std::string& socket_path)
+    {
+        auto& config = Configuration::instance();
+
+        config.at("show_banner").set_value(false);
+        config.load();
+
+        Console::print("Serving queries on " + socket_path);
+        QueryServer server;
+        server.serve(socket_path);
+
+        config.operation_teardown();
+    }
+}
@@ -7,19 +7,20 @@
 #include "mamba/api/remove.hpp"
 
 #include "mamba/api/configuration.hpp"
+#include "mamba/core/link.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_cache.hpp"
 #include "mamba/core/prefix_data.hpp"
 #include "mamba/core/repo.hpp"
 #include "mamba/core/solver.hpp"
 #include "mamba/core/transaction.hpp"
+#include "mamba/core/transaction_journal.hpp"
 
 
 namespace mamba
 {
     void remove(bool remove_all)
     {
-        auto& ctx = Context::instance();
         auto& config = Configuration::instance();
 
         config.at("use_target_prefix_fallback").set_value(true);
@@ -32,16 +33,9 @@ namespace mamba
 
         if (remove_all)
         {
-            PrefixData prefix_data(ctx.target_prefix);
-            prefix_data.load();
-
-            for (const auto& package : prefix_data.m_package_records)
-            {
-                remove_specs.push_back(package.second.name);
-            }
+            detail::remove_all_packages();
         }
-
-        if (!remove_specs.empty())
+        else if (!remove_specs.empty())
         {
             detail::remove_specs(remove_specs);
         }
@@ -55,6 +49,83 @@ namespace mamba
 
     namespace detail
     {
+        void remove_all_packages()
+        {
+            auto& ctx = Context::instance();
+
+            if (ctx.target_prefix.empty())
+            {
+                LOG_ERROR << "No active target prefix.";
+                throw std::runtime_error("Aborted.");
+            }
+
+            TransactionJournal::recover(ctx.target_prefix);
+            PrefixData prefix_data(ctx.target_prefix);
+            prefix_data.load();
+            if (prefix_data.m_package_records.empty())
+            {
+                Console::print("Nothing to do.");
+                return;
+            }
+
+            std::vector<PackageInfo> pkgs;
+            for (const auto& [name, record] : prefix_data.m_package_records)
+            {
+                pkgs.push_back(record);
+            }
+            std::sort(pkgs.begin(), pkgs.end(), [](const auto& a, const auto& b) {
+                return a.name < b.name;
+            });
+
+            if (ctx.json)
+            {
+                JsonLogger::instance().json_down("actions");
+                JsonLogger::instance().json_down("UNLINK");
+                for (const auto& pkg : pkgs)
+                {
+                    JsonLogger::instance().json_append(pkg.json());
+                }
+                JsonLogger::instance().json_up();
+                JsonLogger::instance().json_up();
+                JsonLogger::instance().json_write(
+                    { { "dry_run", ctx.dry_run }, { "prefix", ctx.target_prefix } });
+                Console::instance().print(JsonLogger::instance().json_log.dump(4), true);
+            }
+            else
+            {
+                Console::stream() << "\nRemoving all the " << pkgs.size() << " packages of "
+                                  << ctx.target_prefix.string() << "\n";
+                for (const auto& pkg : pkgs)
+                {
+                    Console::stream() << "  - " << pkg.name << " " << pkg.version << " "
+                                      << pkg.build_string;
+                }
+            }
+
+            if (ctx.dry_run)
+            {
+                Console::stream() << "Dry run. Not executing transaction.";
+                return;
+            }
+            if (!Console::prompt("Confirm changes", 'y'))
+            {
+                return;
+            }
+
+            // no solve nor per package transaction when the whole prefix goes away
+            Console::stream() << "\nTransaction starting";
+            History::UserRequest ur = History::UserRequest::prefilled();
+            TransactionContext transaction_context(ctx.target_prefix, "");
+            unlink_packages(pkgs, &transaction_context);
+            for (const auto& pkg : pkgs)
+            {
+                ur.remove.push_back(pkg.name);
+                ur.unlink_dists.push_back(pkg.long_str());
+            }
+            prefix_data.history().add_entry(ur);
+            Console::stream() << "Transaction finished";
+        }
+
         void remove_specs(const std::vector<std::string>& specs)
         {
             auto& ctx = Context::instance();
@@ -67,6 +138,7 @@ namespace mamba
 
             std::vector<MRepo> repos;
             MPool pool;
+            TransactionJournal::recover(ctx.target_prefix);
             PrefixData prefix_data(ctx.target_prefix);
             prefix_data.load();
             auto repo = MRepo(pool, prefix_data);
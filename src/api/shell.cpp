@@ -98,8 +98,7 @@ namespace mamba
                       { "context", { { "shell_type", shell_type } } },
                       { "actions", { { "print", { activator->hook() } } } } });
                 if (Context::instance().json)
-                    Console::instance().print(JsonLogger::instance().json_log.unflatten().dump(4),
-                                              true);
+                    Console::instance().print(JsonLogger::instance().json_log.dump(4), true);
             }
             else
             {
@@ -9,6 +9,7 @@
 #include "mamba/api/update.hpp"
 
 #include "mamba/core/context.hpp"
+#include "mamba/core/transaction_journal.hpp"
 #include "mamba/core/virtual_packages.hpp"
 
 
@@ -29,6 +30,7 @@ namespace mamba
 
         if (update_all)
         {
+            TransactionJournal::recover(ctx.target_prefix);
             PrefixData prefix_data(ctx.target_prefix);
             prefix_data.load();
 
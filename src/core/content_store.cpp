@@ -0,0 +1,181 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "mamba/core/content_store.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/package_paths.hpp"
+#include "mamba/core/validate.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        fs::perms current_umask()
+        {
+#ifdef _WIN32
+            return fs::perms::none;
+#else
+#ifdef __linux__
+            // setting the umask to read it would race with the files
+            // created by the other extraction threads
+            std::ifstream status("/proc/self/status");
+            std::string line;
+            while (std::getline(status, line))
+            {
+                if (line.rfind("Umask:", 0) == 0)
+                {
+                    return static_cast<fs::perms>(std::stoul(line.substr(6), nullptr, 8));
+                }
+            }
+#endif
+            mode_t mask = ::umask(0);
+            ::umask(mask);
+            return static_cast<fs::perms>(mask);
+#endif
+        }
+    }
+
+    ContentStore::ContentStore(const fs::path& pkgs_dir)
+        : m_path(pkgs_dir / CONTENT_STORE_DIR)
+        , m_umask(current_umask())
+    {
+    }
+
+    const fs::path& ContentStore::path() const
+    {
+        return m_path;
+    }
+
+    fs::path ContentStore::blob_path(const std::string& sha256, fs::perms perms) const
+    {
+        // identical contents with different modes (e.g. executable bit)
+        // cannot share the same inode. The permissions of an archive entry
+        // and of an extracted file must give the same key, only the bits
+        // left by the umask are used.
+        std::stringstream name;
+        name << sha256 << "-" << std::oct << std::setw(3) << std::setfill('0')
+             << static_cast<unsigned>(perms & ~m_umask & fs::perms::all);
+        return m_path / sha256.substr(0, 2) / name.str();
+    }
+
+    bool ContentStore::link(const std::string& sha256,
+                            fs::perms perms,
+                            const fs::path& target) const
+    {
+        fs::path blob = blob_path(sha256, perms);
+        if (!fs::exists(blob))
+        {
+            return false;
+        }
+
+        try
+        {
+            fs::create_directories(target.parent_path());
+            if (fs::exists(target) || fs::is_symlink(target))
+            {
+                fs::remove(target);
+            }
+            fs::create_hard_link(blob, target);
+        }
+        catch (const fs::filesystem_error& e)
+        {
+            LOG_DEBUG << "Could not link " << target << " from content store: " << e.what();
+            return false;
+        }
+        return true;
+    }
+
+    void ContentStore::deduplicate(const fs::path& extract_dir) const
+    {
+        std::vector<PathData> paths_data;
+        try
+        {
+            paths_data = read_paths(extract_dir);
+        }
+        catch (const std::exception& e)
+        {
+            LOG_WARNING << "Could not read 'paths.json' from " << extract_dir
+                        << ", skipping content store: " << e.what();
+            return;
+        }
+
+        std::size_t stored = 0, linked = 0;
+        for (const auto& p : paths_data)
+        {
+            // old packages don't have checksums in paths.json
+            if (p.path_type != PathType::HARDLINK || p.sha256.empty())
+            {
+                continue;
+            }
+
+            fs::path file = extract_dir / p.path;
+            try
+            {
+                if (fs::is_symlink(file) || !fs::is_regular_file(file)
+                    || fs::hard_link_count(file) > 1)
+                {
+                    // already linked from the store during extraction
+                    continue;
+                }
+
+                fs::path blob = blob_path(p.sha256, fs::status(file).permissions());
+                if (fs::exists(blob))
+                {
+                    fs::path tmp = file;
+                    tmp += ".mamba_cas";
+                    fs::create_hard_link(blob, tmp);
+                    fs::rename(tmp, file);
+                    ++linked;
+                }
+                else
+                {
+                    // never store a blob under a wrong key
+                    if (!validate::sha256(file, p.sha256))
+                    {
+                        LOG_WARNING << "File " << file
+                                    << " has incorrect SHA-256 checksum, not stored";
+                        continue;
+                    }
+                    fs::create_directories(blob.parent_path());
+                    fs::create_hard_link(file, blob);
+                    ++stored;
+                }
+            }
+            catch (const fs::filesystem_error& e)
+            {
+                LOG_DEBUG << "Could not deduplicate " << file << ": " << e.what();
+            }
+        }
+        LOG_DEBUG << "Content store: " << stored << " files added and " << linked
+                  << " files linked for " << extract_dir;
+    }
+
+    std::vector<fs::path> ContentStore::unreferenced_blobs() const
+    {
+        std::vector<fs::path> res;
+        if (!fs::exists(m_path))
+        {
+            return res;
+        }
+
+        for (auto& p : fs::recursive_directory_iterator(m_path))
+        {
+            if (p.is_regular_file() && fs::hard_link_count(p.path()) == 1)
+            {
+                res.push_back(p.path());
+            }
+        }
+        return res;
+    }
+}  // namespace mamba
@@ -119,6 +119,10 @@ namespace mamba
                   PRINT_CTX(dry_run)
                   PRINT_CTX(always_yes)
                   PRINT_CTX(allow_softlinks)
+                  PRINT_CTX(transaction_journal)
+                  PRINT_CTX(use_content_store)
+                  PRINT_CTX(package_cache_max_size)
+                  PRINT_CTX_VEC(readonly_pkgs_dirs)
                   PRINT_CTX(offline)
                   PRINT_CTX(quiet)
                   PRINT_CTX(no_rc)
@@ -134,10 +138,17 @@ namespace mamba
                   PRINT_CTX(use_only_tar_bz2)
                   PRINT_CTX(auto_activate_base)
                   PRINT_CTX(extra_safety_checks)
+                  PRINT_CTX(validation_threads)
                   PRINT_CTX(max_parallel_downloads)
                   PRINT_CTX(verbosity)
+                  PRINT_CTX(log_file)
+                  PRINT_CTX(trace_file)
+                  PRINT_CTX(metrics_file)
                   PRINT_CTX(channel_alias)
                   << "channel_priority: " << (int) channel_priority << "\n"
+                  PRINT_CTX(solution_cache)
+                  PRINT_CTX(prune_incompatible)
+                  PRINT_CTX(prune_unreachable)
                   PRINT_CTX_VEC(default_channels)
                   PRINT_CTX_VEC(channels)
                   PRINT_CTX_VEC(pinned_packages)
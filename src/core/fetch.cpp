@@ -10,7 +10,9 @@
 
 #include "mamba/core/fetch.hpp"
 #include "mamba/core/context.hpp"
+#include "mamba/core/metrics.hpp"
 #include "mamba/core/thread_utils.hpp"
+#include "mamba/core/trace.hpp"
 #include "mamba/core/util.hpp"
 #include "mamba/core/url.hpp"
 
@@ -338,13 +340,6 @@ namespace mamba
             return 0;
         }
 
-        auto now = std::chrono::steady_clock::now();
-        if (now - m_progress_throttle_time < std::chrono::milliseconds(150))
-        {
-            return 0;
-        }
-        m_progress_throttle_time = now;
-
         if (total_to_download != 0 && now_downloaded == 0 && m_expected_size != 0)
         {
             now_downloaded = total_to_download;
@@ -353,28 +348,13 @@ namespace mamba
 
         if ((total_to_download != 0 || m_expected_size != 0) && now_downloaded != 0)
         {
-            std::stringstream postfix;
-            postfix << std::setw(6);
-            to_human_readable_filesize(postfix, now_downloaded);
-            postfix << " / ";
-            postfix << std::setw(6);
-            to_human_readable_filesize(postfix, total_to_download);
-            postfix << " (";
-            postfix << std::setw(6);
-            to_human_readable_filesize(postfix, get_speed(), 2);
-            postfix << "/s)";
             m_progress_bar.set_progress(now_downloaded, total_to_download);
-            m_progress_bar.set_postfix(postfix.str());
+            m_progress_bar.set_transfer(now_downloaded, total_to_download, get_speed());
         }
         if (now_downloaded == 0 && total_to_download != 0)
         {
-            std::stringstream postfix;
-            to_human_readable_filesize(postfix, total_to_download);
-            postfix << " / ?? (";
-            to_human_readable_filesize(postfix, get_speed(), 2);
-            postfix << "/s)";
             m_progress_bar.set_progress(SIZE_MAX, SIZE_MAX);
-            m_progress_bar.set_postfix(postfix.str());
+            m_progress_bar.set_transfer(total_to_download, SIZE_MAX, get_speed());
         }
         return 0;
     }
@@ -511,6 +491,21 @@ namespace mamba
 
         LOG_INFO << "Transfer finalized, status: " << http_status << " [" << effective_url << "] "
                  << downloaded_size << " bytes";
+        Metrics::instance().add_download(effective_url, downloaded_size, avg_speed);
+
+        if (Tracer::instance().enabled())
+        {
+            curl_off_t total_time = 0;
+            curl_easy_getinfo(m_handle, CURLINFO_TOTAL_TIME_T, &total_time);
+            auto end = Tracer::clock::now();
+            Tracer::instance().async("download",
+                                     m_name,
+                                     end - std::chrono::microseconds(total_time),
+                                     end,
+                                     { { "url", effective_url },
+                                       { "size", downloaded_size },
+                                       { "http_status", http_status } });
+        }
 
         if (http_status >= 500 && can_retry())
         {
@@ -636,6 +631,8 @@ namespace mamba
 
     bool MultiDownloadTarget::download(bool failfast)
     {
+        TraceSpan span("download", "MultiDownloadTarget::download");
+        span.arg("targets", m_targets.size());
         LOG_INFO << "Starting to download targets";
 
         int still_running, repeats = 0;
@@ -703,6 +700,9 @@ namespace mamba
             }
         } while ((still_running || !m_retry_targets.empty()) && !is_sig_interrupted());
 
+        // the final state of the progress bars
+        Console::instance().render_progress();
+
         if (is_sig_interrupted())
         {
             Console::print("Download interrupted");
@@ -4,7 +4,12 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <regex>
+#include <set>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -16,21 +21,115 @@
 #include "mamba/core/menuinst.hpp"
 #include "mamba/core/link.hpp"
 #include "mamba/core/match_spec.hpp"
+#include "mamba/core/metrics.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/transaction_context.hpp"
+#include "mamba/core/transaction_journal.hpp"
 #include "mamba/core/util.hpp"
 #include "mamba/core/validate.hpp"
 #include "mamba/core/shell_init.hpp"
+#include "mamba/core/thread_utils.hpp"
+#include "mamba/core/trace.hpp"
 #include "mamba/core/activation.hpp"
 
 #if _WIN32
 #include "../data/conda_exe.hpp"
 #endif
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+
 namespace mamba
 {
     static const std::regex MENU_PATH_REGEX("^menu[/\\\\].*\\.json$", std::regex_constants::icase);
 
+    // Copy-on-write clone of src, on the filesystems supporting it (btrfs, xfs, apfs...).
+    // Much cheaper than a copy when a package cannot be hard-linked from its cache.
+    static bool reflink(const fs::path& src, const fs::path& dst)
+    {
+#if defined(__linux__) && defined(FICLONE)
+        int src_fd = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+        if (src_fd < 0)
+        {
+            return false;
+        }
+        bool cloned = false;
+        struct stat st;
+        if (::fstat(src_fd, &st) == 0)
+        {
+            int dst_fd = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+            if (dst_fd >= 0)
+            {
+                cloned = ::ioctl(dst_fd, FICLONE, src_fd) == 0
+                         && ::fchmod(dst_fd, st.st_mode & 07777) == 0;
+                ::close(dst_fd);
+                if (!cloned)
+                {
+                    ::unlink(dst.c_str());
+                }
+            }
+        }
+        ::close(src_fd);
+        return cloned;
+#elif defined(__APPLE__)
+        return ::clonefile(src.c_str(), dst.c_str(), 0) == 0;
+#else
+        return false;
+#endif
+    }
+
+    // Removes a file of the prefix, keeping a backup when the transaction is journaled
+    static void remove_prefix_path(TransactionContext* context, const fs::path& path)
+    {
+        if (context->journal)
+        {
+            context->journal->remove(path);
+        }
+        else
+        {
+            fs::remove(path);
+        }
+    }
+
+    // Journals a file of the prefix before it is written
+    static void create_prefix_path(TransactionContext* context, const fs::path& path)
+    {
+        if (context->journal)
+        {
+            context->journal->create(path);
+        }
+    }
+
+#if defined(__APPLE__)
+    // Binaries patched on osx-arm64 must be signed again
+    static void codesign(const fs::path& path)
+    {
+        reproc::options options;
+        if (Context::instance().verbosity <= 1)
+        {
+            reproc::redirect silence{};
+            silence.type = reproc::redirect::discard;
+            options.redirect.out = silence;
+            options.redirect.err = silence;
+        }
+
+        std::vector<std::string> cmd = { "/usr/bin/codesign", "-s", "-", "-f", path.string() };
+        auto [status, ec] = reproc::run(cmd, options);
+        if (ec)
+        {
+            throw std::runtime_error(std::string("Could not codesign executable")
+                                     + ec.message());
+        }
+    }
+#endif
+
     void python_entry_point_template(std::ostream& out, const python_entry_point_parsed& p)
     {
         auto import_name = split(p.func, ".")[0];
@@ -143,8 +242,9 @@ namespace mamba
             std::cerr << termcolor::yellow << "Clobberwarning: " << termcolor::reset
                       << "$CONDA_PREFIX/"
                       << fs::relative(script_path, m_context->target_prefix).string() << std::endl;
-            fs::remove(script_path);
+            remove_prefix_path(m_context, script_path);
         }
+        create_prefix_path(m_context, script_path);
         std::ofstream out_file(script_path);
 
         fs::path python_path;
@@ -177,9 +277,10 @@ namespace mamba
         {
             std::cerr << termcolor::yellow << "Clobberwarning: " << termcolor::reset
                       << "$CONDA_PREFIX/" << script_exe.string() << std::endl;
-            fs::remove(m_context->target_prefix / script_exe);
+            remove_prefix_path(m_context, m_context->target_prefix / script_exe);
         }
 
+        create_prefix_path(m_context, m_context->target_prefix / script_exe);
         std::ofstream conda_exe_f(m_context->target_prefix / script_exe, std::ios::binary);
         conda_exe_f.write(reinterpret_cast<char*>(conda_exe), conda_exe_len);
         conda_exe_f.close();
@@ -515,27 +616,38 @@ namespace mamba
         return std::make_tuple(command_args, std::move(script_file));
     }
 
-    /*
-       call the post-link or pre-unlink script and return true / false on success /
-       failure
-    */
-    bool run_script(const fs::path& prefix,
-                    const PackageInfo& pkg_info,
-                    const std::string& action = "post-link",
-                    const std::string& env_prefix = "",
-                    bool activate = false)
+    static fs::path script_path(const fs::path& prefix,
+                                const PackageInfo& pkg_info,
+                                const std::string& action)
     {
-        fs::path path;
         if (on_win)
         {
-            path = prefix / get_bin_directory_short_path()
+            return prefix / get_bin_directory_short_path()
                    / concat(".", pkg_info.name, "-", action, ".bat");
         }
         else
         {
-            path = prefix / get_bin_directory_short_path()
+            return prefix / get_bin_directory_short_path()
                    / concat(".", pkg_info.name, "-", action, ".sh");
         }
+    }
+
+    /*
+       call the post-link or pre-unlink script and return true / false on success /
+       failure
+       when output is given, the output of the script is captured there instead of
+       being forwarded, and the prefix messages are left to the caller
+    */
+    bool run_script(const fs::path& prefix,
+                    const PackageInfo& pkg_info,
+                    const std::string& action = "post-link",
+                    const std::string& env_prefix = "",
+                    bool activate = false,
+                    std::string* output = nullptr)
+    {
+        fs::path path = script_path(prefix, pkg_info, action);
+        TraceSpan span("link", "run_script");
+        span.arg("package", pkg_info.name).arg("action", action);
 
         if (!fs::exists(path))
         {
@@ -628,7 +740,7 @@ namespace mamba
         LOG_TRACE << "Calling " << cargs;
 
         reproc::options options;
-        options.redirect.parent = true;
+        options.redirect.parent = output == nullptr;
         options.env.behavior = reproc::env::extend;
         options.env.extra = envmap;
         std::string cwd = path.parent_path();
@@ -641,17 +753,29 @@ namespace mamba
                   << "\n PKG_BUILDNUM: " << envmap["PKG_BUILDNUM"] << "\n PATH: " << envmap["PATH"]
                   << "\n CWD: " << cwd;
 
-        auto [status, ec] = reproc::run(command_args, options);
-
-        auto msg = get_prefix_messages(envmap["PREFIX"]);
-        if (Context::instance().json)
+        int status;
+        std::error_code ec;
+        if (output != nullptr)
         {
-            // TODO implement cerr also on Console?
-            std::cerr << msg;
+            options.redirect.out.type = reproc::redirect::pipe;
+            options.redirect.err.type = reproc::redirect::pipe;
+            reproc::sink::string sink(*output);
+            std::tie(status, ec) = reproc::run(command_args, options, sink, sink);
         }
         else
         {
-            Console::print(msg);
+            std::tie(status, ec) = reproc::run(command_args, options);
+
+            auto msg = get_prefix_messages(envmap["PREFIX"]);
+            if (Context::instance().json)
+            {
+                // TODO implement cerr also on Console?
+                std::cerr << msg;
+            }
+            else
+            {
+                Console::print(msg);
+            }
         }
 
         if (ec)
@@ -663,6 +787,12 @@ namespace mamba
             }
             throw std::runtime_error("failed to execute pre/post link script for " + pkg_info.name);
         }
+        if (status != 0)
+        {
+            LOG_ERROR << action << " script for '" << pkg_info.name << "' exited with status "
+                      << status;
+            return false;
+        }
         return true;
     }
 
@@ -680,7 +810,7 @@ namespace mamba
     {
         std::string subtarget = path_data["_path"].get<std::string>();
         fs::path dst = m_context->target_prefix / subtarget;
-        fs::remove(dst);
+        remove_prefix_path(m_context, dst);
 
         // TODO what do we do with empty directories?
         // remove empty parent path
@@ -715,11 +845,344 @@ namespace mamba
 
         json_file.close();
 
-        fs::remove(json);
+        remove_prefix_path(m_context, json);
+
+        return true;
+    }
+
+    std::size_t unlink_packages(const std::vector<PackageInfo>& pkgs, TransactionContext* context)
+    {
+        const fs::path& prefix = context->target_prefix;
+        fs::path meta_dir = prefix / "conda-meta";
+
+        // only the file lists are kept from the records
+        auto only_files
+            = [](int depth, nlohmann::json::parse_event_t event, nlohmann::json& parsed) {
+                  return depth != 1 || event != nlohmann::json::parse_event_t::key
+                         || parsed == "files";
+              };
+        std::vector<std::vector<std::string>> pkg_files(pkgs.size());
+        parallel_for(pkgs.size(), 0, [&](std::size_t i) {
+            fs::path record = meta_dir / (pkgs[i].str() + ".json");
+            try
+            {
+                std::ifstream record_file(record);
+                auto j = nlohmann::json::parse(record_file, only_files);
+                pkg_files[i] = j.value("files", std::vector<std::string>());
+            }
+            catch (const nlohmann::json::exception& e)
+            {
+                LOG_WARNING << "Could not read the files of " << pkgs[i].str() << " from "
+                            << record << ": " << e.what();
+            }
+        });
+
+        std::vector<fs::path> files;
+        std::set<fs::path> dirs;
+        for (const auto& pf : pkg_files)
+        {
+            for (const auto& f : pf)
+            {
+                if (on_win && std::regex_match(f, MENU_PATH_REGEX))
+                {
+                    remove_menu_from_json(prefix / f, context);
+                }
+                files.push_back(f);
+                fs::path parent = files.back().parent_path();
+                while (!parent.empty() && dirs.insert(parent).second)
+                {
+                    parent = parent.parent_path();
+                }
+            }
+        }
+
+        std::atomic<std::size_t> removed(0);
+        parallel_for(files.size(), 0, [&](std::size_t i) {
+            std::error_code ec;
+            if (fs::remove(prefix / files[i], ec))
+            {
+                ++removed;
+            }
+            else if (ec)
+            {
+                LOG_DEBUG << "Could not remove " << files[i] << ": " << ec.message();
+            }
+        });
+
+        for (const auto& pkg : pkgs)
+        {
+            std::error_code ec;
+            fs::remove(meta_dir / (pkg.str() + ".json"), ec);
+        }
+
+        // children sort after their parent, a reverse pass removes the
+        // emptied directories bottom-up
+        for (auto it = dirs.rbegin(); it != dirs.rend(); ++it)
+        {
+            fs::path dir = prefix / *it;
+            std::error_code ec;
+            if (fs::is_directory(fs::symlink_status(dir, ec)) && fs::is_empty(dir, ec))
+            {
+                fs::remove(dir, ec);
+            }
+        }
 
+        LOG_DEBUG << "Removed " << removed << " files of " << pkgs.size() << " packages";
+        return removed;
+    }
+
+    // Replaces old_prefix by new_prefix in the C strings of a binary, keeping
+    // their size: a shorter prefix is padded with null bytes, a longer one
+    // takes at most max_padding of the null bytes that follow the string
+    // (the padding left when the placeholder was replaced by old_prefix).
+    static bool replace_binary_prefix(std::string& buffer,
+                                      const std::string& old_prefix,
+                                      const std::string& new_prefix,
+                                      std::size_t max_padding)
+    {
+        std::size_t pos = buffer.find(old_prefix);
+        while (pos != std::string::npos)
+        {
+            std::size_t end = std::min(buffer.find('\0', pos), buffer.size());
+            std::string suffix = buffer.substr(pos + old_prefix.size(),
+                                               end - pos - old_prefix.size());
+            std::string replacement = concat(new_prefix, suffix);
+            if (replacement.size() <= end - pos)
+            {
+                replacement.resize(end - pos, '\0');
+            }
+            else
+            {
+                // the null terminator must be kept
+                std::size_t extra = replacement.size() - (end - pos);
+                std::size_t nulls = end;
+                while (nulls < buffer.size() && buffer[nulls] == '\0')
+                {
+                    ++nulls;
+                }
+                if (extra > max_padding || end + extra >= nulls)
+                {
+                    return false;
+                }
+            }
+            buffer.replace(pos, replacement.size(), replacement);
+            pos = buffer.find(old_prefix, pos + new_prefix.size());
+        }
         return true;
     }
 
+    std::size_t clone_packages(const fs::path& source,
+                               const std::vector<PackageInfo>& pkgs,
+                               TransactionContext* context)
+    {
+        const fs::path& prefix = context->target_prefix;
+        std::string old_prefix = source.string(), new_prefix = prefix.string();
+#ifdef _WIN32
+        replace_all(old_prefix, "\\", "/");
+        replace_all(new_prefix, "\\", "/");
+#endif
+        fs::create_directories(prefix / "conda-meta");
+
+        std::atomic<std::size_t> cloned(0), patched(0);
+
+        // the paths written per package, removed if the cloning fails
+        std::vector<std::vector<fs::path>> pkg_created(pkgs.size());
+
+        // Links or rewrites a path of a record, updates its checksum if rewritten
+        auto clone_path = [&](nlohmann::json& path_data,
+                              [[maybe_unused]] const std::string& subdir,
+                              std::vector<fs::path>& created) {
+            std::string rel_path = path_data["_path"].get<std::string>();
+            fs::path src = source / rel_path;
+            fs::path dst = prefix / rel_path;
+
+            std::error_code ec;
+            auto status = fs::symlink_status(src, ec);
+            if (ec || !fs::exists(status))
+            {
+                LOG_WARNING << "File " << src << " does not exist, not cloned";
+                return;
+            }
+            fs::create_directories(dst.parent_path(), ec);
+            if (lexists(dst))
+            {
+                fs::remove(dst);
+            }
+            created.push_back(rel_path);
+
+            if (fs::is_symlink(status))
+            {
+                std::string link_target = fs::read_symlink(src).string();
+                if (starts_with(link_target, source.string())
+                    && (link_target.size() == source.string().size()
+                        || link_target[source.string().size()] == fs::path::preferred_separator))
+                {
+                    fs::create_symlink(prefix.string()
+                                           + link_target.substr(source.string().size()),
+                                       dst);
+                }
+                else
+                {
+                    fs::copy_symlink(src, dst);
+                }
+                ++cloned;
+                return;
+            }
+            if (fs::is_directory(status))
+            {
+                fs::create_directories(dst);
+                ++cloned;
+                return;
+            }
+
+            std::string path_type = path_data.value("path_type", "");
+            std::string placeholder = path_data.value("prefix_placeholder", "");
+            std::string file_mode = path_data.value("file_mode", "");
+            bool entry_point = path_type == "unix_python_entry_point"
+                               || path_type == "windows_python_entry_point_script";
+            // older records don't have the placeholders, but the checksums
+            // of the patched files differ from the ones in the package
+            bool relocated = !placeholder.empty() || entry_point
+                             || (path_data.contains("sha256")
+                                 && path_data.contains("sha256_in_prefix")
+                                 && path_data["sha256"] != path_data["sha256_in_prefix"]);
+
+            if (!relocated)
+            {
+                bool copy = context->always_copy || path_data.value("no_link", false);
+                if (!copy)
+                {
+                    fs::create_hard_link(src, dst, ec);
+                    copy = bool(ec);
+                }
+                if (copy && !reflink(src, dst))
+                {
+                    fs::copy(src, dst);
+                }
+                ++cloned;
+                return;
+            }
+
+            std::string buffer = read_contents(src, std::ios::in | std::ios::binary);
+            bool binary = file_mode == "binary"
+                          || (file_mode.empty() && !entry_point
+                              && buffer.find('\0') != std::string::npos);
+            if (binary)
+            {
+                std::size_t max_padding = placeholder.size() > old_prefix.size()
+                                              ? placeholder.size() - old_prefix.size()
+                                              : 0;
+                if (!replace_binary_prefix(buffer, old_prefix, new_prefix, max_padding))
+                {
+                    throw std::runtime_error("Prefix " + new_prefix + " is too long to clone "
+                                             + src.string());
+                }
+            }
+            else
+            {
+                replace_all(buffer, old_prefix, new_prefix);
+                if (!on_win && buffer.size() > 1 && buffer[0] == '#' && buffer[1] == '!')
+                {
+                    std::size_t end_of_line = buffer.find_first_of('\n');
+                    std::string first_line = buffer.substr(0, end_of_line);
+                    if (first_line.size() > 127)
+                    {
+                        buffer.replace(0, end_of_line, replace_long_shebang(first_line));
+                    }
+                }
+            }
+
+            {
+                std::ofstream fo(dst, std::ios::out | std::ios::binary);
+                fo << buffer;
+            }
+            fs::permissions(dst, fs::status(src).permissions());
+#if defined(__APPLE__)
+            if (binary && subdir == "osx-arm64")
+            {
+                codesign(dst);
+            }
+#endif
+            path_data["sha256_in_prefix"] = validate::sha256sum(dst);
+            ++cloned;
+            ++patched;
+        };
+
+        auto clone_package = [&](std::size_t i) {
+            fs::path record = source / "conda-meta" / (pkgs[i].str() + ".json");
+            nlohmann::json j;
+            {
+                std::ifstream record_file(record);
+                record_file >> j;
+            }
+
+            std::string subdir = j.value("subdir", "");
+            if (j.contains("paths_data") && j["paths_data"].contains("paths"))
+            {
+                for (auto& path_data : j["paths_data"]["paths"])
+                {
+                    clone_path(path_data, subdir, pkg_created[i]);
+                }
+            }
+            else
+            {
+                for (const auto& f : j.value("files", std::vector<std::string>()))
+                {
+                    nlohmann::json path_data = { { "_path", f } };
+                    clone_path(path_data, subdir, pkg_created[i]);
+                }
+            }
+
+            std::ofstream out_file(prefix / "conda-meta" / (pkgs[i].str() + ".json"));
+            out_file << j.dump(4);
+        };
+
+        try
+        {
+            parallel_for(pkgs.size(), 0, clone_package);
+        }
+        catch (...)
+        {
+            // no half cloned prefix is left: the records and the written paths
+            // are removed, then the emptied directories bottom-up
+            for (const auto& pkg : pkgs)
+            {
+                std::error_code ec;
+                fs::remove(prefix / "conda-meta" / (pkg.str() + ".json"), ec);
+            }
+            std::set<fs::path> dirs;
+            for (const auto& created : pkg_created)
+            {
+                for (const auto& p : created)
+                {
+                    std::error_code ec;
+                    fs::remove(prefix / p, ec);
+                    fs::path dir = p;
+                    while (!dir.empty() && dirs.insert(dir).second)
+                    {
+                        dir = dir.parent_path();
+                    }
+                }
+            }
+            for (auto it = dirs.rbegin(); it != dirs.rend(); ++it)
+            {
+                fs::path dir = prefix / *it;
+                std::error_code ec;
+                if (fs::is_directory(fs::symlink_status(dir, ec)) && fs::is_empty(dir, ec))
+                {
+                    fs::remove(dir, ec);
+                }
+            }
+            LOG_ERROR << "Could not clone " << source << " into " << prefix
+                      << ", the cloned files are removed";
+            throw;
+        }
+
+        LOG_DEBUG << "Cloned " << cloned << " files of " << pkgs.size() << " packages, "
+                  << patched << " of them relocated";
+        return cloned;
+    }
+
     bool UnlinkPackage::undo()
     {
         LinkPackage lp(m_pkg_info, m_cache_path, m_context);
@@ -768,8 +1231,9 @@ namespace mamba
 #ifdef _WIN32
             return std::make_tuple(validate::sha256sum(dst), rel_dst);
 #endif
-            fs::remove(dst);
+            remove_prefix_path(m_context, dst);
         }
+        create_prefix_path(m_context, dst);
 
 #ifdef __APPLE__
         bool binary_changed = false;
@@ -895,23 +1359,7 @@ namespace mamba
 #if defined(__APPLE__)
             if (binary_changed && m_pkg_info.subdir == "osx-arm64")
             {
-                reproc::options options;
-                if (Context::instance().verbosity <= 1)
-                {
-                    reproc::redirect silence;
-                    silence.type = reproc::redirect::discard;
-                    options.redirect.out = silence;
-                    options.redirect.err = silence;
-                }
-
-                std::vector<std::string> cmd
-                    = { "/usr/bin/codesign", "-s", "-", "-f", dst.string() };
-                auto [status, ec] = reproc::run(cmd, options);
-                if (ec)
-                {
-                    throw std::runtime_error(std::string("Could not codesign executable")
-                                             + ec.message());
-                }
+                codesign(dst);
             }
 #endif
 
@@ -953,7 +1401,12 @@ namespace mamba
                               << " --> '" << dst.string() << "'";
                 }
             }
-            if (copy)
+            if (copy && reflink(src, dst))
+            {
+                LOG_TRACE << "reflinked '" << src.string() << "'" << std::endl
+                          << " --> '" << dst.string() << "'";
+            }
+            else if (copy)
             {
                 fs::copy(src, dst);
                 LOG_TRACE << "copied '" << src.string() << "'" << std::endl
@@ -975,12 +1428,161 @@ namespace mamba
         return std::make_tuple(validate::sha256sum(dst), rel_dst);
     }
 
-    std::vector<fs::path> LinkPackage::compile_pyc_files(const std::vector<fs::path>& py_files)
+    std::vector<std::string> run_deferred_post_link_scripts(TransactionContext* context)
     {
-        if (py_files.size() == 0)
+        const auto& pkgs = context->deferred_post_link;
+        const fs::path& prefix = context->target_prefix;
+
+        std::vector<std::size_t> scripts;
+        for (std::size_t i = 0; i < pkgs.size(); ++i)
         {
+            if (fs::exists(script_path(prefix, pkgs[i], "post-link")))
+            {
+                scripts.push_back(i);
+            }
+        }
+        if (scripts.empty())
+        {
+            context->deferred_post_link.clear();
             return {};
         }
+
+        std::map<std::string, std::size_t> index;
+        for (std::size_t i = 0; i < pkgs.size(); ++i)
+        {
+            index[pkgs[i].name] = i;
+        }
+        std::vector<std::vector<std::size_t>> deps(pkgs.size());
+        for (std::size_t i = 0; i < pkgs.size(); ++i)
+        {
+            for (const auto& d : pkgs[i].depends)
+            {
+                auto it = index.find(MatchSpec(d).name);
+                if (it != index.end() && it->second != i)
+                {
+                    deps[i].push_back(it->second);
+                }
+            }
+        }
+
+        // A script waits for the scripts of the packages it depends on, also
+        // through packages without script. Only the packages linked before it
+        // are considered: those are the scripts a sequential run would have
+        // executed first, and waiting on them cannot deadlock.
+        std::vector<std::vector<std::size_t>> waits(pkgs.size());
+        for (std::size_t i : scripts)
+        {
+            std::vector<char> visited(pkgs.size(), 0);
+            std::vector<std::size_t> todo = deps[i];
+            while (!todo.empty())
+            {
+                std::size_t j = todo.back();
+                todo.pop_back();
+                if (visited[j])
+                {
+                    continue;
+                }
+                visited[j] = 1;
+                if (j < i && std::binary_search(scripts.begin(), scripts.end(), j))
+                {
+                    waits[i].push_back(j);
+                }
+                todo.insert(todo.end(), deps[j].begin(), deps[j].end());
+            }
+        }
+
+        std::vector<std::string> outputs(pkgs.size()), errors(pkgs.size());
+        std::vector<char> done(pkgs.size(), 0);
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+
+        LOG_DEBUG << "Running " << scripts.size() << " post-link scripts";
+        parallel_for(scripts.size(), 0, [&](std::size_t k) {
+            std::size_t i = scripts[k];
+            std::string failed_dep;
+            {
+                std::unique_lock<std::mutex> lock(done_mutex);
+                done_cv.wait(lock, [&]() {
+                    return std::all_of(
+                        waits[i].begin(), waits[i].end(), [&](std::size_t j) { return done[j]; });
+                });
+                for (std::size_t j : waits[i])
+                {
+                    if (!errors[j].empty())
+                    {
+                        failed_dep = pkgs[j].name;
+                    }
+                }
+            }
+
+            if (!failed_dep.empty())
+            {
+                errors[i] = "not run, the post-link script of " + failed_dep + " failed";
+            }
+            else if (!is_sig_interrupted())
+            {
+                try
+                {
+                    if (!run_script(prefix, pkgs[i], "post-link", "", true, &outputs[i]))
+                    {
+                        errors[i] = "the script exited with an error";
+                    }
+                }
+                catch (const std::exception& e)
+                {
+                    errors[i] = e.what();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                done[i] = 1;
+            }
+            done_cv.notify_all();
+        });
+
+        // reported in the linking order, whatever the execution order was
+        std::vector<std::string> failed;
+        for (std::size_t i : scripts)
+        {
+            if (!outputs[i].empty())
+            {
+                if (Context::instance().json)
+                {
+                    std::cerr << outputs[i];
+                }
+                else
+                {
+                    Console::print(outputs[i]);
+                }
+            }
+            if (!errors[i].empty())
+            {
+                LOG_ERROR << "post-link script of " << pkgs[i].name << ": " << errors[i];
+                failed.push_back(pkgs[i].str());
+            }
+        }
+
+        auto msg = get_prefix_messages(prefix);
+        if (Context::instance().json)
+        {
+            std::cerr << msg;
+        }
+        else
+        {
+            Console::print(msg);
+        }
+
+        context->deferred_post_link.clear();
+        return failed;
+    }
+
+    // Compiles the python files (relative to the prefix) with a single
+    // compileall call, returns the pyc files that were created
+    static std::vector<fs::path> run_compileall(const TransactionContext* context,
+                                                const std::vector<fs::path>& py_files,
+                                                bool parallel)
+    {
         std::vector<fs::path> pyc_files;
 
         TemporaryFile all_py_files;
@@ -989,12 +1591,16 @@ namespace mamba
         for (auto& f : py_files)
         {
             all_py_files_f << f.c_str() << '\n';
-            pyc_files.push_back(pyc_path(f, m_context->short_python_version));
+            pyc_files.push_back(pyc_path(f, context->short_python_version));
             LOG_INFO << "Compiling " << pyc_files[pyc_files.size() - 1];
+            if (context->journal)
+            {
+                context->journal->create(context->target_prefix / pyc_files.back());
+            }
         }
         all_py_files_f.close();
 
-        std::vector<std::string> command = { m_context->target_prefix / m_context->python_path,
+        std::vector<std::string> command = { context->target_prefix / context->python_path,
                                              "-Wi",
                                              "-m",
                                              "compileall",
@@ -1003,28 +1609,24 @@ namespace mamba
                                              "-i",
                                              all_py_files.path() };
 
-        auto py_ver_split = split(m_context->python_version, ".");
-
-        if (std::stoull(std::string(py_ver_split[0])) >= 3
-            && std::stoull(std::string(py_ver_split[1])) > 5)
+        if (parallel)
         {
             // activate parallel pyc compilation
             command.push_back("-j0");
         }
 
         reproc::options options;
-        reproc::redirect silencer;
+        reproc::redirect silencer{};
         silencer.type = reproc::redirect::pipe;
         options.redirect.out = silencer;
         options.redirect.err = silencer;
         std::string out, err;
 
         options.redirect.parent = true;
-        std::string cwd = m_context->target_prefix;
+        std::string cwd = context->target_prefix;
         options.working_directory = cwd.c_str();
 
-        auto [wrapped_command, script_file]
-            = prepare_wrapped_call(m_context->target_prefix, command);
+        auto [wrapped_command, script_file] = prepare_wrapped_call(context->target_prefix, command);
 
         LOG_INFO << "Running wrapped python compilation command " << join(" ", command);
         auto [_, ec] = reproc::run(
@@ -1039,7 +1641,7 @@ namespace mamba
         std::vector<fs::path> final_pyc_files;
         for (auto& f : pyc_files)
         {
-            if (!fs::exists(m_context->target_prefix / f))
+            if (!fs::exists(context->target_prefix / f))
             {
                 LOG_INFO << "Python file couldn't be compiled to pyc: " << f;
             }
@@ -1052,6 +1654,103 @@ namespace mamba
         return final_pyc_files;
     }
 
+    static std::vector<fs::path> compile_pyc_files(const TransactionContext* context,
+                                                   const std::vector<fs::path>& py_files)
+    {
+        if (py_files.size() == 0)
+        {
+            return {};
+        }
+
+        auto py_ver_split = split(context->python_version, ".");
+        bool parallel_compileall = std::stoull(std::string(py_ver_split[0])) >= 3
+                                   && std::stoull(std::string(py_ver_split[1])) > 5;
+        if (parallel_compileall || py_files.size() == 1)
+        {
+            return run_compileall(context, py_files, parallel_compileall);
+        }
+
+        // compileall cannot use several processes, run several interpreters instead
+        std::size_t n_chunks = std::min(default_thread_count(), py_files.size());
+        std::vector<std::vector<fs::path>> chunks(n_chunks), chunk_pyc_files(n_chunks);
+        for (std::size_t i = 0; i < py_files.size(); ++i)
+        {
+            chunks[i % n_chunks].push_back(py_files[i]);
+        }
+        parallel_for(n_chunks, n_chunks, [&](std::size_t i) {
+            chunk_pyc_files[i] = run_compileall(context, chunks[i], false);
+        });
+
+        std::vector<fs::path> pyc_files;
+        for (auto& c : chunk_pyc_files)
+        {
+            pyc_files.insert(pyc_files.end(), c.begin(), c.end());
+        }
+        return pyc_files;
+    }
+
+    std::vector<std::string> compile_deferred_pyc_files(TransactionContext* context)
+    {
+        std::vector<std::string> failed;
+        auto& deferred = context->deferred_pyc_files;
+        if (deferred.empty())
+        {
+            return failed;
+        }
+
+        std::vector<fs::path> all_py_files;
+        for (const auto& [meta_path, py_files] : deferred)
+        {
+            all_py_files.insert(all_py_files.end(), py_files.begin(), py_files.end());
+        }
+        LOG_DEBUG << "Compiling " << all_py_files.size() << " python files of "
+                  << deferred.size() << " noarch packages";
+
+        auto pyc_files = compile_pyc_files(context, all_py_files);
+        std::set<fs::path> compiled(pyc_files.begin(), pyc_files.end());
+
+        for (const auto& [meta_path, py_files] : deferred)
+        {
+            nlohmann::json meta;
+            {
+                std::ifstream meta_file(meta_path);
+                meta_file >> meta;
+            }
+            std::size_t n_failed = 0;
+            for (const auto& f : py_files)
+            {
+                fs::path pyc = pyc_path(f, context->short_python_version);
+                if (compiled.find(pyc) != compiled.end())
+                {
+                    meta["paths_data"]["paths"].push_back(
+                        { { "_path", std::string(pyc) }, { "path_type", "pyc_file" } });
+                    meta["files"].push_back(pyc);
+                }
+                else
+                {
+                    ++n_failed;
+                }
+            }
+            if (n_failed != 0)
+            {
+                // the files of all the packages were compiled together
+                failed.push_back(meta_path.stem().string());
+                LOG_WARNING << n_failed << " python files of package '" << failed.back()
+                            << "' could not be compiled";
+            }
+            LOG_TRACE << "Adding pyc files to prefix metadata at '" << meta_path.string() << "'";
+            std::ofstream out_file(meta_path);
+            out_file << meta.dump(4);
+        }
+        deferred.clear();
+        return failed;
+    }
+
+    std::vector<fs::path> LinkPackage::compile_pyc_files(const std::vector<fs::path>& py_files)
+    {
+        return mamba::compile_pyc_files(m_context, py_files);
+    }
+
     enum class NoarchType
     {
         NOT_A_NOARCH,
@@ -1062,11 +1761,16 @@ namespace mamba
 
     bool LinkPackage::execute()
     {
+        TraceSpan span("link", "LinkPackage::execute");
+        MetricsTimer timer(Metrics::instance().link_time);
         nlohmann::json index_json, out_json;
         LOG_TRACE << "Preparing linking from '" << m_source.string() << "'";
 
         LOG_TRACE << "Opening: " << m_source / "info" / "paths.json";
         auto paths_data = read_paths(m_source);
+        span.arg("package", m_pkg_info.name).arg("files", paths_data.size());
+        ++Metrics::instance().linked_packages;
+        Metrics::instance().linked_files += paths_data.size();
 
         LOG_TRACE << "Opening: " << m_source / "info" / "repodata_record.json";
         std::ifstream repodata_f(m_source / "info" / "repodata_record.json");
@@ -1138,6 +1842,14 @@ namespace mamba
                 json_record["no_link"] = true;
             }
 
+            // needed to relocate the file again, e.g. when cloning the prefix
+            if (!path.prefix_placeholder.empty())
+            {
+                json_record["prefix_placeholder"] = path.prefix_placeholder;
+                json_record["file_mode"]
+                    = path.file_mode == FileMode::BINARY ? "binary" : "text";
+            }
+
             if (path.size_in_bytes != 0)
             {
                 // note: in conda this is the size in bytes _before_ prefix replacement
@@ -1179,14 +1891,23 @@ namespace mamba
                 }
             }
 
-            std::vector<fs::path> pyc_files = compile_pyc_files(for_compilation);
-
-            for (const fs::path& pyc_path : pyc_files)
+            if (m_context->defer_pyc_compilation)
             {
-                out_json["paths_data"]["paths"].push_back(
-                    { { "_path", std::string(pyc_path) }, { "path_type", "pyc_file" } });
+                m_context->deferred_pyc_files.emplace_back(
+                    m_context->target_prefix / "conda-meta" / (f_name + ".json"),
+                    std::move(for_compilation));
+            }
+            else
+            {
+                std::vector<fs::path> pyc_files = compile_pyc_files(for_compilation);
 
-                out_json["files"].push_back(pyc_path);
+                for (const fs::path& pyc_path : pyc_files)
+                {
+                    out_json["paths_data"]["paths"].push_back(
+                        { { "_path", std::string(pyc_path) }, { "path_type", "pyc_file" } });
+
+                    out_json["files"].push_back(pyc_path);
+                }
             }
 
             if (link_json.find("noarch") != link_json.end()
@@ -1232,7 +1953,14 @@ namespace mamba
             }
         }
 
-        run_script(m_context->target_prefix, m_pkg_info, "post-link", "", true);
+        if (m_context->defer_post_link)
+        {
+            m_context->deferred_post_link.push_back(m_pkg_info);
+        }
+        else
+        {
+            run_script(m_context->target_prefix, m_pkg_info, "post-link", "", true);
+        }
 
         fs::path prefix_meta = m_context->target_prefix / "conda-meta";
         if (!fs::exists(prefix_meta))
@@ -1243,6 +1971,7 @@ namespace mamba
         LOG_DEBUG << "Finalizing linking";
         auto meta = prefix_meta / (f_name + ".json");
         LOG_TRACE << "Adding package to prefix metadata at '" << meta.string() << "'";
+        create_prefix_path(m_context, meta);
         std::ofstream out_file(meta);
         out_file << out_json.dump(4);
 
@@ -0,0 +1,301 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "mamba/core/log_sink.hpp"
+#include "mamba/core/util.hpp"
+
+#include "thirdparty/termcolor.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        constexpr auto writer_period = std::chrono::milliseconds(10);
+
+        std::size_t ring_capacity(std::size_t capacity)
+        {
+            std::size_t res = 2;
+            while (res < capacity)
+            {
+                res *= 2;
+            }
+            return res;
+        }
+
+        void write_record(std::ostream& out, LogSeverity severity, const std::string& message)
+        {
+            switch (severity)
+            {
+                case LogSeverity::kFatal:
+                    out << termcolor::on_red << "FATAL   " << termcolor::reset;
+                    break;
+                case LogSeverity::kError:
+                    out << termcolor::red << "ERROR   " << termcolor::reset;
+                    break;
+                case LogSeverity::kWarning:
+                    out << termcolor::yellow << "WARNING " << termcolor::reset;
+                    break;
+                case LogSeverity::kInfo:
+                    out << "INFO    ";
+                    break;
+                case LogSeverity::kDebug:
+                    out << termcolor::cyan << "DEBUG   " << termcolor::reset;
+                    break;
+                case LogSeverity::kTrace:
+                    out << termcolor::blue << "TRACE   " << termcolor::reset;
+                    break;
+                default:
+                    out << "UNKOWN  ";
+                    break;
+            }
+            out << message << '\n';
+        }
+    }
+
+    LogSink::LogSink(std::size_t capacity)
+        : m_capacity(ring_capacity(capacity))
+        , m_slots(new Slot[m_capacity])
+        , m_push_pos(0)
+        , m_pop_pos(0)
+        , m_dropped(0)
+        , m_reported_dropped(0)
+        , m_pushing(0)
+        , m_stderr(true)
+        , m_stopped(false)
+    {
+        for (std::size_t i = 0; i < m_capacity; ++i)
+        {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_writer = std::thread([this]() { run(); });
+    }
+
+    LogSink::~LogSink()
+    {
+        stop();
+    }
+
+    LogSink& LogSink::instance()
+    {
+        static LogSink* sink = []() {
+            auto* res = new LogSink();
+            std::atexit([]() { instance().stop(); });
+            return res;
+        }();
+        return *sink;
+    }
+
+    void LogSink::push(LogSeverity severity, std::string message)
+    {
+        Record record = { severity, std::move(message) };
+        ++m_pushing;
+        bool pushed = !m_stopped.load() && try_push(record);
+        --m_pushing;
+        if (pushed)
+        {
+            m_pushed.notify_one();
+        }
+        else if (m_stopped.load() || severity >= LogSeverity::kError)
+        {
+            // the records pushed before are written first
+            std::lock_guard<std::mutex> lock(m_output_mutex);
+            write_ring();
+            write(record);
+        }
+        else
+        {
+            ++m_dropped;
+        }
+    }
+
+    void LogSink::flush()
+    {
+        if (!m_stopped.load())
+        {
+            std::size_t target = m_push_pos.load();
+            m_pushed.notify_one();
+            std::unique_lock<std::mutex> lock(m_wait_mutex);
+            while (m_pop_pos.load() < target && !m_stopped.load())
+            {
+                m_written.wait_for(lock, writer_period);
+            }
+        }
+        std::lock_guard<std::mutex> lock(m_output_mutex);
+        std::cerr.flush();
+        if (m_log_file.is_open())
+        {
+            m_log_file.flush();
+        }
+    }
+
+    void LogSink::stop()
+    {
+        if (m_stopped.exchange(true))
+        {
+            return;
+        }
+        // no record enters the ring once the pushes in progress are done
+        while (m_pushing.load() != 0)
+        {
+            std::this_thread::yield();
+        }
+        m_pushed.notify_one();
+        if (m_writer.joinable())
+        {
+            m_writer.join();
+        }
+        // pushed while the writer was stopping
+        write_pending();
+    }
+
+    void LogSink::set_log_file(const fs::path& path)
+    {
+        bool opened = true;
+        {
+            std::lock_guard<std::mutex> lock(m_output_mutex);
+            m_log_file.close();
+            if (!path.empty())
+            {
+                m_log_file.open(path, std::ios::app);
+                opened = m_log_file.is_open();
+            }
+        }
+        if (!opened)
+        {
+            LOG_ERROR << "Could not open the log file " << path;
+        }
+    }
+
+    void LogSink::set_stderr(bool enabled)
+    {
+        std::lock_guard<std::mutex> lock(m_output_mutex);
+        m_stderr = enabled;
+    }
+
+    std::size_t LogSink::dropped() const
+    {
+        return m_dropped.load();
+    }
+
+    // Bounded queue of D. Vyukov: the sequence of a slot tells whether it
+    // can be written (sequence == position) or read (sequence == position + 1)
+    bool LogSink::try_push(Record& record)
+    {
+        std::size_t pos = m_push_pos.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true)
+        {
+            slot = &m_slots[pos & (m_capacity - 1)];
+            std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            if (sequence == pos)
+            {
+                if (m_push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (sequence < pos)
+            {
+                // the slot has not been read yet, the ring is full
+                return false;
+            }
+            else
+            {
+                pos = m_push_pos.load(std::memory_order_relaxed);
+            }
+        }
+        slot->record = std::move(record);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool LogSink::try_pop(Record& record)
+    {
+        std::size_t pos = m_pop_pos.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[pos & (m_capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+        {
+            return false;
+        }
+        record = std::move(slot.record);
+        slot.sequence.store(pos + m_capacity, std::memory_order_release);
+        m_pop_pos.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    void LogSink::run()
+    {
+        while (!m_stopped.load())
+        {
+            if (write_pending() == 0)
+            {
+                std::unique_lock<std::mutex> lock(m_wait_mutex);
+                m_pushed.wait_for(lock, writer_period);
+            }
+        }
+    }
+
+    std::size_t LogSink::write_pending()
+    {
+        std::size_t count = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_output_mutex);
+            count = write_ring();
+            if (count)
+            {
+                std::cerr.flush();
+                if (m_log_file.is_open())
+                {
+                    m_log_file.flush();
+                }
+            }
+        }
+        if (count)
+        {
+            m_written.notify_all();
+        }
+        return count;
+    }
+
+    // the writer thread is the only consumer of the ring, except for the
+    // direct writes that take the output mutex as well
+    std::size_t LogSink::write_ring()
+    {
+        std::size_t count = 0;
+        Record record;
+        while (try_pop(record))
+        {
+            write(record);
+            ++count;
+        }
+
+        std::size_t dropped = m_dropped.load();
+        if (dropped != m_reported_dropped)
+        {
+            write({ LogSeverity::kWarning,
+                    concat(std::to_string(dropped - m_reported_dropped),
+                           " log messages dropped") });
+            m_reported_dropped = dropped;
+        }
+        return count;
+    }
+
+    void LogSink::write(const Record& record)
+    {
+        if (m_stderr)
+        {
+            write_record(std::cerr, record.severity, record.message);
+        }
+        if (m_log_file.is_open())
+        {
+            write_record(m_log_file, record.severity, record.message);
+        }
+    }
+}  // namespace mamba
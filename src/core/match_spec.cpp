@@ -26,6 +26,124 @@ namespace mamba
     }
 
 
+    namespace
+    {
+        const char version_start_chars[] = " =<>!~";
+
+        bool is_key_char(char c)
+        {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+                   || c == '_' || c == '-';
+        }
+
+        bool is_quote(char c)
+        {
+            return c == '"' || c == '\'';
+        }
+
+        bool is_value_end(char c)
+        {
+            return is_quote(c) || c == ',' || c == ' ';
+        }
+
+        // Finds the [begin, end) range of the last group opened by `open` and
+        // closed by `close`, from the last opening character followed by a
+        // closing one to the last closing character, in the first line having
+        // one. This is what `.*(\[.*\])` matched.
+        bool find_last_group(
+            const std::string& s, char open, char close, std::size_t& begin, std::size_t& end)
+        {
+            std::size_t line_begin = 0;
+            while (line_begin < s.size())
+            {
+                std::size_t line_end = std::min(s.find_first_of("\n\r", line_begin), s.size());
+                for (std::size_t i = line_end; i > line_begin; --i)
+                {
+                    if (s[i - 1] == close)
+                    {
+                        std::size_t open_pos = s.rfind(open, i - 1);
+                        if (open_pos == std::string::npos || open_pos < line_begin)
+                        {
+                            break;
+                        }
+                        begin = open_pos;
+                        end = i;
+                        return true;
+                    }
+                }
+                line_begin = line_end + 1;
+            }
+            return false;
+        }
+
+        // Reads the key=value, key='value' or key="value" pairs separated by
+        // commas or spaces, with the semantics of the former regex
+        // ([a-zA-Z0-9_-]+?)=(["']?)([^'"]*?)(\2)(?:['", ]|$)
+        template <class M>
+        void extract_kv(const std::string& kv_string, M& map, const std::string& spec_str)
+        {
+            std::string_view text(kv_string.c_str());
+            std::size_t pos = 0;
+            while (true)
+            {
+                // the first '=' preceded by a key
+                std::size_t eq = pos;
+                std::size_t key_begin;
+                while (true)
+                {
+                    eq = text.find('=', eq);
+                    if (eq == std::string_view::npos)
+                    {
+                        return;
+                    }
+                    key_begin = eq;
+                    while (key_begin > pos && is_key_char(text[key_begin - 1]))
+                    {
+                        --key_begin;
+                    }
+                    if (key_begin < eq)
+                    {
+                        break;
+                    }
+                    ++eq;
+                }
+
+                std::size_t value_begin = eq + 1;
+                std::size_t value_end = std::string_view::npos;
+                std::size_t next;
+                if (value_begin < text.size() && is_quote(text[value_begin]))
+                {
+                    // the value is closed by the same quote
+                    std::size_t closing = text.find_first_of("\"'", value_begin + 1);
+                    if (closing != std::string_view::npos && text[closing] == text[value_begin]
+                        && (closing + 1 == text.size() || is_value_end(text[closing + 1])))
+                    {
+                        value_end = closing;
+                        next = std::min(closing + 2, text.size());
+                        ++value_begin;
+                    }
+                }
+                if (value_end == std::string_view::npos)
+                {
+                    value_end = value_begin;
+                    while (value_end < text.size() && !is_value_end(text[value_end]))
+                    {
+                        ++value_end;
+                    }
+                    next = std::min(value_end + 1, text.size());
+                }
+
+                if (value_end == value_begin)
+                {
+                    throw std::runtime_error("key-value mismatch in brackets " + spec_str);
+                }
+                map[std::string(text.substr(key_begin, eq - key_begin))]
+                    = std::string(text.substr(value_begin, value_end - value_begin));
+                pos = next;
+            }
+        }
+    }
+
     MatchSpec::MatchSpec(const std::string& i_spec)
         : spec(i_spec)
     {
@@ -104,48 +222,24 @@ namespace mamba
             return;
         }
 
-        auto extract_kv = [&spec_str](const std::string& kv_string, auto& map) {
-            static std::regex kv_re("([a-zA-Z0-9_-]+?)=([\"\']?)([^\'\"]*?)(\\2)(?:[\'\", ]|$)");
-            std::cmatch kv_match;
-            const char* text_iter = kv_string.c_str();
-
-            while (std::regex_search(text_iter, kv_match, kv_re))
-            {
-                auto key = kv_match[1].str();
-                auto value = kv_match[3].str();
-                if (key.size() == 0 || value.size() == 0)
-                {
-                    throw std::runtime_error("key-value mismatch in brackets " + spec_str);
-                }
-                text_iter += kv_match.position() + kv_match.length();
-                map[key] = value;
-            }
-        };
-
-        std::smatch match;
-
         // Step 3. strip off brackets portion
-        static std::regex brackets_re(".*(?:(\\[.*\\]))");
-        if (std::regex_search(spec_str, match, brackets_re))
+        std::size_t begin, end;
+        if (find_last_group(spec_str, '[', ']', begin, end))
         {
-            auto brackets_str = match[1].str();
-            brackets_str = brackets_str.substr(1, brackets_str.size() - 2);
-            extract_kv(brackets_str, brackets);
-            spec_str.erase(match.position(1), match.length(1));
+            extract_kv(spec_str.substr(begin + 1, end - begin - 2), brackets, spec_str);
+            spec_str.erase(begin, end - begin);
         }
 
         // Step 4. strip off parens portion
-        static std::regex parens_re(".*(?:(\\(.*\\)))");
-        if (std::regex_search(spec_str, match, parens_re))
+        if (find_last_group(spec_str, '(', ')', begin, end))
         {
-            auto parens_str = match[1].str();
-            parens_str = parens_str.substr(1, parens_str.size() - 2);
-            extract_kv(parens_str, this->parens);
+            std::string parens_str = spec_str.substr(begin + 1, end - begin - 2);
+            extract_kv(parens_str, this->parens, spec_str);
             if (parens_str.find("optional") != parens_str.npos)
             {
                 optional = true;
             }
-            spec_str.erase(match.position(1), match.length(1));
+            spec_str.erase(begin, end - begin);
         }
 
         auto m5 = rsplit(spec_str, ":", 2);
@@ -188,19 +282,20 @@ namespace mamba
         {
             spec_str.push_back('*');
         }
-        // This is #6 of the spec parsing
-        static std::regex version_build_re("([^ =<>!~]+)?([><!=~ ].+)?");
-        std::smatch vb_match;
-        if (std::regex_match(spec_str, vb_match, version_build_re))
+        // This is #6 of the spec parsing: the name is up to the first operator
+        // or space, the version is the rest
+        std::size_t name_end = spec_str.find_first_of(version_start_chars);
+        if (name_end != std::string::npos
+            && (name_end + 1 == spec_str.size()
+                || spec_str.find_first_of("\n\r", name_end + 1) != std::string::npos))
         {
-            name = vb_match[1].str();
-            version = strip(vb_match[2].str());
-            if (name.size() == 0)
-            {
-                throw std::runtime_error("Invalid spec, no package name found: " + spec_str);
-            }
+            throw std::runtime_error("Invalid spec, no package name found: " + spec_str);
         }
-        else
+        name = spec_str.substr(0, name_end);
+        version = name_end == std::string::npos
+                      ? std::string()
+                      : std::string(strip(spec_str.substr(name_end)));
+        if (name.size() == 0)
         {
             throw std::runtime_error("Invalid spec, no package name found: " + spec_str);
         }
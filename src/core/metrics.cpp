@@ -0,0 +1,241 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "mamba/core/metrics.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/url.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        double seconds(const std::atomic<std::int64_t>& ns)
+        {
+            return static_cast<double>(ns.load()) / 1e9;
+        }
+
+        std::string escape_label(const std::string& value)
+        {
+            std::string res;
+            for (char c : value)
+            {
+                if (c == '\\' || c == '"')
+                {
+                    res += '\\';
+                }
+                if (c == '\n')
+                {
+                    res += "\\n";
+                    continue;
+                }
+                res += c;
+            }
+            return res;
+        }
+
+        void write_type(std::ostream& out, const char* name, const char* type, const char* help)
+        {
+            out << "# HELP " << name << " " << help << "\n";
+            out << "# TYPE " << name << " " << type << "\n";
+        }
+    }
+
+    std::size_t peak_rss()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return counters.PeakWorkingSetSize;
+        }
+        return 0;
+#else
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return 0;
+        }
+#ifdef __APPLE__
+        // in bytes on macOS, in kilobytes elsewhere
+        return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+        return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+
+    Metrics& Metrics::instance()
+    {
+        static Metrics* metrics = []() {
+            auto* res = new Metrics();
+            std::atexit([]() { instance().stop(); });
+            return res;
+        }();
+        return *metrics;
+    }
+
+    void Metrics::start(const fs::path& file)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_file = file;
+    }
+
+    void Metrics::stop()
+    {
+        fs::path file;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::swap(file, m_file);
+        }
+        if (file.empty())
+        {
+            return;
+        }
+
+        std::ofstream out(file);
+        if (file.extension() == ".json")
+        {
+            out << json().dump(4) << "\n";
+        }
+        else
+        {
+            out << prometheus();
+        }
+        if (!out)
+        {
+            LOG_ERROR << "Could not write the metrics to " << file;
+        }
+    }
+
+    void Metrics::add_download(const std::string& url, std::size_t bytes, std::size_t avg_speed)
+    {
+        std::string host = URLHandler(url).host();
+        if (host.empty())
+        {
+            host = "localhost";
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& downloads = m_downloads[host];
+        downloads.count += 1;
+        downloads.bytes += bytes;
+        if (avg_speed > 0)
+        {
+            downloads.seconds += static_cast<double>(bytes) / avg_speed;
+        }
+    }
+
+    nlohmann::json Metrics::json() const
+    {
+        nlohmann::json downloads = nlohmann::json::object();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& [host, d] : m_downloads)
+            {
+                downloads[host] = { { "count", d.count },
+                                    { "bytes", d.bytes },
+                                    { "seconds", d.seconds },
+                                    { "avg_speed", d.seconds > 0 ? d.bytes / d.seconds : 0. } };
+            }
+        }
+
+        return { { "downloads", downloads },
+                 { "repodata_cache",
+                   { { "hits", repodata_cache_hits.load() },
+                     { "misses", repodata_cache_misses.load() } } },
+                 { "package_cache",
+                   { { "hits", package_cache_hits.load() },
+                     { "misses", package_cache_misses.load() } } },
+                 { "solve", { { "seconds", seconds(solve_time) } } },
+                 { "extract",
+                   { { "seconds", seconds(extract_time) },
+                     { "packages", extracted_packages.load() } } },
+                 { "link",
+                   { { "seconds", seconds(link_time) },
+                     { "packages", linked_packages.load() },
+                     { "files", linked_files.load() } } },
+                 { "peak_rss", peak_rss() } };
+    }
+
+    std::string Metrics::prometheus() const
+    {
+        std::stringstream out;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            write_type(out, "mamba_downloads_total", "counter", "Transfers per host");
+            for (const auto& [host, d] : m_downloads)
+            {
+                out << "mamba_downloads_total{host=\"" << escape_label(host) << "\"} " << d.count
+                    << "\n";
+            }
+            write_type(out, "mamba_download_bytes_total", "counter", "Bytes downloaded per host");
+            for (const auto& [host, d] : m_downloads)
+            {
+                out << "mamba_download_bytes_total{host=\"" << escape_label(host) << "\"} "
+                    << d.bytes << "\n";
+            }
+            write_type(out,
+                       "mamba_download_seconds_total",
+                       "counter",
+                       "Time spent receiving data per host");
+            for (const auto& [host, d] : m_downloads)
+            {
+                out << "mamba_download_seconds_total{host=\"" << escape_label(host) << "\"} "
+                    << d.seconds << "\n";
+            }
+        }
+
+        auto write = [&out](const char* name, const char* type, const char* help, auto value) {
+            write_type(out, name, type, help);
+            out << name << " " << value << "\n";
+        };
+        write("mamba_repodata_cache_hits_total",
+              "counter",
+              "Repodata read from the cache or not modified",
+              repodata_cache_hits.load());
+        write("mamba_repodata_cache_misses_total",
+              "counter",
+              "Repodata downloaded",
+              repodata_cache_misses.load());
+        write("mamba_package_cache_hits_total",
+              "counter",
+              "Packages found in a package cache",
+              package_cache_hits.load());
+        write("mamba_package_cache_misses_total",
+              "counter",
+              "Packages downloaded",
+              package_cache_misses.load());
+        write("mamba_solve_seconds_total", "counter", "Time spent solving", seconds(solve_time));
+        write("mamba_extract_seconds_total",
+              "counter",
+              "Time spent extracting packages",
+              seconds(extract_time));
+        write("mamba_extracted_packages_total",
+              "counter",
+              "Packages extracted",
+              extracted_packages.load());
+        write("mamba_link_seconds_total",
+              "counter",
+              "Time spent linking packages",
+              seconds(link_time));
+        write("mamba_linked_packages_total", "counter", "Packages linked", linked_packages.load());
+        write("mamba_linked_files_total", "counter", "Files linked", linked_files.load());
+        write("mamba_peak_rss_bytes", "gauge", "Peak resident set size", peak_rss());
+        return out.str();
+    }
+}  // namespace mamba
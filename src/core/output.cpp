@@ -15,6 +15,7 @@
 #include <iostream>
 #include <regex>
 
+#include "mamba/core/log_sink.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/thread_utils.hpp"
 #include "mamba/core/url.hpp"
@@ -259,6 +260,21 @@ namespace mamba
         auto hStdout = GetStdHandle(STD_OUTPUT_HANDLE);
         SetConsoleMode(hStdout, ENABLE_PROCESSED_OUTPUT | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
 #endif
+        // the last frame, drawn at exit, reads the context
+        Context::instance();
+    }
+
+    Console::~Console()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_render_stop = true;
+        }
+        m_render_cv.notify_one();
+        if (m_render_thread.joinable())
+        {
+            m_render_thread.join();
+        }
     }
 
     Console& Console::instance()
@@ -345,29 +361,49 @@ namespace mamba
 
     ProgressProxy Console::add_progress_bar(const std::string& name, size_t expected_total)
     {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_render_thread.joinable())
+        {
+            m_render_thread = std::thread(&Console::render_loop, this);
+        }
         return p_progress_manager->add_progress_bar(name, expected_total);
     }
 
     void Console::init_multi_progress(ProgressBarMode mode)
     {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // the last updates of the previous bars
+        if (p_progress_manager)
+        {
+            p_progress_manager->render(skip_progress_bars());
+        }
         p_progress_manager = make_progress_bar_manager(mode);
     }
 
-    void Console::deactivate_progress_bar(std::size_t idx, const std::string_view& msg)
+    void Console::render_progress()
     {
-        std::lock_guard<std::mutex> lock(instance().m_mutex);
-        p_progress_manager->deactivate_progress_bar(idx, msg);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (p_progress_manager)
+        {
+            p_progress_manager->render(skip_progress_bars());
+        }
     }
 
-    void Console::print_progress(std::size_t idx)
+    void Console::render_loop()
     {
-        if (skip_progress_bars())
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_render_stop)
         {
-            return;
+            if (p_progress_manager)
+            {
+                p_progress_manager->render(skip_progress_bars());
+            }
+            m_render_cv.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        if (p_progress_manager)
+        {
+            p_progress_manager->render(skip_progress_bars());
         }
-
-        std::lock_guard<std::mutex> lock(instance().m_mutex);
-        p_progress_manager->print_progress(idx);
     }
 
     bool Console::skip_progress_bars() const
@@ -409,40 +445,12 @@ namespace mamba
             return;
         }
 
-        switch (m_severity)
-        {
-            case LogSeverity::kFatal:
-                std::cerr << termcolor::on_red << "FATAL   " << termcolor::reset
-                          << prepend(m_stream.str(), "", std::string(8, ' ').c_str()) << std::endl;
-                break;
-            case LogSeverity::kError:
-                std::cerr << termcolor::red << "ERROR   " << termcolor::reset
-                          << prepend(m_stream.str(), "", std::string(8, ' ').c_str()) << std::endl;
-                break;
-            case LogSeverity::kWarning:
-                std::cerr << termcolor::yellow << "WARNING " << termcolor::reset
-                          << prepend(m_stream.str(), "", std::string(8, ' ').c_str()) << std::endl;
-                break;
-            case LogSeverity::kInfo:
-                std::cerr << "INFO    " << prepend(m_stream.str(), "", std::string(8, ' ').c_str())
-                          << std::endl;
-                break;
-            case LogSeverity::kDebug:
-                std::cerr << termcolor::cyan << "DEBUG   " << termcolor::reset
-                          << prepend(m_stream.str(), "", std::string(8, ' ').c_str()) << std::endl;
-                break;
-            case LogSeverity::kTrace:
-                std::cerr << termcolor::blue << "TRACE   " << termcolor::reset
-                          << prepend(m_stream.str(), "", std::string(8, ' ').c_str()) << std::endl;
-                break;
-            default:
-                std::cerr << "UNKOWN  " << prepend(m_stream.str(), "", std::string(8, ' ').c_str())
-                          << std::endl;
-                break;
-        }
+        LogSink::instance().push(m_severity,
+                                 prepend(m_stream.str(), "", std::string(8, ' ').c_str()));
 
         if (m_severity == LogSeverity::kFatal)
         {
+            LogSink::instance().flush();
             std::abort();
         }
     }
@@ -472,15 +480,59 @@ namespace mamba
         return j;
     }
 
+    namespace
+    {
+        // what writing the flattened value of source at the location of target
+        // did: objects and arrays are merged, other values are replaced
+        void merge_json(nlohmann::json& target, const nlohmann::json& source)
+        {
+            if (source.is_object() && !source.empty())
+            {
+                if (!target.is_object())
+                {
+                    target = nlohmann::json::object();
+                }
+                for (auto it = source.begin(); it != source.end(); ++it)
+                {
+                    merge_json(target[it.key()], it.value());
+                }
+            }
+            else if (source.is_array() && !source.empty())
+            {
+                if (!target.is_array())
+                {
+                    target = nlohmann::json::array();
+                }
+                for (std::size_t i = 0; i < source.size(); ++i)
+                {
+                    merge_json(target[i], source[i]);
+                }
+            }
+            else if (!source.is_structured())
+            {
+                target = source;
+            }
+        }
+    }
+
+    // the current entry, created if it doesn't exist
+    nlohmann::json& JsonLogger::json_current()
+    {
+        nlohmann::json* current = &json_log;
+        for (const auto& key : json_hier)
+        {
+            current = &(*current)[key];
+        }
+        return *current;
+    }
+
     // write all the key/value pairs of a JSON object into the current entry, which
     // is then a JSON object
     void JsonLogger::json_write(const nlohmann::json& j)
     {
         if (Context::instance().json)
         {
-            nlohmann::json tmp = j.flatten();
-            for (auto it = tmp.begin(); it != tmp.end(); ++it)
-                json_log[json_hier + it.key()] = it.value();
+            merge_json(json_current(), j);
         }
     }
 
@@ -489,7 +541,7 @@ namespace mamba
     {
         if (Context::instance().json)
         {
-            json_log[json_hier + '/' + std::to_string(json_index)] = value;
+            json_current()[json_index] = value;
             json_index += 1;
         }
     }
@@ -499,9 +551,7 @@ namespace mamba
     {
         if (Context::instance().json)
         {
-            nlohmann::json tmp = j.flatten();
-            for (auto it = tmp.begin(); it != tmp.end(); ++it)
-                json_log[json_hier + '/' + std::to_string(json_index) + it.key()] = it.value();
+            merge_json(json_current()[json_index], j);
             json_index += 1;
         }
     }
@@ -511,7 +561,7 @@ namespace mamba
     {
         if (Context::instance().json)
         {
-            json_hier += '/' + key;
+            json_hier.push_back(key);
             json_index = 0;
         }
     }
@@ -519,7 +569,7 @@ namespace mamba
     // go up in the hierarchy
     void JsonLogger::json_up()
     {
-        if (Context::instance().json)
-            json_hier.erase(json_hier.rfind('/'));
+        if (Context::instance().json && !json_hier.empty())
+            json_hier.pop_back();
     }
 }  // namespace mamba
@@ -4,19 +4,180 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <chrono>
+
 #include "mamba/core/package_cache.hpp"
 #include "nlohmann/json.hpp"
 #include "mamba/core/package_handling.hpp"
+#include "mamba/core/thread_utils.hpp"
 #include "mamba/core/validate.hpp"
 #include "mamba/core/url.hpp"
 
 namespace mamba
 {
-    PackageCacheData::PackageCacheData(const fs::path& pkgs_dir)
+    /************************
+     * PackageCacheManifest *
+     ************************/
+
+    PackageCacheManifest::PackageCacheManifest(const fs::path& pkgs_dir)
         : m_pkgs_dir(pkgs_dir)
     {
     }
 
+    fs::path PackageCacheManifest::path() const
+    {
+        return m_pkgs_dir / PACKAGE_CACHE_MANIFEST_FILE;
+    }
+
+    bool PackageCacheManifest::load()
+    {
+        m_entries.clear();
+        fs::path manifest_path = path();
+        if (!fs::exists(manifest_path))
+        {
+            return false;
+        }
+
+        try
+        {
+            std::ifstream manifest_file(manifest_path);
+            nlohmann::json j;
+            manifest_file >> j;
+            for (auto& [pkg, jentry] : j["packages"].items())
+            {
+                Entry& e = m_entries[pkg];
+                e.fn = jentry.value("fn", "");
+                e.url = jentry.value("url", "");
+                e.sha256 = jentry.value("sha256", "");
+                e.md5 = jentry.value("md5", "");
+                e.size = jentry.value("size", std::size_t(0));
+            }
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+            LOG_WARNING << "Invalid package cache manifest '" << manifest_path.string()
+                        << "': " << e.what();
+            m_entries.clear();
+            return false;
+        }
+        LOG_DEBUG << "Loaded " << m_entries.size() << " packages from manifest " << manifest_path;
+        return true;
+    }
+
+    void PackageCacheManifest::save() const
+    {
+        nlohmann::json j;
+        j["version"] = 1;
+        j["packages"] = nlohmann::json::object();
+        for (const auto& [pkg, e] : m_entries)
+        {
+            j["packages"][pkg] = { { "fn", e.fn },
+                                   { "url", e.url },
+                                   { "sha256", e.sha256 },
+                                   { "md5", e.md5 },
+                                   { "size", e.size } };
+        }
+
+        fs::path manifest_path = path();
+        fs::path tmp_path = manifest_path;
+        tmp_path += ".tmp";
+        {
+            std::ofstream out(tmp_path);
+            out << j.dump();
+        }
+        fs::rename(tmp_path, manifest_path);
+    }
+
+    void PackageCacheManifest::build()
+    {
+        m_entries.clear();
+        for (auto& p : fs::directory_iterator(m_pkgs_dir))
+        {
+            fs::path repodata_record_path = p.path() / "info" / "repodata_record.json";
+            if (!p.is_directory() || !fs::exists(repodata_record_path))
+            {
+                continue;
+            }
+
+            try
+            {
+                std::ifstream repodata_record_f(repodata_record_path);
+                nlohmann::json repodata_record;
+                repodata_record_f >> repodata_record;
+
+                Entry e;
+                e.fn = repodata_record.value("fn", "");
+                e.url = repodata_record.value("url", "");
+                e.sha256 = repodata_record.value("sha256", "");
+                e.md5 = repodata_record.value("md5", "");
+                e.size = repodata_record.value("size", std::size_t(0));
+                if (e.sha256.empty() && e.md5.empty())
+                {
+                    LOG_WARNING << "Package '" << p.path().string()
+                                << "' has no checksum, not added to the manifest";
+                    continue;
+                }
+                m_entries[p.path().filename().string()] = std::move(e);
+            }
+            catch (const nlohmann::json::exception& e)
+            {
+                LOG_WARNING << "Invalid '" << repodata_record_path.string()
+                            << "', not added to the manifest: " << e.what();
+            }
+        }
+    }
+
+    auto PackageCacheManifest::find(const std::string& pkg) const -> const Entry*
+    {
+        auto it = m_entries.find(pkg);
+        return it != m_entries.end() ? &it->second : nullptr;
+    }
+
+    bool PackageCacheManifest::contains(const PackageInfo& s) const
+    {
+        const Entry* e = find(strip_package_extension(s.fn).string());
+        if (e == nullptr || (s.size != 0 && e->size != s.size))
+        {
+            return false;
+        }
+        // same rules as the validation of an extracted package
+        if (!s.sha256.empty())
+        {
+            return s.sha256 == e->sha256;
+        }
+        else if (!s.md5.empty())
+        {
+            return s.md5 == e->md5;
+        }
+        return false;
+    }
+
+    std::size_t PackageCacheManifest::size() const
+    {
+        return m_entries.size();
+    }
+
+    /********************
+     * PackageCacheData *
+     ********************/
+
+    PackageCacheData::PackageCacheData(const fs::path& pkgs_dir, bool read_only)
+        : m_pkgs_dir(pkgs_dir)
+        , m_read_only(read_only)
+    {
+        if (m_read_only)
+        {
+            m_writable = Writable::NOT_WRITABLE;
+            // loaded once, lookups are then served from memory
+            auto manifest = std::make_shared<PackageCacheManifest>(m_pkgs_dir);
+            if (manifest->load())
+            {
+                m_manifest = std::move(manifest);
+            }
+        }
+    }
+
     bool PackageCacheData::create_directory()
     {
         try
@@ -52,6 +213,16 @@ namespace mamba
         return m_writable;
     }
 
+    bool PackageCacheData::is_read_only() const
+    {
+        return m_read_only;
+    }
+
+    bool PackageCacheData::has_manifest() const
+    {
+        return m_manifest != nullptr;
+    }
+
     fs::path PackageCacheData::get_pkgs_dir() const
     {
         return m_pkgs_dir;
@@ -121,8 +292,26 @@ namespace mamba
             return m_valid_cache[pkg];
         }
 
+        bool valid = check_validity(s);
+        m_valid_cache[pkg] = valid;
+        return valid;
+    }
+
+    // Does not touch the query cache so that different packages
+    // can be checked concurrently
+    bool PackageCacheData::check_validity(const PackageInfo& s)
+    {
         assert(!s.fn.empty());
         auto pkg_name = strip_package_extension(s.fn);
+
+        if (m_manifest)
+        {
+            bool valid = m_manifest->contains(s);
+            LOG_DEBUG << "Package '" << pkg_name.string() << "' "
+                      << (valid ? "found" : "not found") << " in manifest of " << m_pkgs_dir;
+            return valid;
+        }
+
         LOG_DEBUG << "Verify cache for package '" << pkg_name.string() << "'";
 
         bool valid = false, extract_dir_valid = false;
@@ -136,7 +325,6 @@ namespace mamba
                 LOG_TRACE << "Package tarball '" << tarball_path.string() << "' is valid";
             else
                 LOG_WARNING << "Package tarball '" << tarball_path.string() << "' is invalid";
-            m_valid_cache[pkg] = valid;
         }
 
         fs::path extract_dir = m_pkgs_dir / pkg_name;
@@ -248,7 +436,11 @@ namespace mamba
                     extract_dir_valid = validate(extract_dir);
                 }
             }
-            if (!extract_dir_valid)
+            if (!extract_dir_valid && m_read_only)
+            {
+                LOG_DEBUG << "Not removing invalid extraction directory from read-only cache";
+            }
+            else if (!extract_dir_valid)
             {
                 LOG_TRACE << "Removing invalid extraction directory";
                 try
@@ -268,19 +460,30 @@ namespace mamba
                 valid = true;
             }
         }
-        m_valid_cache[pkg] = valid;
 
         LOG_DEBUG << "Cache is " << (valid ? "valid" : "invalid");
         return valid;
     }
 
+    /*********************
+     * MultiPackageCache *
+     *********************/
+
     MultiPackageCache::MultiPackageCache(const std::vector<fs::path>& cache_paths)
     {
-        m_caches.reserve(cache_paths.size());
+        const auto& layers = Context::instance().readonly_pkgs_dirs;
+        m_caches.reserve(cache_paths.size() + layers.size());
         for (auto& c : cache_paths)
         {
             m_caches.emplace_back(c);
         }
+        for (auto& l : layers)
+        {
+            if (std::find(cache_paths.begin(), cache_paths.end(), l) == cache_paths.end())
+            {
+                m_caches.emplace_back(l, /*read_only*/ true);
+            }
+        }
     }
 
     PackageCacheData& MultiPackageCache::first_writable()
@@ -330,6 +533,81 @@ namespace mamba
         return {};
     }
 
+    std::vector<fs::path> MultiPackageCache::query(const std::vector<PackageInfo>& pkgs)
+    {
+        // Packages sharing the same key would be validated (and possibly
+        // removed) twice in parallel
+        std::vector<std::string> keys;
+        std::map<std::string, std::size_t> unique_index;
+        std::vector<const PackageInfo*> unique_pkgs;
+        for (const auto& s : pkgs)
+        {
+            keys.push_back(s.str());
+            if (unique_index.emplace(keys.back(), unique_pkgs.size()).second)
+            {
+                unique_pkgs.push_back(&s);
+            }
+        }
+
+        // Per package, the validity computed for each visited cache. The query
+        // caches are only read during the parallel section and updated afterwards.
+        std::vector<std::vector<std::pair<std::size_t, bool>>> checked(unique_pkgs.size());
+        std::vector<fs::path> unique_res(unique_pkgs.size());
+        parallel_for(
+            unique_pkgs.size(), Context::instance().validation_threads, [&](std::size_t i) {
+                const PackageInfo& s = *unique_pkgs[i];
+                const std::string pkg = s.str();
+                for (std::size_t c = 0; c < m_caches.size(); ++c)
+                {
+                    auto& cache = m_caches[c];
+                    auto it = cache.m_valid_cache.find(pkg);
+                    bool valid = false;
+                    if (it != cache.m_valid_cache.end())
+                    {
+                        valid = it->second;
+                    }
+                    else
+                    {
+                        // an error on one package, as failing to remove an invalid
+                        // cache entry, must not lose the results of the others
+                        try
+                        {
+                            valid = cache.check_validity(s);
+                        }
+                        catch (const std::exception& e)
+                        {
+                            LOG_WARNING << "Could not verify cache of '" << pkg << "' in "
+                                        << cache.get_pkgs_dir() << ": " << e.what();
+                            valid = false;
+                        }
+                        checked[i].emplace_back(c, valid);
+                    }
+                    if (valid)
+                    {
+                        unique_res[i] = cache.get_pkgs_dir();
+                        break;
+                    }
+                }
+            });
+
+        for (std::size_t i = 0; i < unique_pkgs.size(); ++i)
+        {
+            const std::string pkg = unique_pkgs[i]->str();
+            for (const auto& [c, valid] : checked[i])
+            {
+                m_caches[c].m_valid_cache[pkg] = valid;
+            }
+        }
+
+        std::vector<fs::path> res;
+        res.reserve(pkgs.size());
+        for (const auto& key : keys)
+        {
+            res.push_back(unique_res[unique_index[key]]);
+        }
+        return res;
+    }
+
     fs::path MultiPackageCache::first_cache_path(const PackageInfo& s, bool return_empty)
     {
         const std::string pkg(s.str());
@@ -341,7 +619,9 @@ namespace mamba
         for (auto& c : m_caches)
         {
             const fs::path cache_path(c.get_pkgs_dir());
-            if (c.query(s) && fs::exists(cache_path / strip_package_extension(s.fn)))
+            // the manifest only indexes extracted packages
+            if (c.query(s)
+                && (c.has_manifest() || fs::exists(cache_path / strip_package_extension(s.fn))))
             {
                 m_path_cache[pkg] = cache_path;
                 return cache_path;
@@ -360,4 +640,306 @@ namespace mamba
             c.clear_query_cache(s);
         }
     }
+
+    /*********************
+     * PackageCacheUsage *
+     *********************/
+
+    namespace
+    {
+        const char* tarball_extensions[] = { ".tar.bz2", ".conda" };
+
+        std::time_t to_time_t(fs::file_time_type ftime)
+        {
+            auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                ftime - fs::file_time_type::clock::now() + std::chrono::system_clock::now());
+            return std::chrono::system_clock::to_time_t(sctp);
+        }
+
+        std::size_t folder_size(const fs::path& p)
+        {
+            std::size_t size = 0;
+            for (auto& fp : fs::recursive_directory_iterator(p))
+            {
+                if (!fp.is_symlink() && fp.is_regular_file())
+                {
+                    size += fp.file_size();
+                }
+            }
+            return size;
+        }
+    }
+
+    PackageCacheUsage::PackageCacheUsage(const fs::path& pkgs_dir)
+        : m_pkgs_dir(pkgs_dir)
+    {
+    }
+
+    fs::path PackageCacheUsage::lock_path() const
+    {
+        return m_pkgs_dir / (PACKAGE_CACHE_USAGE_FILE ".lock");
+    }
+
+    void PackageCacheUsage::load()
+    {
+        m_entries.clear();
+        fs::path index_path = m_pkgs_dir / PACKAGE_CACHE_USAGE_FILE;
+        if (!fs::exists(index_path))
+        {
+            // first use of the index, environments are only scanned this time
+            seed_prefixes();
+            return;
+        }
+
+        try
+        {
+            std::ifstream index_file(index_path);
+            nlohmann::json j;
+            index_file >> j;
+            for (auto& [pkg, jentry] : j["packages"].items())
+            {
+                Entry& e = m_entries[pkg];
+                e.last_used = jentry["last_used"].get<std::time_t>();
+                e.size = jentry["size"].get<std::size_t>();
+                for (auto& prefix : jentry["prefixes"])
+                {
+                    e.prefixes.insert(prefix.get<std::string>());
+                }
+            }
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+            LOG_WARNING << "Invalid package cache usage index '" << index_path.string()
+                        << "', recreating it: " << e.what();
+            m_entries.clear();
+            seed_prefixes();
+        }
+    }
+
+    void PackageCacheUsage::save() const
+    {
+        nlohmann::json j;
+        j["version"] = 1;
+        j["packages"] = nlohmann::json::object();
+        for (const auto& [pkg, e] : m_entries)
+        {
+            j["packages"][pkg] = { { "last_used", e.last_used },
+                                   { "size", e.size },
+                                   { "prefixes", e.prefixes } };
+        }
+
+        fs::path index_path = m_pkgs_dir / PACKAGE_CACHE_USAGE_FILE;
+        fs::path tmp_path = index_path;
+        tmp_path += ".tmp";
+        {
+            std::ofstream out(tmp_path);
+            out << j.dump();
+        }
+        fs::rename(tmp_path, index_path);
+    }
+
+    void PackageCacheUsage::record_link(const std::string& pkg, const fs::path& prefix)
+    {
+        Entry& e = m_entries[pkg];
+        e.last_used = std::time(nullptr);
+        e.prefixes.insert(fs::absolute(prefix).string());
+    }
+
+    void PackageCacheUsage::record_unlink(const std::string& pkg, const fs::path& prefix)
+    {
+        auto it = m_entries.find(pkg);
+        if (it != m_entries.end())
+        {
+            it->second.prefixes.erase(fs::absolute(prefix).string());
+        }
+    }
+
+    void PackageCacheUsage::seed_prefixes()
+    {
+        auto& ctx = Context::instance();
+        std::set<fs::path> envs;
+        if (fs::exists(ctx.root_prefix / "conda-meta"))
+        {
+            envs.insert(ctx.root_prefix);
+        }
+        for (const auto& envs_dir : ctx.envs_dirs)
+        {
+            if (!fs::is_directory(envs_dir))
+            {
+                continue;
+            }
+            for (auto& p : fs::directory_iterator(envs_dir))
+            {
+                if (p.is_directory() && fs::exists(p.path() / "conda-meta"))
+                {
+                    envs.insert(p.path());
+                }
+            }
+        }
+
+        for (const auto& env : envs)
+        {
+            for (auto& meta : fs::directory_iterator(env / "conda-meta"))
+            {
+                if (meta.path().extension() == ".json")
+                {
+                    m_entries[meta.path().stem().string()].prefixes.insert(
+                        fs::absolute(env).string());
+                }
+            }
+        }
+    }
+
+    void PackageCacheUsage::scan()
+    {
+        std::set<std::string> found;
+        for (auto& p : fs::directory_iterator(m_pkgs_dir))
+        {
+            std::string fn = p.path().filename().string();
+            std::string pkg;
+            if (p.is_directory() && fs::exists(p.path() / "info" / "index.json"))
+            {
+                pkg = fn;
+            }
+            else if (p.is_regular_file())
+            {
+                for (const char* ext : tarball_extensions)
+                {
+                    if (ends_with(fn, ext))
+                    {
+                        pkg = fn.substr(0, fn.size() - std::strlen(ext));
+                    }
+                }
+            }
+            if (pkg.empty())
+            {
+                continue;
+            }
+
+            if (found.insert(pkg).second)
+            {
+                Entry& e = m_entries[pkg];
+                e.tarballs_size = 0;
+                fs::path extract_dir = m_pkgs_dir / pkg;
+                if (!fs::is_directory(extract_dir))
+                {
+                    e.size = 0;
+                }
+                else if (e.size == 0)
+                {
+                    e.size = folder_size(extract_dir);
+                }
+                if (e.last_used == 0)
+                {
+                    e.last_used = to_time_t(fs::last_write_time(p.path()));
+                }
+            }
+            if (p.is_regular_file())
+            {
+                m_entries[pkg].tarballs_size += p.file_size();
+            }
+        }
+
+        for (auto it = m_entries.begin(); it != m_entries.end();)
+        {
+            if (found.find(it->first) == found.end())
+            {
+                it = m_entries.erase(it);
+                continue;
+            }
+            // drop prefixes removed without unlinking the package (e.g. rm -rf)
+            auto& prefixes = it->second.prefixes;
+            for (auto p = prefixes.begin(); p != prefixes.end();)
+            {
+                if (!fs::exists(fs::path(*p) / "conda-meta" / (it->first + ".json")))
+                {
+                    p = prefixes.erase(p);
+                }
+                else
+                {
+                    ++p;
+                }
+            }
+            ++it;
+        }
+    }
+
+    std::size_t PackageCacheUsage::total_size() const
+    {
+        std::size_t total = 0;
+        for (const auto& [pkg, e] : m_entries)
+        {
+            total += e.size + e.tarballs_size;
+        }
+        return total;
+    }
+
+    std::vector<std::string> PackageCacheUsage::lru_candidates(std::size_t max_size) const
+    {
+        std::size_t total = total_size();
+        if (total <= max_size)
+        {
+            return {};
+        }
+
+        std::vector<std::pair<std::time_t, std::string>> unused;
+        for (const auto& [pkg, e] : m_entries)
+        {
+            if (e.prefixes.empty())
+            {
+                unused.emplace_back(e.last_used, pkg);
+            }
+        }
+        std::sort(unused.begin(), unused.end());
+
+        std::vector<std::string> res;
+        for (const auto& [last_used, pkg] : unused)
+        {
+            if (total <= max_size)
+            {
+                break;
+            }
+            const Entry& e = m_entries.at(pkg);
+            total -= e.size + e.tarballs_size;
+            res.push_back(pkg);
+        }
+        return res;
+    }
+
+    void PackageCacheUsage::remove_package(const std::string& pkg)
+    {
+        fs::remove_all(m_pkgs_dir / pkg);
+        for (const char* ext : tarball_extensions)
+        {
+            fs::remove(m_pkgs_dir / (pkg + ext));
+        }
+        m_entries.erase(pkg);
+    }
+
+    auto PackageCacheUsage::entries() const -> const std::map<std::string, Entry>&
+    {
+        return m_entries;
+    }
+
+    std::size_t prune_package_caches(MultiPackageCache& caches, std::size_t max_size)
+    {
+        std::size_t freed = 0;
+        for (auto* pkg_cache : caches.writable_caches())
+        {
+            PackageCacheUsage usage(pkg_cache->get_pkgs_dir());
+            LockFile lock(usage.lock_path());
+            usage.load();
+            usage.scan();
+            for (const auto& pkg : usage.lru_candidates(max_size))
+            {
+                const auto& e = usage.entries().at(pkg);
+                freed += e.size + e.tarballs_size;
+                LOG_INFO << "Removing least recently used package '" << pkg << "' from "
+                         << pkg_cache->get_pkgs_dir();
+                usage.remove_package(pkg);
+            }
+            usage.save();
+        }
+        return freed;
+    }
 }  // namespace mamba
@@ -8,9 +8,14 @@
 #include <archive.h>
 #include <archive_entry.h>
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
 
 #include "nlohmann/json.hpp"
+#include "mamba/core/content_store.hpp"
 #include "mamba/core/package_handling.hpp"
 #include "mamba/core/package_paths.hpp"
 #include "mamba/core/output.hpp"
@@ -85,157 +90,188 @@ namespace mamba
                         const fs::path& destination,
                         compression_algorithm ca,
                         int compression_level,
+                        int compression_threads,
                         bool (*filter)(const std::string&))
     {
         int r;
-        struct archive* a;
 
         extraction_guard g(destination);
 
+        // absolute paths only, the working directory may be changed
+        // concurrently by an extraction
         fs::path abs_out_path = fs::absolute(destination);
-        a = archive_write_new();
+        fs::path abs_directory = fs::absolute(directory);
+
+        std::unique_ptr<archive, decltype(&archive_write_free)> a(archive_write_new(),
+                                                                  archive_write_free);
         if (ca == compression_algorithm::bzip2)
         {
-            archive_write_set_format_gnutar(a);
-            archive_write_set_format_pax_restricted(a);  // Note 1
-            archive_write_add_filter_bzip2(a);
+            archive_write_set_format_gnutar(a.get());
+            archive_write_set_format_pax_restricted(a.get());  // Note 1
+            archive_write_add_filter_bzip2(a.get());
         }
         if (ca == compression_algorithm::zip)
         {
             std::string comp_level
                 = std::string("zip:compression-level=") + std::to_string(compression_level);
-            archive_write_set_format_zip(a);
-            archive_write_set_options(a, comp_level.c_str());
+            archive_write_set_format_zip(a.get());
+            archive_write_set_options(a.get(), comp_level.c_str());
         }
         if (ca == compression_algorithm::zstd)
         {
-            archive_write_set_format_gnutar(a);
-            archive_write_set_format_pax_restricted(a);  // Note 1
-            archive_write_add_filter_zstd(a);
+            archive_write_set_format_gnutar(a.get());
+            archive_write_set_format_pax_restricted(a.get());  // Note 1
+            archive_write_add_filter_zstd(a.get());
             std::string comp_level
                 = std::string("zstd:compression-level=") + std::to_string(compression_level);
-            archive_write_set_options(a, comp_level.c_str());
+            archive_write_set_options(a.get(), comp_level.c_str());
+
+            std::size_t threads = compression_threads > 0
+                                      ? static_cast<std::size_t>(compression_threads)
+                                      : default_thread_count();
+            if (threads > 1)
+            {
+                std::string comp_threads = std::string("zstd:threads=") + std::to_string(threads);
+                if (archive_write_set_options(a.get(), comp_threads.c_str()) < ARCHIVE_OK)
+                {
+                    // requires libarchive >= 3.6 built with a multi-threaded libzstd
+                    LOG_DEBUG << "Multi-threaded zstd compression not available: "
+                              << archive_error_string(a.get());
+                }
+            }
         }
 
-        archive_write_open_filename(a, abs_out_path.c_str());
+        if (archive_write_open_filename(a.get(), abs_out_path.c_str()) < ARCHIVE_OK)
+        {
+            throw std::runtime_error(concat("libarchive error: ", archive_error_string(a.get())));
+        }
 
-        auto prev_path = fs::current_path();
-        if (!fs::exists(directory))
+        if (!fs::exists(abs_directory))
         {
             throw std::runtime_error("Directory does not exist.");
         }
-        fs::current_path(directory);
 
-        for (auto& dir_entry : fs::recursive_directory_iterator("."))
+        // a single disk reader and entry are used for all the files
+        std::unique_ptr<archive, decltype(&archive_read_free)> disk(archive_read_disk_new(),
+                                                                    archive_read_free);
+        if (disk == nullptr)
+        {
+            throw std::runtime_error(concat("libarchive error: could not create read_disk"));
+        }
+        if (archive_read_disk_set_behavior(disk.get(), 0) < ARCHIVE_OK)
+        {
+            throw std::runtime_error(
+                concat("libarchive error: ", archive_error_string(disk.get())));
+        }
+        std::unique_ptr<archive_entry, decltype(&archive_entry_free)> entry(archive_entry_new(),
+                                                                            archive_entry_free);
+        std::vector<char> buffer(1 << 20);
+
+        for (auto& dir_entry : fs::recursive_directory_iterator(abs_directory))
         {
             if (dir_entry.is_directory())
             {
                 continue;
             }
 
-            std::string p = dir_entry.path().string();
-            // do this in a better way?
-            if (p[0] == '.')
-            {
-                p = p.substr(1);
-            }
-            if (p[0] == '/')
-            {
-                p = p.substr(1);
-            }
+            std::string p = dir_entry.path().lexically_relative(abs_directory).string();
             if (filter && filter(p))
             {
                 continue;
             }
 
-            struct archive_entry* entry;
-            entry = archive_entry_new();
-
-            struct archive* disk;
-
-            disk = archive_read_disk_new();
-            if (disk == nullptr)
-            {
-                throw std::runtime_error(concat("libarchive error: could not create read_disk"));
-            }
-            if (archive_read_disk_set_behavior(disk, 0) < ARCHIVE_OK)
+            archive_entry_clear(entry.get());
+            archive_entry_copy_pathname(entry.get(), p.c_str());
+            archive_entry_copy_sourcepath(entry.get(), dir_entry.path().c_str());
+            if (archive_read_disk_entry_from_file(disk.get(), entry.get(), -1, nullptr)
+                < ARCHIVE_OK)
             {
-                throw std::runtime_error(concat("libarchive error: ", archive_error_string(disk)));
+                throw std::runtime_error(
+                    concat("libarchive error: ", archive_error_string(disk.get())));
             }
-            if (archive_read_disk_open(disk, p.c_str()) < ARCHIVE_OK)
+            if (archive_write_header(a.get(), entry.get()) < ARCHIVE_OK)
             {
-                throw std::runtime_error(concat("libarchive error: ", archive_error_string(disk)));
+                throw std::runtime_error(
+                    concat("libarchive error: ", archive_error_string(a.get())));
             }
-            if (archive_read_next_header2(disk, entry) < ARCHIVE_OK)
-            {
-                throw std::runtime_error(concat("libarchive error: ", archive_error_string(disk)));
-            }
-            if (archive_read_disk_descend(disk) < ARCHIVE_OK)
-            {
-                throw std::runtime_error(concat("libarchive error: ", archive_error_string(disk)));
-            }
-            if (archive_write_header(a, entry) < ARCHIVE_OK)
-            {
-                throw std::runtime_error(concat("libarchive error: ", archive_error_string(a)));
-            }
-
 
-            if (!fs::is_symlink(p))
+            if (archive_entry_filetype(entry.get()) == AE_IFREG)
             {
-                std::array<char, 8192> buffer;
-                std::ifstream fin(p, std::ios::in | std::ios::binary);
-                while (!fin.eof() && !is_sig_interrupted())
+                std::ifstream fin(dir_entry.path(), std::ios::in | std::ios::binary);
+                while (fin && !is_sig_interrupted())
                 {
                     fin.read(buffer.data(), buffer.size());
                     std::streamsize len = fin.gcount();
-                    archive_write_data(a, buffer.data(), len);
+                    if (len > 0 && archive_write_data(a.get(), buffer.data(), len) < 0)
+                    {
+                        throw std::runtime_error(
+                            concat("libarchive error: ", archive_error_string(a.get())));
+                    }
                 }
             }
 
-            r = archive_write_finish_entry(a);
+            r = archive_write_finish_entry(a.get());
             if (r == ARCHIVE_WARN)
             {
-                LOG_WARNING << "libarchive warning: " << archive_error_string(a);
+                LOG_WARNING << "libarchive warning: " << archive_error_string(a.get());
             }
             else if (r < ARCHIVE_OK)
             {
-                throw std::runtime_error(concat("libarchive error: ", archive_error_string(a)));
+                throw std::runtime_error(
+                    concat("libarchive error: ", archive_error_string(a.get())));
             }
-
-            archive_read_close(disk);
-            archive_read_free(disk);
-            archive_entry_clear(entry);
         }
 
-        archive_write_close(a);  // Note 4
-        archive_write_free(a);   // Note 5
-        fs::current_path(prev_path);
+        if (archive_write_close(a.get()) < ARCHIVE_OK)  // Note 4
+        {
+            throw std::runtime_error(concat("libarchive error: ", archive_error_string(a.get())));
+        }
     }
 
     // note the info folder must have already been created!
-    void create_package(const fs::path& directory, const fs::path& out_file, int compression_level)
+    void create_package(const fs::path& directory,
+                        const fs::path& out_file,
+                        int compression_level,
+                        int compression_threads)
     {
         fs::path out_file_abs = fs::absolute(out_file);
         if (ends_with(out_file.string(), ".tar.bz2"))
         {
-            create_archive(
-                directory, out_file_abs, bzip2, compression_level, [](const std::string&) {
-                    return false;
-                });
+            create_archive(directory,
+                           out_file_abs,
+                           bzip2,
+                           compression_level,
+                           compression_threads,
+                           [](const std::string&) { return false; });
         }
         else if (ends_with(out_file.string(), ".conda"))
         {
             TemporaryDirectory tdir;
-            create_archive(directory,
-                           tdir.path() / concat("info-", out_file.stem().string(), ".tar.zst"),
-                           zstd,
-                           compression_level,
-                           [](const std::string& p) -> bool { return !starts_with(p, "info/"); });
-            create_archive(directory,
-                           tdir.path() / concat("pkg-", out_file.stem().string(), ".tar.zst"),
-                           zstd,
-                           compression_level,
-                           [](const std::string& p) -> bool { return starts_with(p, "info/"); });
+            std::string stem = out_file.stem().string();
+
+            // the inner archives are independent and compressed concurrently
+            parallel_for(2, 2, [&](std::size_t i) {
+                if (i == 0)
+                {
+                    create_archive(
+                        directory,
+                        tdir.path() / concat("info-", stem, ".tar.zst"),
+                        zstd,
+                        compression_level,
+                        compression_threads,
+                        [](const std::string& p) -> bool { return !starts_with(p, "info/"); });
+                }
+                else
+                {
+                    create_archive(
+                        directory,
+                        tdir.path() / concat("pkg-", stem, ".tar.zst"),
+                        zstd,
+                        compression_level,
+                        compression_threads,
+                        [](const std::string& p) -> bool { return starts_with(p, "info/"); });
+                }
+            });
 
             nlohmann::json pkg_metadata;
             pkg_metadata["conda_pkg_format_version"] = 2;
@@ -243,12 +279,19 @@ namespace mamba
             metadata_file << pkg_metadata;
             metadata_file.close();
 
-            create_archive(
-                tdir.path(), out_file_abs, zip, 0, [](const std::string&) { return false; });
+            create_archive(tdir.path(), out_file_abs, zip, 0, 1, [](const std::string&) {
+                return false;
+            });
         }
     }
 
-    void extract_archive(const fs::path& file, const fs::path& destination)
+    // Called for every entry before it is written, returns true when the entry
+    // has already been materialized and its data must be skipped
+    using entry_hook = std::function<bool(archive_entry*)>;
+
+    static void extract_archive(const fs::path& file,
+                                const fs::path& destination,
+                                const entry_hook& hook)
     {
         LOG_INFO << "Extracting " << file << " to " << destination;
         extraction_guard g(destination);
@@ -306,6 +349,11 @@ namespace mamba
                 throw std::runtime_error(archive_error_string(a));
             }
 
+            if (hook && hook(entry))
+            {
+                continue;
+            }
+
             r = archive_write_header(ext, entry);
             if (r < ARCHIVE_OK)
             {
@@ -346,9 +394,45 @@ namespace mamba
         fs::current_path(prev_path);
     }
 
-    void extract_conda(const fs::path& file,
-                       const fs::path& dest_dir,
-                       const std::vector<std::string>& parts)
+    void extract_archive(const fs::path& file, const fs::path& destination)
+    {
+        extract_archive(file, destination, nullptr);
+    }
+
+    // Links the files of the 'pkg' part that are already in the content
+    // store instead of decompressing and writing them again
+    static entry_hook content_store_hook(const ContentStore& store, const fs::path& dest_dir)
+    {
+        auto paths_data = std::make_shared<std::map<std::string, std::string>>();
+        for (const auto& p : read_paths(dest_dir))
+        {
+            if (p.path_type == PathType::HARDLINK && !p.sha256.empty())
+            {
+                (*paths_data)[p.path] = p.sha256;
+            }
+        }
+
+        fs::path abs_dest_dir = fs::absolute(dest_dir);
+        return [&store, paths_data, abs_dest_dir](archive_entry* entry) -> bool {
+            if (archive_entry_filetype(entry) != AE_IFREG)
+            {
+                return false;
+            }
+            auto it = paths_data->find(archive_entry_pathname(entry));
+            if (it == paths_data->end())
+            {
+                return false;
+            }
+            return store.link(it->second,
+                              static_cast<fs::perms>(archive_entry_perm(entry)),
+                              abs_dest_dir / it->first);
+        };
+    }
+
+    static void extract_conda(const fs::path& file,
+                              const fs::path& dest_dir,
+                              const std::vector<std::string>& parts,
+                              const ContentStore* store)
     {
         TemporaryDirectory tdir;
         extract_archive(file, tdir);
@@ -375,12 +459,31 @@ namespace mamba
         {
             std::stringstream ss;
             ss << part << "-" << fn.c_str() << ".tar.zst";
-            extract_archive(tdir.path() / ss.str(), dest_dir);
+            entry_hook hook;
+            // the 'info' part (and thus 'paths.json') comes first by default
+            if (store && part == "pkg" && fs::exists(dest_dir / "info" / "paths.json"))
+            {
+                hook = content_store_hook(*store, dest_dir);
+            }
+            extract_archive(tdir.path() / ss.str(), dest_dir, hook);
         }
     }
 
+    void extract_conda(const fs::path& file,
+                       const fs::path& dest_dir,
+                       const std::vector<std::string>& parts)
+    {
+        extract_conda(file, dest_dir, parts, nullptr);
+    }
+
     fs::path extract(const fs::path& file)
     {
+        std::unique_ptr<ContentStore> store;
+        if (Context::instance().use_content_store)
+        {
+            store = std::make_unique<ContentStore>(fs::absolute(file).parent_path());
+        }
+
         std::string dest_dir = file;
         if (ends_with(dest_dir, ".tar.bz2"))
         {
@@ -390,34 +493,74 @@ namespace mamba
         else if (ends_with(dest_dir, ".conda"))
         {
             dest_dir = dest_dir.substr(0, dest_dir.size() - 6);
-            extract_conda(file, dest_dir);
+            extract_conda(file, dest_dir, { "info", "pkg" }, store.get());
         }
         else
         {
             throw std::runtime_error("Unknown package format (" + file.string() + ")");
         }
+
+        if (store && !is_sig_interrupted())
+        {
+            store->deduplicate(dest_dir);
+        }
         return dest_dir;
     }
 
-    bool transmute(const fs::path& pkg_file, const fs::path& target, int compression_level)
+    // extraction changes the working directory of the process
+    static std::mutex transmute_extract_mutex;
+
+    bool transmute(const fs::path& pkg_file,
+                   const fs::path& target,
+                   int compression_level,
+                   int compression_threads)
     {
         TemporaryDirectory extract_dir;
+        fs::path abs_pkg_file = fs::absolute(pkg_file);
 
-        if (ends_with(pkg_file.string(), ".tar.bz2"))
         {
-            extract_archive(pkg_file, extract_dir);
-        }
-        else if (ends_with(pkg_file.string(), ".conda"))
-        {
-            extract_conda(pkg_file, extract_dir);
+            std::lock_guard<std::mutex> lock(transmute_extract_mutex);
+            if (ends_with(pkg_file.string(), ".tar.bz2"))
+            {
+                extract_archive(abs_pkg_file, extract_dir);
+            }
+            else if (ends_with(pkg_file.string(), ".conda"))
+            {
+                extract_conda(abs_pkg_file, extract_dir);
+            }
+            else
+            {
+                throw std::runtime_error("Unknown package format (" + pkg_file.string() + ")");
+            }
         }
-        else
+
+        create_package(extract_dir, target, compression_level, compression_threads);
+        return true;
+    }
+
+    bool transmute(const std::vector<std::pair<fs::path, fs::path>>& pkgs,
+                   int compression_level,
+                   int compression_threads,
+                   std::size_t max_threads)
+    {
+        std::vector<std::pair<fs::path, fs::path>> abs_pkgs;
+        abs_pkgs.reserve(pkgs.size());
+        for (const auto& [pkg_file, target] : pkgs)
         {
-            throw std::runtime_error("Unknown package format (" + pkg_file.string() + ")");
+            abs_pkgs.emplace_back(fs::absolute(pkg_file), fs::absolute(target));
         }
 
-        create_package(extract_dir, target, compression_level);
-        return true;
+        // only the compression runs concurrently, extractions are serialized
+        parallel_for(abs_pkgs.size(), max_threads, [&](std::size_t i) {
+            if (is_sig_interrupted())
+            {
+                return;
+            }
+            LOG_INFO << "Transmuting " << abs_pkgs[i].first << " to " << abs_pkgs[i].second;
+            transmute(
+                abs_pkgs[i].first, abs_pkgs[i].second, compression_level, compression_threads);
+        });
+        return !is_sig_interrupted();
     }
 
     bool validate(const fs::path& pkg_folder)
@@ -435,6 +578,9 @@ namespace mamba
         try
         {
             auto paths_data = read_paths(pkg_folder);
+            // files whose checksum needs to be computed, deferred to
+            // be processed concurrently once the cheap checks passed
+            std::vector<const PathData*> to_hash;
             for (auto& p : paths_data)
             {
                 fs::path full_path = pkg_folder / p.path;
@@ -467,17 +613,35 @@ namespace mamba
                             return false;
                         }
                     }
-                    if (full_validation && !is_invalid && p.path_type != PathType::SOFTLINK
-                        && !validate::sha256(full_path, p.sha256))
+                    if (full_validation && !is_invalid && p.path_type != PathType::SOFTLINK)
+                    {
+                        to_hash.push_back(&p);
+                    }
+                }
+            }
+
+            std::atomic<bool> valid(true);
+            parallel_for(
+                to_hash.size(), Context::instance().validation_threads, [&](std::size_t i) {
+                    // stop early, the package is already known to be invalid
+                    if (is_fail && !valid.load())
+                    {
+                        return;
+                    }
+                    fs::path full_path = pkg_folder / to_hash[i]->path;
+                    if (!validate::sha256(full_path, to_hash[i]->sha256))
                     {
                         LOG_WARNING << "Invalid package cache, file '" << full_path.string()
                                     << "' has incorrect SHA-256 checksum";
                         if (is_fail)
                         {
-                            return false;
+                            valid.store(false);
                         }
                     }
-                }
+                });
+            if (!valid.load())
+            {
+                return false;
             }
         }
         catch (...)
@@ -4,8 +4,22 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <set>
+
 #include "mamba/core/pool.hpp"
+#include "mamba/core/channel.hpp"
+#include "mamba/core/match_spec.hpp"
 #include "mamba/core/output.hpp"
+#include "mamba/core/util.hpp"
+
+extern "C"
+{
+#include "solv/conda.h"
+#include "solv/repo.h"
+}
 
 namespace mamba
 {
@@ -14,12 +28,15 @@ namespace mamba
         m_pool = pool_create();
         pool_setdisttype(m_pool, DISTTYPE_CONDA);
         set_debuglevel();
+        map_init(&m_considered, 0);
     }
 
     MPool::~MPool()
     {
         LOG_INFO << "Freeing pool.";
+        m_pool->considered = nullptr;
         pool_free(m_pool);
+        map_free(&m_considered);
     }
 
     void MPool::set_debuglevel()
@@ -37,6 +54,312 @@ namespace mamba
         pool_createwhatprovides(m_pool);
     }
 
+    void MPool::add_repo_channel(Repo* repo, const Channel& channel)
+    {
+        m_repo_channels[repo] = &channel;
+    }
+
+    void MPool::remove_repo_channel(Repo* repo)
+    {
+        m_repo_channels.erase(repo);
+    }
+
+    const Channel* MPool::repo_channel(Repo* repo)
+    {
+        auto it = m_repo_channels.find(repo);
+        if (it == m_repo_channels.end())
+        {
+            // repo not created through MRepo, the name is the URL of the repo
+            it = m_repo_channels.emplace(repo, &make_channel(repo->name)).first;
+        }
+        return it->second;
+    }
+
+    namespace
+    {
+        Id dep_name(Pool* pool, Id dep)
+        {
+            while (ISRELDEP(dep))
+            {
+                dep = GETRELDEP(pool, dep)->name;
+            }
+            return dep;
+        }
+    }
+
+    std::size_t MPool::prune_incompatible(const std::vector<std::string>& pins)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Pool* pool = m_pool;
+
+        // "__" packages provided by channels instead of being virtual packages,
+        // the requirements on them are left to the solver
+        std::set<Id> channel_packages;
+        Id p;
+        Solvable* s;
+        FOR_POOL_SOLVABLES(p)
+        {
+            s = pool_id2solvable(pool, p);
+            if (s->repo != pool->installed && starts_with(pool_id2str(pool, s->name), "__"))
+            {
+                channel_packages.insert(s->name);
+            }
+        }
+
+        // the matching of conda specs relies on whatprovides, which is created
+        // again by the solver without the pruned packages
+        pool_createwhatprovides(pool);
+        auto providers = [&](Id dep) {
+            std::set<Id> res;
+            for (Id* wp = pool_whatprovides_ptr(pool, dep); *wp; ++wp)
+            {
+                res.insert(*wp);
+            }
+            return res;
+        };
+
+        // packages matching the pins, by name; channel specific pins are left to
+        // the solver
+        std::map<Id, std::set<Id>> pinned;
+        for (const auto& pin : pins)
+        {
+            MatchSpec ms(pin);
+            Id name = pool_str2id(pool, ms.name.c_str(), 0);
+            if (ms.channel.empty() && name)
+            {
+                Id match = pool_conda_matchspec(pool, ms.conda_build_form().c_str());
+                auto matching = providers(match);
+                auto it = pinned.find(name);
+                if (it == pinned.end())
+                {
+                    pinned.emplace(name, std::move(matching));
+                }
+                else
+                {
+                    std::set<Id> both;
+                    std::set_intersection(it->second.begin(),
+                                          it->second.end(),
+                                          matching.begin(),
+                                          matching.end(),
+                                          std::inserter(both, both.begin()));
+                    it->second = std::move(both);
+                }
+            }
+        }
+
+        // whether a requirement on a virtual package is satisfied, by dependency
+        std::map<Id, bool> virtual_deps;
+        auto is_installable = [&](Id id, Solvable* s, Queue& deps) {
+            auto pin = pinned.find(s->name);
+            if (pin != pinned.end() && pin->second.count(id) == 0)
+            {
+                return false;
+            }
+
+            queue_empty(&deps);
+            solvable_lookup_deparray(s, SOLVABLE_REQUIRES, &deps, 0);
+            for (int i = 0; i < deps.count; ++i)
+            {
+                Id dep = deps.elements[i];
+                Id name = dep_name(pool, dep);
+                if (!starts_with(pool_id2str(pool, name), "__")
+                    || channel_packages.count(name) != 0)
+                {
+                    continue;
+                }
+                auto it = virtual_deps.find(dep);
+                if (it == virtual_deps.end())
+                {
+                    bool satisfied = false;
+                    for (Id provider : providers(dep))
+                    {
+                        Repo* repo = pool_id2solvable(pool, provider)->repo;
+                        satisfied = satisfied || repo == pool->installed;
+                    }
+                    it = virtual_deps.emplace(dep, satisfied).first;
+                }
+                if (!it->second)
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        std::size_t pruned = 0;
+        Queue deps;
+        queue_init(&deps);
+        FOR_POOL_SOLVABLES(p)
+        {
+            s = pool_id2solvable(pool, p);
+            if (s->repo != pool->installed && is_considered(p) && !is_installable(p, s, deps))
+            {
+                exclude(p);
+                ++pruned;
+            }
+        }
+        queue_free(&deps);
+
+        LOG_INFO << "Pruned " << pruned << " of " << pool->nsolvables
+                 << " packages incompatible with the virtual packages and the pins in "
+                 << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                              - start)
+                        .count()
+                 << " ms";
+        return pruned;
+    }
+
+    std::size_t MPool::prune_unreachable(const std::vector<std::string>& specs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Pool* pool = m_pool;
+
+        // the packages by name, the whatprovides of the solver is not created yet
+        std::unordered_map<Id, std::vector<Id>> packages;
+        std::vector<Id> names;
+        Id p;
+        Solvable* s;
+        FOR_POOL_SOLVABLES(p)
+        {
+            s = pool_id2solvable(pool, p);
+            if (s->repo == pool->installed)
+            {
+                names.push_back(s->name);
+            }
+            else if (is_considered(p))
+            {
+                packages[s->name].push_back(p);
+            }
+        }
+        for (const auto& spec : specs)
+        {
+            Id name = pool_str2id(pool, MatchSpec(spec).name.c_str(), 0);
+            if (name)
+            {
+                names.push_back(name);
+            }
+        }
+
+        // names reachable from the requested and the installed packages
+        std::set<Id> reached(names.begin(), names.end());
+        Queue deps;
+        queue_init(&deps);
+        while (!names.empty())
+        {
+            Id name = names.back();
+            names.pop_back();
+            auto it = packages.find(name);
+            if (it == packages.end())
+            {
+                continue;
+            }
+            for (Id id : it->second)
+            {
+                for (Id keyname : { SOLVABLE_REQUIRES, SOLVABLE_CONSTRAINS })
+                {
+                    queue_empty(&deps);
+                    solvable_lookup_deparray(pool_id2solvable(pool, id), keyname, &deps, 0);
+                    for (int i = 0; i < deps.count; ++i)
+                    {
+                        Id dep = dep_name(pool, deps.elements[i]);
+                        if (reached.insert(dep).second)
+                        {
+                            names.push_back(dep);
+                        }
+                    }
+                }
+            }
+        }
+        queue_free(&deps);
+
+        std::size_t pruned = 0;
+        for (const auto& [name, ids] : packages)
+        {
+            if (reached.count(name) == 0)
+            {
+                for (Id id : ids)
+                {
+                    exclude(id);
+                    ++pruned;
+                }
+            }
+        }
+
+        LOG_INFO << "Pruned " << pruned << " of " << pool->nsolvables << " packages not reachable ("
+                 << reached.size() << " package names reached) in "
+                 << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                              - start)
+                        .count()
+                 << " ms";
+        return pruned;
+    }
+
+    const std::vector<Id>& MPool::whatrequires(Id name)
+    {
+        Pool* pool = m_pool;
+        if (m_reverse_deps_nsolvables != pool->nsolvables)
+        {
+            m_reverse_deps.clear();
+            Id p;
+            Solvable* s;
+            FOR_POOL_SOLVABLES(p)
+            {
+                s = pool_id2solvable(pool, p);
+                if (!s->requires)
+                {
+                    continue;
+                }
+                for (Id* reqp = s->repo->idarraydata + s->requires; *reqp; ++reqp)
+                {
+                    // the same name can be required more than once
+                    auto& solvables = m_reverse_deps[dep_name(pool, *reqp)];
+                    if (solvables.empty() || solvables.back() != p)
+                    {
+                        solvables.push_back(p);
+                    }
+                }
+            }
+            m_reverse_deps_nsolvables = pool->nsolvables;
+        }
+
+        static const std::vector<Id> none;
+        auto it = m_reverse_deps.find(name);
+        return it != m_reverse_deps.end() ? it->second : none;
+    }
+
+    bool MPool::is_considered(Id id) const
+    {
+        return !m_pool->considered || MAPTST(m_pool->considered, id);
+    }
+
+    void MPool::exclude(Id id)
+    {
+        if (!m_pool->considered)
+        {
+            map_free(&m_considered);
+            map_init(&m_considered, m_pool->nsolvables);
+            map_setall(&m_considered);
+            m_pool->considered = &m_considered;
+        }
+        MAPCLR(&m_considered, id);
+        ++m_pruned_solvables;
+    }
+
+    std::size_t MPool::pruned_solvables() const
+    {
+        return m_pruned_solvables;
+    }
+
+    void MPool::add_loading_time(std::chrono::steady_clock::duration duration)
+    {
+        m_loading_time += duration;
+    }
+
+    std::chrono::steady_clock::duration MPool::loading_time() const
+    {
+        return m_loading_time;
+    }
+
     MPool::operator Pool*()
     {
         return m_pool;
@@ -4,8 +4,14 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <functional>
+#include <set>
+
 #include "mamba/core/prefix_data.hpp"
+#include "mamba/core/match_spec.hpp"
 #include "mamba/core/output.hpp"
+#include "mamba/core/transaction_journal.hpp"
 
 
 namespace mamba
@@ -19,6 +25,12 @@ namespace mamba
     void PrefixData::load()
     {
         auto conda_meta_dir = m_prefix_path / "conda-meta";
+        if (TransactionJournal::pending(m_prefix_path))
+        {
+            LOG_WARNING << "An interrupted transaction in " << m_prefix_path
+                        << " will be rolled back by the next transaction";
+        }
+
         if (lexists(conda_meta_dir))
         {
             for (auto& p : fs::directory_iterator(conda_meta_dir))
@@ -46,6 +58,37 @@ namespace mamba
         return m_package_records;
     }
 
+    std::vector<PackageInfo> PrefixData::sorted_records() const
+    {
+        std::vector<std::string> names;
+        for (const auto& [name, record] : m_package_records)
+        {
+            names.push_back(name);
+        }
+        // deterministic order between independent packages and in cycles
+        std::sort(names.begin(), names.end());
+
+        std::vector<PackageInfo> res;
+        std::set<std::string> visited;
+        std::function<void(const std::string&)> visit = [&](const std::string& name) {
+            auto it = m_package_records.find(name);
+            if (it == m_package_records.end() || !visited.insert(name).second)
+            {
+                return;
+            }
+            for (const auto& dep : it->second.depends)
+            {
+                visit(MatchSpec(dep).name);
+            }
+            res.push_back(it->second);
+        };
+        for (const auto& name : names)
+        {
+            visit(name);
+        }
+        return res;
+    }
+
     History& PrefixData::history()
     {
         return m_history;
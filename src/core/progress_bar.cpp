@@ -17,9 +17,8 @@ namespace mamba
      * ProgressProxy *
      *****************/
 
-    ProgressProxy::ProgressProxy(ProgressBar* ptr, std::size_t idx)
+    ProgressProxy::ProgressProxy(ProgressBar* ptr)
         : p_bar(ptr)
-        , m_idx(idx)
     {
     }
 
@@ -35,7 +34,7 @@ namespace mamba
             return;
         }
         p_bar->set_progress(current, total);
-        Console::instance().print_progress(m_idx);
+        p_bar->activate();
     }
 
     void ProgressProxy::elapsed_time_to_stream(std::stringstream& s)
@@ -47,13 +46,24 @@ namespace mamba
         p_bar->elapsed_time_to_stream(s);
     }
 
+    void ProgressProxy::set_postfix(const std::string& s)
+    {
+        p_bar->set_postfix(s);
+        p_bar->activate();
+    }
+
+    void ProgressProxy::set_transfer(std::size_t current, std::size_t total, std::size_t speed)
+    {
+        p_bar->set_transfer(current, total, speed);
+    }
+
     void ProgressProxy::mark_as_completed(const std::string_view& final_message)
     {
         if (is_sig_interrupted())
         {
             return;
         }
-        Console::instance().deactivate_progress_bar(m_idx, final_message);
+        p_bar->complete(final_message);
     }
 
     void ProgressProxy::mark_as_extracted()
@@ -63,7 +73,7 @@ namespace mamba
             return;
         }
         p_bar->set_extracted();
-        Console::instance().print_progress(m_idx);
+        p_bar->activate();
     }
 
     /**********************
@@ -86,7 +96,7 @@ namespace mamba
     MultiBarManager::MultiBarManager()
         : m_progress_bars()
         , m_active_progress_bars()
-        , m_progress_started(false)
+        , m_drawn(0)
     {
     }
 
@@ -98,92 +108,108 @@ namespace mamba
 
         m_progress_bars.push_back(std::make_unique<DefaultProgressBar>(prefix));
 
-        return ProgressProxy(m_progress_bars[m_progress_bars.size() - 1].get(),
-                             m_progress_bars.size() - 1);
+        return ProgressProxy(m_progress_bars[m_progress_bars.size() - 1].get());
     }
 
-    void MultiBarManager::print_progress(std::size_t idx)
+    void MultiBarManager::render(bool skip_progress_bars)
     {
-        std::size_t cursor_up = m_active_progress_bars.size();
-        if (m_progress_started && cursor_up > 0)
+        if (m_drawn > 0)
         {
-            std::cout << cursor::up(cursor_up);
+            std::cout << cursor::up(m_drawn);
+            m_drawn = 0;
         }
-
-        auto it = std::find(m_active_progress_bars.begin(),
-                            m_active_progress_bars.end(),
-                            m_progress_bars[idx].get());
-        if (it == m_active_progress_bars.end())
+        update(skip_progress_bars);
+        if (!skip_progress_bars)
         {
-            m_active_progress_bars.push_back(m_progress_bars[idx].get());
+            draw();
         }
-
-        print_progress();
-        m_progress_started = true;
+        std::cout << std::flush;
     }
 
-    void MultiBarManager::deactivate_progress_bar(std::size_t idx, const std::string_view& msg)
+    void MultiBarManager::print(const std::string_view& str, bool skip_progress_bars)
     {
-        auto& ctx = Context::instance();
-        if (ctx.no_progress_bars && !(ctx.json || ctx.quiet))
+        bool drawn = m_drawn > 0;
+        if (drawn)
         {
-            std::cout << m_progress_bars[idx]->prefix() << " " << msg << '\n';
+            std::cout << cursor::up(m_drawn);
+            m_drawn = 0;
         }
-
-        auto it = std::find(m_active_progress_bars.begin(),
-                            m_active_progress_bars.end(),
-                            m_progress_bars[idx].get());
-        if (it == m_active_progress_bars.end())
+        update(skip_progress_bars);
+        if (drawn)
         {
-            return;
+            std::cout << cursor::erase_line();
         }
-
-        m_active_progress_bars.erase(it);
-
-        if (ctx.no_progress_bars || ctx.json || ctx.quiet)
+        std::cout << str << '\n';
+        if (!skip_progress_bars)
         {
-            return;
+            draw();
         }
-
-        int ps = m_active_progress_bars.size();
-        std::cout << cursor::up(ps + 1) << cursor::erase_line();
-        if (msg.empty())
-        {
-            m_progress_bars[idx]->print();
-            std::cout << std::endl;
-        }
-        else
-        {
-            std::cout << msg << std::endl;
-        }
-        print_progress();
+        std::cout << std::flush;
     }
 
-    void MultiBarManager::print(const std::string_view& str, bool skip_progress_bars)
+    void MultiBarManager::update(bool skip_progress_bars)
     {
-        if (m_progress_started && m_active_progress_bars.size())
+        // the bars activated since the last frame, before the completions to
+        // print the final message of a bar activated and completed meanwhile
+        for (auto& bar : m_progress_bars)
         {
-            const auto& ps = m_active_progress_bars.size();
-            std::cout << cursor::up(ps) << cursor::erase_line() << str << std::endl;
-            if (!skip_progress_bars)
+            if (bar->is_active()
+                && std::find(m_active_progress_bars.begin(),
+                             m_active_progress_bars.end(),
+                             bar.get())
+                       == m_active_progress_bars.end())
             {
-                print_progress();
+                m_active_progress_bars.push_back(bar.get());
             }
         }
-        else
+
+        auto& ctx = Context::instance();
+        std::string msg;
+        for (auto& bar : m_progress_bars)
         {
-            std::cout << str << std::endl;
+            if (!bar->take_completion(msg))
+            {
+                continue;
+            }
+
+            if (ctx.no_progress_bars && !(ctx.json || ctx.quiet))
+            {
+                std::cout << bar->prefix() << " " << msg << '\n';
+            }
+
+            auto it = std::find(
+                m_active_progress_bars.begin(), m_active_progress_bars.end(), bar.get());
+            if (it == m_active_progress_bars.end())
+            {
+                continue;
+            }
+            m_active_progress_bars.erase(it);
+
+            if (skip_progress_bars)
+            {
+                continue;
+            }
+            std::cout << cursor::erase_line();
+            if (msg.empty())
+            {
+                bar->print();
+            }
+            else
+            {
+                std::cout << msg;
+            }
+            std::cout << '\n';
         }
     }
 
-    void MultiBarManager::print_progress()
+    void MultiBarManager::draw()
     {
         for (auto& bar : m_active_progress_bars)
         {
             bar->print();
             std::cout << '\n';
         }
-        std::cout << std::flush;
+        m_drawn = m_active_progress_bars.size();
     }
 
     /************************
@@ -196,17 +222,18 @@ namespace mamba
         , p_extract_bar(std::make_unique<DefaultProgressBar>("Extracting   ", 100))
         , m_completed(0)
         , m_extracted(0)
-        , m_main_mutex()
         , m_current(0)
         , m_total(0)
+        , m_updated(false)
         , m_progress_started(false)
+        , m_drawn(0)
     {
     }
 
     ProgressProxy AggregatedBarManager::add_progress_bar(const std::string& name,
                                                          size_t expected_total)
     {
-        if (!m_progress_started)
+        if (m_progress_bars.empty())
         {
             m_start_time = std::chrono::high_resolution_clock::now();
         }
@@ -218,103 +245,137 @@ namespace mamba
             std::make_unique<HiddenProgressBar>(prefix, this, expected_total));
         m_total += expected_total;
 
-        return ProgressProxy(m_progress_bars[m_progress_bars.size() - 1].get(),
-                             m_progress_bars.size() - 1);
+        return ProgressProxy(m_progress_bars[m_progress_bars.size() - 1].get());
     }
 
-    void AggregatedBarManager::print_progress(std::size_t idx)
+    void AggregatedBarManager::render(bool skip_progress_bars)
     {
-        if (m_progress_started)
+        if (m_drawn > 0)
         {
-            std::cout << cursor::up(2);
+            std::cout << cursor::up(m_drawn);
+            m_drawn = 0;
         }
-
-        if (!is_complete())
+        update(skip_progress_bars);
+        if (!skip_progress_bars)
         {
-            m_progress_started = true;
+            draw();
         }
-        print_progress();
+        std::cout << std::flush;
     }
 
-    void AggregatedBarManager::deactivate_progress_bar(std::size_t idx, const std::string_view& msg)
+    void AggregatedBarManager::print(const std::string_view& str, bool skip_progress_bars)
     {
-        if (Context::instance().quiet || Context::instance().json)
+        bool drawn = m_drawn > 0;
+        if (drawn)
         {
-            return;
+            std::cout << cursor::up(m_drawn);
+            m_drawn = 0;
         }
-        else if (Context::instance().no_progress_bars)
+        update(skip_progress_bars);
+        if (drawn)
         {
-            std::cout << msg << '\n';
-            return;
+            std::cout << cursor::erase_line();
         }
-
-        std::cout << cursor::up(2) << cursor::erase_line();
-        std::cout << msg << std::endl;
-        ++m_completed;
-        if (m_completed == m_progress_bars.size())
+        std::cout << str << '\n';
+        if (!skip_progress_bars)
         {
-            const std::lock_guard<std::mutex> lock(m_main_mutex);
-            m_current = m_total;
-            p_download_bar->set_progress(m_total, m_total);
+            draw();
         }
-        print_progress();
+        std::cout << std::flush;
     }
 
-    void AggregatedBarManager::print(const std::string_view& str, bool skip_progress_bars)
+    void AggregatedBarManager::update_download_bar(std::size_t current_diff)
+    {
+        m_current += current_diff;
+        m_updated = true;
+    }
+
+    void AggregatedBarManager::update_extract_bar()
+    {
+        ++m_extracted;
+        m_updated = true;
+    }
+
+    void AggregatedBarManager::update(bool /*skip_progress_bars*/)
     {
-        if (m_progress_started && !is_complete() && !skip_progress_bars)
+        if (m_updated.exchange(false) && !is_complete())
         {
-            std::cout << cursor::erase_line() << str << std::endl;
-            print_progress();
+            m_progress_started = true;
         }
-        else
+
+        auto& ctx = Context::instance();
+        std::string msg;
+        for (auto& bar : m_progress_bars)
+        {
+            if (!bar->take_completion(msg))
+            {
+                continue;
+            }
+            ++m_completed;
+            if (ctx.quiet || ctx.json)
+            {
+                continue;
+            }
+            else if (ctx.no_progress_bars)
+            {
+                std::cout << msg << '\n';
+            }
+            else
+            {
+                std::cout << cursor::erase_line() << msg << '\n';
+            }
+        }
+        if (m_completed == m_progress_bars.size())
         {
-            std::cout << str << std::endl;
+            m_current = m_total;
         }
     }
 
-    void AggregatedBarManager::update_download_bar(std::size_t current_diff)
+    void AggregatedBarManager::draw()
     {
-        auto update_time = std::chrono::high_resolution_clock::now();
-        const std::lock_guard<std::mutex> lock(m_main_mutex);
-        m_current += current_diff;
-        auto diff_time
-            = std::chrono::duration_cast<std::chrono::milliseconds>(update_time - m_start_time);
-        size_t speed = static_cast<double>(m_current) / diff_time.count() * 1000;
-        p_download_bar->set_progress(m_current, m_total);
+        if (!m_progress_started)
+        {
+            return;
+        }
+
+        size_t current = m_current;
+        p_download_bar->set_progress(current, m_total);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::high_resolution_clock::now() - m_start_time)
+                           .count();
+        size_t speed
+            = static_cast<double>(current) / (std::max)(elapsed, decltype(elapsed)(1)) * 1000;
         std::stringstream s;
         s << std::setw(7);
         to_human_readable_filesize(s, speed, 2);
         s << "/s";
         p_download_bar->set_postfix(s.str());
-    }
 
-    void AggregatedBarManager::update_extract_bar()
-    {
-        const std::lock_guard<std::mutex> lock(m_main_mutex);
-        size_t bars_number = m_progress_bars.size();
-        int padding = std::to_string(bars_number).length();
-        ++m_extracted;
-        p_extract_bar->set_progress(m_extracted, bars_number);
-        std::stringstream s;
-        s << std::setw(9 - padding) << m_extracted << " / " << bars_number;
-        p_extract_bar->set_postfix(s.str());
-    }
-
-    void AggregatedBarManager::print_progress()
-    {
-        const std::lock_guard<std::mutex> lock(m_main_mutex);
-        if (m_progress_started)
+        size_t extracted = m_extracted;
+        if (extracted > 0)
         {
-            p_download_bar->print();
-            std::cout << '\n';
-            p_extract_bar->print();
-            std::cout << '\n';
+            size_t bars_number = m_progress_bars.size();
+            int padding = std::to_string(bars_number).length();
+            p_extract_bar->set_progress(extracted, bars_number);
+            std::stringstream e;
+            e << std::setw(9 - padding) << extracted << " / " << bars_number;
+            p_extract_bar->set_postfix(e.str());
         }
+
+        p_download_bar->print();
+        std::cout << '\n';
+        p_extract_bar->print();
+        std::cout << '\n';
+
+        // the complete bars stay on the console
         if (is_complete())
         {
             m_progress_started = false;
         }
+        else
+        {
+            m_drawn = 2;
+        }
     }
 
     bool AggregatedBarManager::is_complete() const
@@ -372,22 +433,39 @@ namespace mamba
     }
 
     ProgressBar::ProgressBar(const std::string& prefix)
-        : m_prefix(prefix)
-        , m_start_time_saved(false)
+        : m_start_time(0)
+        , m_prefix(prefix)
         , m_activate_bob(false)
+        , m_active(false)
+        , m_completed(false)
+        , m_transfer_postfix(false)
+        , m_transfer_current(0)
+        , m_transfer_total(0)
+        , m_transfer_speed(0)
     {
     }
 
     void ProgressBar::set_start()
     {
-        m_start_time = std::chrono::high_resolution_clock::now();
-        m_start_time_saved = true;
+        auto now = std::chrono::high_resolution_clock::now().time_since_epoch();
+        std::chrono::nanoseconds::rep unset = 0;
+        m_start_time.compare_exchange_strong(
+            unset, std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
     }
 
-
     void ProgressBar::set_postfix(const std::string& postfix_text)
     {
+        std::lock_guard<std::mutex> lock(m_text_mutex);
         m_postfix = postfix_text;
+        m_transfer_postfix = false;
+    }
+
+    void ProgressBar::set_transfer(std::size_t current, std::size_t total, std::size_t speed)
+    {
+        m_transfer_current = current;
+        m_transfer_total = total;
+        m_transfer_speed = speed;
+        m_transfer_postfix = true;
     }
 
     const std::string& ProgressBar::prefix() const
@@ -395,14 +473,80 @@ namespace mamba
         return m_prefix;
     }
 
+    void ProgressBar::activate()
+    {
+        m_active = true;
+    }
+
+    void ProgressBar::complete(const std::string_view& final_message)
+    {
+        std::lock_guard<std::mutex> lock(m_text_mutex);
+        m_final_message = final_message;
+        m_completed = true;
+    }
+
+    bool ProgressBar::is_active() const
+    {
+        return m_active;
+    }
+
+    bool ProgressBar::take_completion(std::string& final_message)
+    {
+        if (!m_completed.exchange(false))
+        {
+            return false;
+        }
+        m_active = false;
+        std::lock_guard<std::mutex> lock(m_text_mutex);
+        final_message = m_final_message;
+        return true;
+    }
+
+    std::chrono::nanoseconds ProgressBar::elapsed() const
+    {
+        auto now = std::chrono::high_resolution_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now)
+               - std::chrono::nanoseconds(m_start_time);
+    }
+
+    std::string ProgressBar::postfix()
+    {
+        if (!m_transfer_postfix)
+        {
+            std::lock_guard<std::mutex> lock(m_text_mutex);
+            return m_postfix;
+        }
+
+        std::size_t total = m_transfer_total;
+        std::stringstream s;
+        if (total == SIZE_MAX)
+        {
+            to_human_readable_filesize(s, m_transfer_current);
+            s << " / ?? (";
+            to_human_readable_filesize(s, m_transfer_speed, 2);
+            s << "/s)";
+        }
+        else
+        {
+            s << std::setw(6);
+            to_human_readable_filesize(s, m_transfer_current);
+            s << " / ";
+            s << std::setw(6);
+            to_human_readable_filesize(s, total);
+            s << " (";
+            s << std::setw(6);
+            to_human_readable_filesize(s, m_transfer_speed, 2);
+            s << "/s)";
+        }
+        return s.str();
+    }
+
     void ProgressBar::elapsed_time_to_stream(std::stringstream& s)
     {
-        if (m_start_time_saved)
+        if (m_start_time != 0)
         {
-            auto now = std::chrono::high_resolution_clock::now();
-            m_elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_start_time);
             s << "(";
-            write_duration(s, m_elapsed_ns);
+            write_duration(s, elapsed());
             s << ") ";
         }
         else
@@ -429,7 +573,7 @@ namespace mamba
 
         std::stringstream pf;
         elapsed_time_to_stream(pf);
-        pf << m_postfix;
+        pf << postfix();
         auto fpf = pf.str();
         int width = get_console_width();
         width = (width == -1)
@@ -444,7 +588,9 @@ namespace mamba
         }
         else
         {
-            auto pos = static_cast<int>(m_progress * width / 100.0);
+            // moves by 5% every 150 ms, whatever the rate of the updates
+            auto steps = elapsed() / std::chrono::milliseconds(150);
+            auto pos = static_cast<int>((steps * 5 % 100) * width / 100.0);
             for (int i = 0; i < width; ++i)
             {
                 if (i == pos - 1)
@@ -470,29 +616,24 @@ namespace mamba
 
     void DefaultProgressBar::set_full()
     {
-        if (!m_start_time_saved)
-        {
-            set_start();
-        }
+        set_start();
         m_activate_bob = false;
         m_progress = 100;
     }
 
     void DefaultProgressBar::set_progress(size_t current, size_t total)
     {
-        if (!m_start_time_saved)
-        {
-            set_start();
-        }
+        set_start();
 
         if (current == SIZE_MAX)
         {
             m_activate_bob = true;
-            m_progress += 5;
         }
         else
         {
-            size_t p = static_cast<double>(current) / static_cast<double>(total) * 100.;
+            size_t p = total == 0
+                           ? 0
+                           : static_cast<double>(current) / static_cast<double>(total) * 100.;
             m_activate_bob = false;
             m_progress = p;
         }
@@ -522,22 +663,15 @@ namespace mamba
 
     void HiddenProgressBar::set_full()
     {
-        if (!m_start_time_saved)
-        {
-            set_start();
-        }
-        p_manager->update_download_bar(m_total - m_current);
+        set_start();
+        p_manager->update_download_bar(m_total - m_current.exchange(m_total));
     }
 
     void HiddenProgressBar::set_progress(size_t current, size_t /*total*/)
     {
-        if (!m_start_time_saved)
-        {
-            set_start();
-        }
-        size_t old_current = m_current;
-        m_current = current;
-        p_manager->update_download_bar(m_current - old_current);
+        set_start();
+        size_t old_current = m_current.exchange(current);
+        p_manager->update_download_bar(current - old_current);
     }
 
     void HiddenProgressBar::set_extracted()
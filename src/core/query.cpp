@@ -10,6 +10,7 @@ extern "C"
 }
 
 #include <iomanip>
+#include <limits>
 #include <numeric>
 #include <set>
 #include <sstream>
@@ -23,10 +24,27 @@ extern "C"
 
 namespace mamba
 {
+    namespace
+    {
+        // node of the visited solvables in the dependency graph, by solvable id
+        using visited_list = std::vector<std::size_t>;
+        constexpr std::size_t not_visited = std::numeric_limits<std::size_t>::max();
+
+        visited_list make_visited_list(Pool* pool,
+                                       Id id,
+                                       query_result::dependency_graph::node_id node)
+        {
+            visited_list visited(pool->nsolvables, not_visited);
+            visited[id] = node;
+            return visited;
+        }
+    }
+
     void walk_graph(query_result::dependency_graph& dep_graph,
                     query_result::dependency_graph::node_id parent,
-                    Solvable* s,
-                    std::map<Solvable*, size_t>& visited,
+                    Pool* pool,
+                    Id id,
+                    visited_list& visited,
                     std::map<std::string, size_t>& not_found,
                     int depth = -1)
     {
@@ -36,44 +54,37 @@ namespace mamba
         }
         depth -= 1;
 
-        if (s && s->requires)
+        Solvable* s = pool_id2solvable(pool, id);
+        if (s->requires)
         {
-            auto* pool = s->repo->pool;
-
             Id* reqp = s->repo->idarraydata + s->requires;
             Id req = *reqp;
 
             while (req != 0)
             {
-                Queue job, rec_solvables;
-                queue_init(&rec_solvables);
-                queue_init(&job);
                 // the following prints the requested version
-                queue_push2(&job, SOLVER_SOLVABLE_PROVIDES, req);
-                selection_solvables(pool, &job, &rec_solvables);
-
-                if (rec_solvables.count != 0)
+                Id* wp = pool_whatprovides_ptr(pool, req);
+                if (*wp)
                 {
-                    Solvable* rs = nullptr;
-                    for (int i = 0; i < rec_solvables.count; i++)
+                    Id rs = 0;
+                    for (; *wp; ++wp)
                     {
-                        rs = pool_id2solvable(pool, rec_solvables.elements[i]);
-                        if (rs->name == req)
+                        rs = *wp;
+                        if (pool_id2solvable(pool, rs)->name == req)
                         {
                             break;
                         }
                     }
-                    auto it = visited.find(rs);
-                    if (it == visited.end())
+                    if (visited[rs] == not_visited)
                     {
-                        auto dep_id = dep_graph.add_node(PackageInfo(rs));
+                        auto dep_id = dep_graph.add_node(package_node(pool, rs));
                         dep_graph.add_edge(parent, dep_id);
-                        visited.insert(std::make_pair(rs, dep_id));
-                        walk_graph(dep_graph, dep_id, rs, visited, not_found, depth);
+                        visited[rs] = dep_id;
+                        walk_graph(dep_graph, dep_id, pool, rs, visited, not_found, depth);
                     }
                     else
                     {
-                        dep_graph.add_edge(parent, it->second);
+                        dep_graph.add_edge(parent, visited[rs]);
                     }
                 }
                 else
@@ -83,7 +94,7 @@ namespace mamba
                     if (it == not_found.end())
                     {
                         auto dep_id
-                            = dep_graph.add_node(PackageInfo(concat(name, " >>> NOT FOUND <<<")));
+                            = dep_graph.add_node(package_node(concat(name, " >>> NOT FOUND <<<")));
                         dep_graph.add_edge(parent, dep_id);
                         not_found.insert(std::make_pair(name, dep_id));
                     }
@@ -92,7 +103,6 @@ namespace mamba
                         dep_graph.add_edge(parent, it->second);
                     }
                 }
-                queue_free(&rec_solvables);
                 ++reqp;
                 req = *reqp;
             }
@@ -101,42 +111,90 @@ namespace mamba
 
     void reverse_walk_graph(query_result::dependency_graph& dep_graph,
                             query_result::dependency_graph::node_id parent,
-                            Solvable* s,
-                            std::map<Solvable*, size_t>& visited)
+                            MPool& pool,
+                            Id id,
+                            visited_list& visited)
     {
-        if (s)
+        // figure out who requires `s`
+        Pool* p = pool;
+        for (Id rs : pool.whatrequires(pool_id2solvable(p, id)->name))
         {
-            auto* pool = s->repo->pool;
-            // figure out who requires `s`
-            Queue solvables;
-            queue_init(&solvables);
-
-            pool_whatmatchesdep(pool, SOLVABLE_REQUIRES, s->name, &solvables, -1);
-
-            if (solvables.count != 0)
+            if (visited[rs] == not_visited)
             {
-                Solvable* rs;
-                for (int i = 0; i < solvables.count; i++)
-                {
-                    rs = pool_id2solvable(pool, solvables.elements[i]);
-                    auto it = visited.find(rs);
-                    if (it == visited.end())
-                    {
-                        auto dep_id = dep_graph.add_node(PackageInfo(rs));
-                        dep_graph.add_edge(parent, dep_id);
-                        visited.insert(std::make_pair(rs, dep_id));
-                        reverse_walk_graph(dep_graph, dep_id, rs, visited);
-                    }
-                    else
-                    {
-                        dep_graph.add_edge(parent, it->second);
-                    }
-                }
-                queue_free(&solvables);
+                auto dep_id = dep_graph.add_node(package_node(p, rs));
+                dep_graph.add_edge(parent, dep_id);
+                visited[rs] = dep_id;
+                reverse_walk_graph(dep_graph, dep_id, pool, rs, visited);
+            }
+            else
+            {
+                dep_graph.add_edge(parent, visited[rs]);
             }
         }
     }
 
+    /*******************************
+     * package_node implementation *
+     *******************************/
+
+    package_node::package_node(Pool* pool, Id id)
+        : m_pool(pool)
+        , m_id(id)
+    {
+    }
+
+    package_node::package_node(const std::string& missing_name)
+        : m_info(std::make_shared<const PackageInfo>(missing_name))
+    {
+    }
+
+    Id package_node::id() const
+    {
+        return m_id;
+    }
+
+    std::string package_node::name() const
+    {
+        return m_pool ? pool_id2str(m_pool, solvable()->name) : m_info->name;
+    }
+
+    std::string package_node::version() const
+    {
+        return m_pool ? pool_id2str(m_pool, solvable()->evr) : m_info->version;
+    }
+
+    std::string package_node::field(const std::string& name) const
+    {
+        if (m_pool && name == "name")
+        {
+            return this->name();
+        }
+        else if (m_pool && name == "version")
+        {
+            return version();
+        }
+        else if (m_pool && name == "build_string")
+        {
+            const char* str = solvable_lookup_str(solvable(), SOLVABLE_BUILDFLAVOR);
+            return str ? str : "";
+        }
+        return PackageInfo::get_field_getter(name)(info());
+    }
+
+    const PackageInfo& package_node::info() const
+    {
+        if (!m_info)
+        {
+            m_info = std::make_shared<const PackageInfo>(solvable());
+        }
+        return *m_info;
+    }
+
+    Solvable* package_node::solvable() const
+    {
+        return pool_id2solvable(m_pool, m_id);
+    }
+
     /************************
      * Query implementation *
      ************************/
@@ -220,8 +278,7 @@ namespace mamba
 
         for (int i = 0; i < solvables.count; i++)
         {
-            Solvable* s = pool_id2solvable(m_pool.get(), solvables.elements[i]);
-            g.add_node(PackageInfo(s));
+            g.add_node(package_node(pool, solvables.elements[i]));
         }
 
         queue_free(&job);
@@ -253,21 +310,36 @@ namespace mamba
             selection_solvables(m_pool.get(), &job, &solvables);
             if (solvables.count > 0)
             {
-                Solvable* latest = pool_id2solvable(m_pool.get(), solvables.elements[0]);
-                auto id = g.add_node(PackageInfo(latest));
-                std::map<Solvable*, size_t> visited = { { latest, id } };
-                reverse_walk_graph(g, id, latest, visited);
+                Id latest = solvables.elements[0];
+                auto node = g.add_node(package_node(m_pool.get(), latest));
+                auto visited = make_visited_list(m_pool.get(), latest, node);
+                reverse_walk_graph(g, node, m_pool.get(), latest, visited);
             }
         }
         else
         {
-            pool_whatmatchesdep(m_pool.get(), SOLVABLE_REQUIRES, id, &solvables, -1);
-            for (int i = 0; i < solvables.count; i++)
+            // the solvables with a requirement on the name matching the query
+            Pool* pool = m_pool.get();
+            Id name = id;
+            while (ISRELDEP(name))
             {
-                Solvable* s = pool_id2solvable(m_pool.get(), solvables.elements[i]);
-                g.add_node(PackageInfo(s));
+                name = GETRELDEP(pool, name)->name;
+            }
+            for (Id rs : m_pool.get().whatrequires(name))
+            {
+                Solvable* s = pool_id2solvable(pool, rs);
+                for (Id* reqp = s->repo->idarraydata + s->requires; *reqp; ++reqp)
+                {
+                    if (pool_match_dep(pool, *reqp, id))
+                    {
+                        g.add_node(package_node(pool, rs));
+                        break;
+                    }
+                }
             }
         }
+        queue_free(&job);
+        queue_free(&solvables);
         return query_result(QueryType::Whoneeds, query, std::move(g));
     }
 
@@ -292,14 +364,15 @@ namespace mamba
 
         int depth = tree ? -1 : 1;
 
-        auto find_latest = [&](Queue& solvables) -> Solvable* {
-            Solvable* latest = pool_id2solvable(m_pool.get(), solvables.elements[0]);
+        auto find_latest = [&](Queue& solvables) -> Id {
+            Id latest = solvables.elements[0];
             for (int i = 1; i < solvables.count; ++i)
             {
                 Solvable* s = pool_id2solvable(m_pool.get(), solvables.elements[i]);
-                if (pool_evrcmp(m_pool.get(), s->evr, latest->evr, 0) > 0)
+                Solvable* latest_s = pool_id2solvable(m_pool.get(), latest);
+                if (pool_evrcmp(m_pool.get(), s->evr, latest_s->evr, 0) > 0)
                 {
-                    latest = s;
+                    latest = solvables.elements[i];
                 }
             }
             return latest;
@@ -307,11 +380,11 @@ namespace mamba
 
         if (solvables.count > 0)
         {
-            Solvable* latest = find_latest(solvables);
-            auto id = g.add_node(PackageInfo(latest));
-            std::map<Solvable*, size_t> visited = { { latest, id } };
+            Id latest = find_latest(solvables);
+            auto node = g.add_node(package_node(m_pool.get(), latest));
+            auto visited = make_visited_list(m_pool.get(), latest, node);
             std::map<std::string, size_t> not_found;
-            walk_graph(g, id, latest, visited, not_found, depth);
+            walk_graph(g, node, m_pool.get(), latest, visited, not_found, depth);
         }
 
         queue_free(&job);
@@ -336,46 +409,6 @@ namespace mamba
         reset_pkg_view_list();
     }
 
-    query_result::query_result(const query_result& rhs)
-        : m_type(rhs.m_type)
-        , m_query(rhs.m_query)
-        , m_dep_graph(rhs.m_dep_graph)
-        , m_pkg_view_list()
-        , m_ordered_pkg_list()
-    {
-        using std::swap;
-        auto offset_lbd = [&rhs, this](auto iter) {
-            return m_dep_graph.get_node_list().begin()
-                   + (iter - rhs.m_dep_graph.get_node_list().begin());
-        };
-
-        package_view_list tmp(rhs.m_pkg_view_list.size());
-        std::transform(
-            rhs.m_pkg_view_list.begin(), rhs.m_pkg_view_list.end(), tmp.begin(), offset_lbd);
-        swap(tmp, m_pkg_view_list);
-
-        if (!rhs.m_ordered_pkg_list.empty())
-        {
-            auto tmp(rhs.m_ordered_pkg_list);
-            std::for_each(tmp.begin(), tmp.end(), [offset_lbd](auto& entry) {
-                std::transform(
-                    entry.second.begin(), entry.second.end(), entry.second.begin(), offset_lbd);
-            });
-            swap(m_ordered_pkg_list, tmp);
-        }
-    }
-
-    query_result& query_result::operator=(const query_result& rhs)
-    {
-        if (this != &rhs)
-        {
-            using std::swap;
-            query_result tmp(rhs);
-            swap(*this, tmp);
-        }
-        return *this;
-    }
-
     QueryType query_result::query_type() const
     {
         return m_type;
@@ -388,22 +421,25 @@ namespace mamba
 
     query_result& query_result::sort(std::string field)
     {
-        auto fun = PackageInfo::less(field);
+        // the field of each node is only computed once
+        std::vector<std::string> keys;
+        keys.reserve(m_dep_graph.get_node_list().size());
+        for (const auto& node : m_dep_graph.get_node_list())
+        {
+            keys.push_back(node.field(field));
+        }
+        auto less = [&keys](auto lhs, auto rhs) { return keys[lhs] < keys[rhs]; };
 
         if (!m_ordered_pkg_list.empty())
         {
             for (auto& entry : m_ordered_pkg_list)
             {
-                std::sort(entry.second.begin(),
-                          entry.second.end(),
-                          [fun](const auto& lhs, const auto& rhs) { return fun(*lhs, *rhs); });
+                std::sort(entry.second.begin(), entry.second.end(), less);
             }
         }
         else
         {
-            std::sort(m_pkg_view_list.begin(),
-                      m_pkg_view_list.end(),
-                      [fun](const auto& lhs, const auto& rhs) { return fun(*lhs, *rhs); });
+            std::sort(m_pkg_view_list.begin(), m_pkg_view_list.end(), less);
         }
 
         return *this;
@@ -411,12 +447,11 @@ namespace mamba
 
     query_result& query_result::groupby(std::string field)
     {
-        auto fun = PackageInfo::get_field_getter(field);
         if (m_ordered_pkg_list.empty())
         {
-            for (auto& pkg : m_pkg_view_list)
+            for (auto pkg : m_pkg_view_list)
             {
-                m_ordered_pkg_list[fun(*pkg)].push_back(pkg);
+                m_ordered_pkg_list[m_dep_graph.get_node(pkg).field(field)].push_back(pkg);
             }
         }
         else
@@ -424,9 +459,9 @@ namespace mamba
             ordered_package_list tmp;
             for (auto& entry : m_ordered_pkg_list)
             {
-                for (auto& pkg : entry.second)
+                for (auto pkg : entry.second)
                 {
-                    std::string key = entry.first + '/' + fun(*pkg);
+                    std::string key = entry.first + '/' + m_dep_graph.get_node(pkg).field(field);
                     tmp[key].push_back(pkg);
                 }
             }
@@ -473,31 +508,32 @@ namespace mamba
             }
         }
 
-        auto format_row = [&](auto& pkg) {
+        auto format_row = [&](auto pkg) {
+            const package_node& node = m_dep_graph.get_node(pkg);
             std::vector<mamba::printers::FormattedString> row;
             for (std::size_t i = 0; i < cmds.size(); ++i)
             {
                 const auto& cmd = cmds[i];
                 if (cmd == "Name")
                 {
-                    row.push_back(pkg->name);
+                    row.push_back(node.name());
                 }
                 else if (cmd == "Version")
                 {
-                    row.push_back(pkg->version);
+                    row.push_back(node.version());
                 }
                 else if (cmd == "Build")
                 {
-                    row.push_back(pkg->build_string);
+                    row.push_back(node.field("build_string"));
                 }
                 else if (cmd == "Channel")
                 {
-                    row.push_back(cut_repo_name(pkg->channel));
+                    row.push_back(cut_repo_name(node.info().channel));
                 }
                 else if (cmd == "Depends")
                 {
                     std::string depends_qualifier;
-                    for (const auto& dep : pkg->depends)
+                    for (const auto& dep : node.info().depends)
                     {
                         if (starts_with(dep, args[i]))
                         {
@@ -517,7 +553,7 @@ namespace mamba
         {
             for (auto& entry : m_ordered_pkg_list)
             {
-                for (auto& pkg : entry.second)
+                for (auto pkg : entry.second)
                 {
                     printer.add_row(format_row(pkg));
                 }
@@ -525,7 +561,7 @@ namespace mamba
         }
         else
         {
-            for (const auto& pkg : m_pkg_view_list)
+            for (auto pkg : m_pkg_view_list)
             {
                 printer.add_row(format_row(pkg));
             }
@@ -548,7 +584,7 @@ namespace mamba
         void start_node(node_id node, const graph_type& g)
         {
             print_prefix(node);
-            m_out << get_package_repr(g.get_node_list()[node]) << '\n';
+            m_out << get_package_repr(g.get_node(node)) << '\n';
             if (node == 0u)
             {
                 m_prefix_stack.push_back("  ");
@@ -586,7 +622,7 @@ namespace mamba
         void forward_or_cross_edge(node_id, node_id to, const graph_type& g)
         {
             print_prefix(to);
-            m_out << concat("\033[2m", g.get_node_list()[to].name, " already visited", "\033[00m")
+            m_out << concat("\033[2m", g.get_node(to).name(), " already visited", "\033[00m")
                   << '\n';
         }
 
@@ -616,9 +652,10 @@ namespace mamba
             }
         }
 
-        std::string get_package_repr(const PackageInfo& pkg) const
+        std::string get_package_repr(const package_node& pkg) const
         {
-            return pkg.version.empty() ? pkg.name : pkg.name + '[' + pkg.version + ']';
+            std::string version = pkg.version();
+            return version.empty() ? pkg.name() : pkg.name() + '[' + version + ']';
         }
 
         std::stack<node_id> m_last_stack;
@@ -641,9 +678,11 @@ namespace mamba
             out << m_query << '\n';
             for (size_t i = 0; i < m_pkg_view_list.size() - 1; ++i)
             {
-                out << "  ├─ " << get_package_repr(*m_pkg_view_list[i]) << '\n';
+                out << "  ├─ " << get_package_repr(m_dep_graph.get_node(m_pkg_view_list[i]))
+                    << '\n';
             }
-            out << "  └─ " << get_package_repr(*m_pkg_view_list.back()) << '\n';
+            out << "  └─ " << get_package_repr(m_dep_graph.get_node(m_pkg_view_list.back()))
+                << '\n';
         }
 
         return out;
@@ -653,9 +692,10 @@ namespace mamba
     {
         if (!m_pkg_view_list.empty())
         {
-            for (const auto& pkg : m_pkg_view_list)
+            for (auto pkg : m_pkg_view_list)
             {
-                print_solvable(pkg);
+                const PackageInfo* info = &m_dep_graph.get_node(pkg).info();
+                print_solvable(info);
             }
         }
         return out;
@@ -676,14 +716,14 @@ namespace mamba
         j["result"]["pkgs"] = nlohmann::json::array();
         for (size_t i = 0; i < m_pkg_view_list.size(); ++i)
         {
-            j["result"]["pkgs"].push_back(m_pkg_view_list[i]->json());
+            j["result"]["pkgs"].push_back(m_dep_graph.get_node(m_pkg_view_list[i]).info().json());
         }
 
         if (m_type != QueryType::Search && !m_pkg_view_list.empty())
         {
             bool has_root = !m_dep_graph.get_edge_list(0).empty();
             j["result"]["graph_roots"] = nlohmann::json::array();
-            j["result"]["graph_roots"].push_back(has_root ? m_dep_graph.get_node_list()[0].json()
+            j["result"]["graph_roots"].push_back(has_root ? m_dep_graph.get_node(0).info().json()
                                                           : nl::json(m_query));
         }
         return j;
@@ -691,12 +731,13 @@ namespace mamba
 
     void query_result::reset_pkg_view_list()
     {
-        auto it = m_dep_graph.get_node_list().begin();
-        std::generate(m_pkg_view_list.begin(), m_pkg_view_list.end(), [&it]() { return it++; });
+        m_pkg_view_list.resize(m_dep_graph.get_node_list().size());
+        std::iota(m_pkg_view_list.begin(), m_pkg_view_list.end(), dependency_graph::node_id(0));
     }
 
-    std::string query_result::get_package_repr(const PackageInfo& pkg) const
+    std::string query_result::get_package_repr(const package_node& pkg) const
     {
-        return pkg.version.empty() ? pkg.name : pkg.name + '[' + pkg.version + ']';
+        std::string version = pkg.version();
+        return version.empty() ? pkg.name() : pkg.name() + '[' + version + ']';
     }
 }  // namespace mamba
@@ -0,0 +1,421 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "nlohmann/json.hpp"
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/context.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/query.hpp"
+#include "mamba/core/query_server.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/subdirdata.hpp"
+#include "mamba/core/thread_utils.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    struct QueryServer::ChannelPool
+    {
+        MPool pool;
+        std::vector<MRepo> repos;
+        std::vector<std::string> repodata;
+        std::unique_ptr<Query> query;
+    };
+
+    namespace
+    {
+        struct LoadedSubdir
+        {
+            std::shared_ptr<MSubdirData> subdir;
+            fs::path json_file;
+            std::pair<int, int> priority;
+        };
+
+        // the header of the cache file holds the ETag and the modification date
+        // written after a download, it changes along with the repodata
+        std::string repodata_identity(const fs::path& json_file)
+        {
+            std::ifstream in(json_file, std::ios::binary);
+            std::string header(1024, '\0');
+            in.read(&header[0], header.size());
+            header.resize(static_cast<std::size_t>(in.gcount()));
+            std::error_code ec;
+            return concat(std::to_string(fs::file_size(json_file, ec)), " ", header);
+        }
+
+        // what install_specs does to load the repodata of the channels, using
+        // the cache while it is valid
+        std::vector<LoadedSubdir> load_subdirs(const std::vector<std::string>& channels)
+        {
+            auto& ctx = Context::instance();
+            fs::path cache_dir = create_cache_dir();
+
+            std::vector<LoadedSubdir> subdirs;
+            MultiDownloadTarget multi_dl;
+            std::unique_ptr<LockFile> subdir_download_lock;
+            if (!ctx.offline)
+            {
+                subdir_download_lock = std::make_unique<LockFile>(cache_dir / "mamba.lock");
+            }
+
+            int max_prio = static_cast<int>(channels.size());
+            std::string prev_channel_name;
+            for (auto channel : get_channels(channels))
+            {
+                for (auto& [platform, url] : channel->platform_urls(true))
+                {
+                    std::string repodata_full_url = concat(url, "/repodata.json");
+                    fs::path json_file = cache_dir / cache_fn_url(repodata_full_url);
+                    auto sdir
+                        = std::make_shared<MSubdirData>(concat(channel->name(), "/", platform),
+                                                        repodata_full_url,
+                                                        json_file,
+                                                        platform == "noarch");
+                    sdir->load();
+                    multi_dl.add(sdir->target());
+
+                    std::pair<int, int> priority;
+                    if (ctx.channel_priority == ChannelPriority::kDisabled)
+                    {
+                        priority = std::make_pair(0, max_prio--);
+                    }
+                    else
+                    {
+                        if (channel->name() != prev_channel_name)
+                        {
+                            max_prio--;
+                            prev_channel_name = channel->name();
+                        }
+                        priority = std::make_pair(max_prio, platform == "noarch" ? 0 : 1);
+                    }
+                    subdirs.push_back({ sdir, json_file, priority });
+                }
+            }
+            if (!ctx.offline)
+            {
+                multi_dl.download(true);
+            }
+            return subdirs;
+        }
+
+        nlohmann::json error(const std::string& msg)
+        {
+            return { { "result", { { "msg", msg }, { "status", "ERROR" } } } };
+        }
+    }
+
+    QueryServer::QueryServer()
+    {
+    }
+
+    QueryServer::~QueryServer()
+    {
+    }
+
+    QueryServer::ChannelPool& QueryServer::channel_pool(const std::vector<std::string>& channels)
+    {
+        auto it = m_pools.find(channels);
+        if (it == m_pools.end())
+        {
+            load_pool(channels);
+            it = m_pools.find(channels);
+        }
+        return *it->second;
+    }
+
+    void QueryServer::load_pool(const std::vector<std::string>& channels)
+    {
+        auto subdirs = load_subdirs(channels);
+        std::vector<std::string> repodata;
+        for (auto& loaded : subdirs)
+        {
+            repodata.push_back(loaded.subdir->loaded() ? repodata_identity(loaded.json_file)
+                                                       : std::string());
+        }
+
+        auto it = m_pools.find(channels);
+        if (it != m_pools.end() && it->second->repodata == repodata)
+        {
+            return;
+        }
+
+        // the current pool is kept until the new one is complete, if ever
+        LOG_INFO << "Loading the pool of " << join(", ", channels);
+        auto res = std::make_unique<ChannelPool>();
+        for (auto& loaded : subdirs)
+        {
+            if (!loaded.subdir->loaded())
+            {
+                LOG_WARNING << "Subdir " << loaded.subdir->name() << " not loaded";
+                continue;
+            }
+            MRepo repo = loaded.subdir->create_repo(res->pool);
+            repo.set_priority(loaded.priority.first, loaded.priority.second);
+            res->repos.push_back(repo);
+        }
+        res->repodata = std::move(repodata);
+        res->query = std::make_unique<Query>(res->pool);
+        m_pools[channels] = std::move(res);
+    }
+
+    std::string QueryServer::handle(const std::string& request)
+    {
+        try
+        {
+            auto j = nlohmann::json::parse(request);
+            std::string type = j.value("type", "");
+            if (type == "shutdown")
+            {
+                m_shutdown = true;
+                return nlohmann::json({ { "result", { { "status", "OK" } } } }).dump();
+            }
+            if (type == "reload")
+            {
+                for (auto& [channels, channel_pool] : m_pools)
+                {
+                    load_pool(channels);
+                }
+                return nlohmann::json({ { "result", { { "status", "OK" } } } }).dump();
+            }
+            if (type != "find" && type != "whoneeds" && type != "depends")
+            {
+                return error(concat("Unknown request type '", type, "'")).dump();
+            }
+
+            std::string query = j.at("query").get<std::string>();
+            bool tree = j.value("tree", false);
+            auto channels = j.value("channels", Context::instance().channels);
+
+            Query& q = *channel_pool(channels).query;
+            if (type == "find")
+            {
+                return q.find(query).json().dump();
+            }
+            else if (type == "whoneeds")
+            {
+                return q.whoneeds(query, tree).json().dump();
+            }
+            return q.depends(query, tree).json().dump();
+        }
+        catch (const std::exception& e)
+        {
+            return error(e.what()).dump();
+        }
+    }
+
+    std::size_t QueryServer::pool_count() const
+    {
+        return m_pools.size();
+    }
+
+#ifndef _WIN32
+    namespace
+    {
+        // a request without end of line longer than that closes the client
+        constexpr std::size_t MAX_REQUEST_SIZE = 1 << 20;
+
+        struct Client
+        {
+            int fd;
+            std::string buffer;
+            std::chrono::steady_clock::time_point last_activity;
+        };
+
+        bool send_all(int fd, const std::string& data)
+        {
+            std::size_t sent = 0;
+            while (sent < data.size())
+            {
+                ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    return false;
+                }
+                sent += static_cast<std::size_t>(n);
+            }
+            return true;
+        }
+    }
+
+    void QueryServer::serve(const fs::path& socket_path, std::chrono::milliseconds idle_timeout)
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::string path = socket_path.string();
+        if (path.size() >= sizeof(addr.sun_path))
+        {
+            throw std::runtime_error("Socket path is too long: " + path);
+        }
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+        // the pool of the configured channels is ready for the first request
+        try
+        {
+            channel_pool(Context::instance().channels);
+        }
+        catch (const std::exception& e)
+        {
+            LOG_WARNING << "Could not load the pool of the configured channels: " << e.what();
+        }
+
+        int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0)
+        {
+            throw std::runtime_error(std::string("Could not create socket: ")
+                                     + std::strerror(errno));
+        }
+
+        // a socket left by a previous server, anything else is kept
+        struct stat st;
+        if (::lstat(path.c_str(), &st) == 0)
+        {
+            if (!S_ISSOCK(st.st_mode))
+            {
+                ::close(server);
+                throw std::runtime_error(concat("Not a socket, not replaced: ", path));
+            }
+            fs::remove(socket_path);
+        }
+        // only the user can connect
+        mode_t old_mask = ::umask(0077);
+        int res = ::bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        ::umask(old_mask);
+        if (res < 0 || ::listen(server, 16) < 0)
+        {
+            std::string msg = std::strerror(errno);
+            ::close(server);
+            throw std::runtime_error(concat("Could not listen on ", path, ": ", msg));
+        }
+        LOG_INFO << "Serving queries on " << path;
+
+        // a client not reading its answers is closed as an idle one
+        timeval send_timeout{};
+        send_timeout.tv_sec = static_cast<time_t>(idle_timeout.count() / 1000);
+        send_timeout.tv_usec = static_cast<suseconds_t>(idle_timeout.count() % 1000 * 1000);
+
+        // the server, then the clients, polled every 500 ms for interruptions
+        std::vector<Client> clients;
+        std::vector<pollfd> fds;
+        m_shutdown = false;
+        while (!m_shutdown && !is_sig_interrupted())
+        {
+            fds.assign(1, pollfd{ server, POLLIN, 0 });
+            for (const auto& client : clients)
+            {
+                fds.push_back(pollfd{ client.fd, POLLIN, 0 });
+            }
+            if (::poll(fds.data(), fds.size(), 500) < 0 && errno != EINTR)
+            {
+                break;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            // the pollfd of a client follows the order of the clients
+            std::vector<bool> closed(clients.size(), false);
+            for (std::size_t i = 0; i < clients.size() && !m_shutdown; ++i)
+            {
+                Client& client = clients[i];
+                if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+                {
+                    closed[i] = now - client.last_activity > idle_timeout;
+                    if (closed[i])
+                    {
+                        LOG_INFO << "Closing idle query client";
+                    }
+                    continue;
+                }
+
+                char chunk[4096];
+                ssize_t n = ::recv(client.fd, chunk, sizeof(chunk), 0);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    closed[i] = true;
+                    continue;
+                }
+                client.buffer.append(chunk, static_cast<std::size_t>(n));
+                client.last_activity = now;
+
+                std::size_t end;
+                while (!closed[i] && (end = client.buffer.find('\n')) != std::string::npos)
+                {
+                    std::string request = client.buffer.substr(0, end);
+                    client.buffer.erase(0, end + 1);
+                    closed[i] = !send_all(client.fd, handle(request) + "\n");
+                }
+                if (client.buffer.size() > MAX_REQUEST_SIZE)
+                {
+                    LOG_WARNING << "Query request too long, closing the client";
+                    closed[i] = true;
+                }
+                // answering may take long, not counted as idle time
+                client.last_activity = std::chrono::steady_clock::now();
+            }
+
+            std::size_t kept = 0;
+            for (std::size_t i = 0; i < clients.size(); ++i)
+            {
+                if (closed[i])
+                {
+                    ::close(clients[i].fd);
+                }
+                else
+                {
+                    clients[kept++] = std::move(clients[i]);
+                }
+            }
+            clients.resize(kept);
+
+            if (!m_shutdown && (fds[0].revents & POLLIN))
+            {
+                int fd = ::accept(server, nullptr, nullptr);
+                if (fd >= 0)
+                {
+                    ::setsockopt(
+                        fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+                    clients.push_back({ fd, std::string(), std::chrono::steady_clock::now() });
+                }
+            }
+        }
+
+        for (const auto& client : clients)
+        {
+            ::close(client.fd);
+        }
+        ::close(server);
+        fs::remove(socket_path);
+    }
+#else
+    void QueryServer::serve(const fs::path&, std::chrono::milliseconds)
+    {
+        throw std::runtime_error("The query server needs Unix sockets, not available on Windows");
+    }
+#endif
+}  // namespace mamba
@@ -5,8 +5,10 @@
 // The full license is in the file LICENSE, distributed with this software.
 
 #include "mamba/core/repo.hpp"
+#include "mamba/core/channel.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_info.hpp"
+#include "mamba/core/trace.hpp"
 
 extern "C"
 {
@@ -19,6 +21,29 @@ extern "C"
 
 namespace mamba
 {
+    namespace
+    {
+        // Adds the time spent in its scope to the loading time of the pool
+        class LoadingTimer
+        {
+        public:
+            explicit LoadingTimer(MPool& pool)
+                : m_pool(pool)
+                , m_start(std::chrono::steady_clock::now())
+            {
+            }
+
+            ~LoadingTimer()
+            {
+                m_pool.add_loading_time(std::chrono::steady_clock::now() - m_start);
+            }
+
+        private:
+            MPool& m_pool;
+            std::chrono::steady_clock::time_point m_start;
+        };
+    }
+
     const char* mamba_tool_version()
     {
         const size_t bufferSize = 30;
@@ -33,9 +58,12 @@ namespace mamba
                  const fs::path& index,
                  const RepoMetadata& metadata)
         : m_metadata(metadata)
+        , m_pool(&pool)
     {
+        LoadingTimer timer(pool);
         m_url = rsplit(metadata.url, "/", 1)[0];
         m_repo = repo_create(pool, m_url.c_str());
+        pool.add_repo_channel(m_repo, make_channel(m_url));
         read_file(index);
     }
 
@@ -44,13 +72,18 @@ namespace mamba
                  const std::string& index,
                  const std::string& url)
         : m_url(url)
+        , m_pool(&pool)
     {
+        LoadingTimer timer(pool);
         m_repo = repo_create(pool, name.c_str());
+        pool.add_repo_channel(m_repo, make_channel(name));
         read_file(index);
     }
 
     MRepo::MRepo(MPool& pool, const PrefixData& prefix_data)
+        : m_pool(&pool)
     {
+        LoadingTimer timer(pool);
         m_repo = repo_create(pool, "installed");
         int flags = 0;
         Repodata* data;
@@ -165,6 +198,12 @@ namespace mamba
 
     bool MRepo::read_file(const std::string& filename)
     {
+        TraceSpan span("repodata", "MRepo::read_file");
+        if (span.active())
+        {
+            std::error_code ec;
+            span.arg("file", filename).arg("size", fs::file_size(filename, ec));
+        }
         LOG_INFO << m_repo->name << ": reading repo file " << filename;
 
         bool is_solv = ends_with(filename, ".solv");
@@ -346,6 +385,7 @@ namespace mamba
 
     bool MRepo::clear(bool reuse_ids = 1)
     {
+        m_pool->remove_repo_channel(m_repo);
         repo_free(m_repo, static_cast<int>(reuse_ids));
         m_repo = nullptr;
         return true;
@@ -0,0 +1,225 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+
+#include <openssl/sha.h>
+
+#include "nlohmann/json.hpp"
+
+#include "mamba/core/output.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/solution_cache.hpp"
+#include "mamba/core/util.hpp"
+
+extern "C"
+{
+#include "solv/repo.h"
+#include "solv/solver.h"
+}
+
+namespace mamba
+{
+    namespace
+    {
+        const char* str_or_empty(const char* str)
+        {
+            return str ? str : "";
+        }
+
+        std::string solvable_location(Solvable* s)
+        {
+            return str_or_empty(solvable_lookup_location(s, nullptr));
+        }
+
+        std::string repo_name(Solvable* s)
+        {
+            return s->repo ? str_or_empty(s->repo->name) : "";
+        }
+
+        void add_repo_identity(std::string& key, Pool* pool, Repo* repo)
+        {
+            key += concat("repo ",
+                          str_or_empty(repo->name),
+                          " ",
+                          std::to_string(repo->priority),
+                          " ",
+                          std::to_string(repo->subpriority),
+                          " ",
+                          std::to_string(repo->nsolvables),
+                          "\n");
+
+            // written by MRepo with the repodata of a channel
+            Id etag_id = pool_str2id(pool, "mamba:etag", 1);
+            Id mod_id = pool_str2id(pool, "mamba:mod", 1);
+            Id pip_added_id = pool_str2id(pool, "mamba:pip_added", 1);
+            std::string etag = str_or_empty(repo_lookup_str(repo, SOLVID_META, etag_id));
+            std::string mod = str_or_empty(repo_lookup_str(repo, SOLVID_META, mod_id));
+            if (repo != pool->installed && (!etag.empty() || !mod.empty()))
+            {
+                key += concat(etag,
+                              " ",
+                              mod,
+                              " ",
+                              std::to_string(repo_lookup_num(repo, SOLVID_META, pip_added_id, 0)),
+                              "\n");
+                return;
+            }
+
+            // installed packages or repodata without cache headers
+            std::vector<std::string> solvables;
+            Id p;
+            Solvable* s;
+            FOR_REPO_SOLVABLES(repo, p, s)
+            {
+                Id checksum_type = 0;
+                solvables.push_back(
+                    concat(pool_id2str(pool, s->name),
+                           " ",
+                           pool_id2str(pool, s->evr),
+                           " ",
+                           str_or_empty(solvable_lookup_str(s, SOLVABLE_BUILDFLAVOR)),
+                           " ",
+                           solvable_location(s),
+                           " ",
+                           str_or_empty(
+                               solvable_lookup_checksum(s, SOLVABLE_CHECKSUM, &checksum_type)),
+                           "\n"));
+            }
+            std::sort(solvables.begin(), solvables.end());
+            for (const auto& str : solvables)
+            {
+                key += str;
+            }
+        }
+    }
+
+    SolutionCache::SolutionCache(const fs::path& cache_dir)
+        : m_cache_dir(cache_dir)
+    {
+    }
+
+    std::string SolutionCache::key(Pool* pool,
+                                   const Queue& jobs,
+                                   const std::vector<std::pair<int, int>>& flags)
+    {
+        std::string key = concat("tool ", mamba_tool_version(), "\n");
+
+        Id repo_id;
+        Repo* repo;
+        FOR_REPOS(repo_id, repo)
+        {
+            add_repo_identity(key, pool, repo);
+        }
+
+        for (const auto& [flag, value] : flags)
+        {
+            key += concat("flag ", std::to_string(flag), " ", std::to_string(value), "\n");
+        }
+
+        for (int i = 0; i + 1 < jobs.count; i += 2)
+        {
+            key += concat(
+                "job ", pool_job2str(pool, jobs.elements[i], jobs.elements[i + 1], 0), "\n");
+        }
+
+        std::array<unsigned char, SHA256_DIGEST_LENGTH> hash;
+        SHA256(reinterpret_cast<const unsigned char*>(key.data()), key.size(), hash.data());
+        return hex_string(hash);
+    }
+
+    fs::path SolutionCache::path(const std::string& key) const
+    {
+        return m_cache_dir / (key + ".json");
+    }
+
+    bool SolutionCache::load(const std::string& key, Pool* pool, std::vector<Id>& solution) const
+    {
+        fs::path file = path(key);
+        if (!fs::exists(file))
+        {
+            return false;
+        }
+
+        nlohmann::json j;
+        try
+        {
+            std::ifstream in(file);
+            in >> j;
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+            LOG_WARNING << "Could not read cached solution " << file << ": " << e.what();
+            return false;
+        }
+
+        std::vector<Id> res;
+        for (const auto& pkg : j.value("packages", nlohmann::json::array()))
+        {
+            std::string name = pkg.value("name", "");
+            std::string repo = pkg.value("repo", "");
+            std::string location = pkg.value("location", "");
+
+            // the solvables of a package with this name
+            Id name_id = pool_str2id(pool, name.c_str(), 0);
+            Id found = 0;
+            for (Id* wp = name_id ? pool_whatprovides_ptr(pool, name_id) : nullptr; wp && *wp;
+                 ++wp)
+            {
+                Solvable* s = pool_id2solvable(pool, *wp);
+                if (s->name == name_id && repo_name(s) == repo && solvable_location(s) == location)
+                {
+                    found = *wp;
+                    break;
+                }
+            }
+            if (!found)
+            {
+                LOG_INFO << "Cached solution " << key << " not valid anymore, " << repo << "/"
+                         << location << " is missing";
+                return false;
+            }
+            res.push_back(found);
+        }
+
+        solution = std::move(res);
+        return true;
+    }
+
+    void SolutionCache::store(const std::string& key,
+                              Pool* pool,
+                              const std::vector<Id>& solution) const
+    {
+        nlohmann::json packages = nlohmann::json::array();
+        for (Id p : solution)
+        {
+            Solvable* s = pool_id2solvable(pool, p);
+            packages.push_back({ { "name", pool_id2str(pool, s->name) },
+                                 { "repo", repo_name(s) },
+                                 { "location", solvable_location(s) } });
+        }
+        nlohmann::json j = { { "version", 1 }, { "packages", packages } };
+
+        try
+        {
+            fs::create_directories(m_cache_dir);
+            fs::path file = path(key);
+            fs::path tmp = file;
+            tmp += ".tmp";
+            {
+                std::ofstream out(tmp);
+                out << j.dump();
+            }
+            fs::rename(tmp, file);
+        }
+        catch (const fs::filesystem_error& e)
+        {
+            LOG_WARNING << "Could not cache the solution: " << e.what();
+        }
+    }
+}  // namespace mamba
@@ -4,14 +4,137 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
+
 #include "mamba/core/solver.hpp"
 #include "mamba/core/channel.hpp"
+#include "mamba/core/context.hpp"
+#include "mamba/core/metrics.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_info.hpp"
+#include "mamba/core/solution_cache.hpp"
+#include "mamba/core/subdirdata.hpp"
+#include "mamba/core/trace.hpp"
 #include "mamba/core/util.hpp"
 
 namespace mamba
 {
+    namespace
+    {
+        double milliseconds_since(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                             - start)
+                .count();
+        }
+
+        // The time spent creating the rules is only reported in the statistics
+        // printed by libsolv, they are read through a debug callback installed
+        // for the scope of the timer. The debug settings of the pool are
+        // restored afterwards and its messages still go to the previous callback.
+        class RuleTimer
+        {
+        public:
+            explicit RuleTimer(Pool* pool)
+                : m_pool(pool)
+                , m_debugmask(pool->debugmask)
+                , m_callback(pool->debugcallback)
+                , m_callback_data(pool->debugcallbackdata)
+            {
+                pool_setdebugcallback(pool, &RuleTimer::collect, this);
+                pool->debugmask |= SOLV_DEBUG_STATS;
+            }
+
+            ~RuleTimer()
+            {
+                pool_setdebugcallback(m_pool, m_callback, m_callback_data);
+                m_pool->debugmask = m_debugmask;
+            }
+
+            RuleTimer(const RuleTimer&) = delete;
+            RuleTimer& operator=(const RuleTimer&) = delete;
+
+            int milliseconds() const
+            {
+                return m_milliseconds;
+            }
+
+        private:
+            static void collect(Pool* pool, void* data, int type, const char* str)
+            {
+                auto* self = static_cast<RuleTimer*>(data);
+
+                // e.g. "pkg rule creation took 12 ms", "choice rule creation took 0 ms"
+                const char* rule_creation = std::strstr(str, "rule creation took ");
+                int ms;
+                if (rule_creation
+                    && std::sscanf(rule_creation, "rule creation took %d ms", &ms) == 1)
+                {
+                    self->m_milliseconds += ms;
+                }
+
+                if (!(type & self->m_debugmask) && !(type & (SOLV_FATAL | SOLV_ERROR)))
+                {
+                    return;
+                }
+                if (self->m_callback)
+                {
+                    self->m_callback(pool, self->m_callback_data, type, str);
+                }
+                else
+                {
+                    // what libsolv prints without a debug callback
+                    std::fputs(str, stderr);
+                }
+            }
+
+            Pool* m_pool;
+            int m_debugmask;
+            void (*m_callback)(Pool*, void*, int, const char*);
+            void* m_callback_data;
+            int m_milliseconds = 0;
+        };
+
+        // The rules are numbered from 1 by class, the learnt ones come last
+        void count_rules(Solver* solver, int& rules, int& learnt_rules)
+        {
+            rules = learnt_rules = 0;
+            for (Id rid = 1;; ++rid)
+            {
+                SolverRuleinfo rule_class = solver_ruleclass(solver, rid);
+                if (rule_class == SOLVER_RULE_UNKNOWN)
+                {
+                    break;
+                }
+                ++rules;
+                if (rule_class == SOLVER_RULE_LEARNT)
+                {
+                    ++learnt_rules;
+                }
+            }
+        }
+    }
+
+    nlohmann::json SolverStats::to_json() const
+    {
+        return { { "pool_creation_ms", pool_creation },
+                 { "whatprovides_ms", whatprovides },
+                 { "rule_generation_ms", rule_generation },
+                 { "solving_ms", solving },
+                 { "transaction_ordering_ms", transaction_ordering },
+                 { "solvables", solvables },
+                 { "pruned_solvables", pruned_solvables },
+                 { "rules", rules },
+                 { "learnt_rules", learnt_rules },
+                 { "decisions", decisions } };
+    }
+
     MSolver::MSolver(MPool& pool,
                      const std::vector<std::pair<int, int>>& flags,
                      const PrefixData* prefix_data)
@@ -19,10 +142,18 @@ namespace mamba
         , m_is_solved(false)
         , m_solver(nullptr)
         , m_pool(pool)
+        , m_mpool(pool)
         , m_prefix_data(prefix_data)
     {
         queue_init(&m_jobs);
+
+        m_stats.pool_creation
+            = std::chrono::duration<double, std::milli>(pool.loading_time()).count();
+        auto start = std::chrono::steady_clock::now();
         pool_createwhatprovides(pool);
+        m_stats.whatprovides = milliseconds_since(start);
+        m_stats.solvables = m_pool->nsolvables;
+        m_stats.pruned_solvables = pool.pruned_solvables();
     }
 
     MSolver::~MSolver()
@@ -34,22 +165,40 @@ namespace mamba
         }
     }
 
-    inline bool channel_match(Solvable* s, const std::string& channel)
+    std::set<Repo*> MSolver::channel_repos(const std::string& channel)
     {
-        // TODO this could should be a lot better.
         // TODO this might match too much (e.g. bioconda would also match
-        // bioconda-experimental etc) Note: s->repo->name is the URL of the repo
-        // TODO maybe better to check all repos, select pointers, and compare the
-        // pointer (s->repo == ptr?)
-        const Channel& chan = make_channel(s->repo->name);
-        for (const auto& url : chan.urls(false))
+        // bioconda-experimental etc)
+        // The channels of the repos are resolved once by the pool, each distinct
+        // channel is then compared once with the URLs instead of each solvable.
+        Pool* pool = m_pool;
+        std::map<const Channel*, bool> channel_matches;
+        std::set<Repo*> res;
+        Id repo_id;
+        Repo* repo;
+        FOR_REPOS(repo_id, repo)
         {
-            if (url.find(channel) != std::string::npos)
+            const Channel* chan = m_mpool.repo_channel(repo);
+            auto it = channel_matches.find(chan);
+            if (it == channel_matches.end())
             {
-                return true;
+                bool match = false;
+                for (const auto& url : chan->urls(false))
+                {
+                    if (url.find(channel) != std::string::npos)
+                    {
+                        match = true;
+                        break;
+                    }
+                }
+                it = channel_matches.emplace(chan, match).first;
+            }
+            if (it->second)
+            {
+                res.insert(repo);
             }
         }
-        return false;
+        return res;
     }
 
     void MSolver::add_channel_specific_job(const MatchSpec& ms, int job_flag)
@@ -61,9 +210,10 @@ namespace mamba
         // conda_build_form does **NOT** contain the channel info
         Id match = pool_conda_matchspec(pool, ms.conda_build_form().c_str());
 
+        std::set<Repo*> repos = channel_repos(ms.channel);
         for (Id* wp = pool_whatprovides_ptr(pool, match); *wp; wp++)
         {
-            if (channel_match(pool_id2solvable(pool, *wp), ms.channel))
+            if (repos.count(pool_id2solvable(pool, *wp)->repo))
             {
                 queue_push(&selected_pkgs, *wp);
             }
@@ -240,12 +390,18 @@ namespace mamba
 
         Id match = pool_conda_matchspec(pool, ms.conda_build_form().c_str());
 
+        std::set<Repo*> repos;
+        if (!ms.channel.empty())
+        {
+            repos = channel_repos(ms.channel);
+        }
+
         std::set<Id> matching_solvables;
         for (Id* wp = pool_whatprovides_ptr(pool, match); *wp; wp++)
         {
             if (!ms.channel.empty())
             {
-                if (!channel_match(pool_id2solvable(pool, *wp), ms.channel))
+                if (!repos.count(pool_id2solvable(pool, *wp)->repo))
                 {
                     continue;
                 }
@@ -347,20 +503,145 @@ namespace mamba
 
     bool MSolver::solve()
     {
+        TraceSpan span("solve", "MSolver::solve");
+        span.arg("solvables", m_pool->nsolvables).arg("jobs", m_jobs.count / 2);
+        MetricsTimer timer(Metrics::instance().solve_time);
         bool success;
+        auto start = std::chrono::steady_clock::now();
+
+        std::unique_ptr<SolutionCache> cache;
+        std::string cache_key;
+        if (Context::instance().solution_cache)
+        {
+            cache = std::make_unique<SolutionCache>(fs::path(create_cache_dir())
+                                                    / SOLUTION_CACHE_DIR);
+            cache_key = SolutionCache::key(m_pool, m_jobs, m_flags);
+            if (cache->load(cache_key, m_pool, m_cached_solution))
+            {
+                LOG_INFO << "Using cached solution " << cache_key;
+                m_from_cache = true;
+                m_is_solved = true;
+                m_stats.solving = milliseconds_since(start);
+                JsonLogger::instance().json_write(
+                    { { "success", true }, { "solver_stats", m_stats.to_json() } });
+                return true;
+            }
+        }
+
         m_solver = solver_create(m_pool);
         set_flags(m_flags);
 
-        solver_solve(m_solver, &m_jobs);
+        double solve_time;
+        {
+            RuleTimer rule_timer(m_pool);
+            auto solve_start = std::chrono::steady_clock::now();
+            solver_solve(m_solver, &m_jobs);
+            solve_time = milliseconds_since(solve_start);
+            m_stats.rule_generation = rule_timer.milliseconds();
+        }
+
+        m_stats.solving = std::max(solve_time - m_stats.rule_generation, 0.);
+        m_stats.solvables = m_pool->nsolvables;
+        count_rules(m_solver, m_stats.rules, m_stats.learnt_rules);
+        Queue decisions;
+        queue_init(&decisions);
+        solver_get_decisionqueue(m_solver, &decisions);
+        m_stats.decisions = decisions.count;
+        queue_free(&decisions);
+        LOG_INFO << "Solver statistics: " << m_stats.solvables << " solvables ("
+                 << m_stats.pruned_solvables << " pruned), " << m_stats.rules
+                 << " rules (" << m_stats.learnt_rules << " learnt), " << m_stats.decisions
+                 << " decisions";
+        LOG_INFO << "Solver timings: " << m_stats.pool_creation << " ms loading the repos, "
+                 << m_stats.whatprovides << " ms in whatprovides, " << m_stats.rule_generation
+                 << " ms generating rules, " << m_stats.solving << " ms solving";
+
         m_is_solved = true;
         LOG_INFO << "Problem count: " << solver_problem_count(m_solver) << std::endl;
         success = solver_problem_count(m_solver) == 0;
-        JsonLogger::instance().json_write({ { "success", success } });
+        JsonLogger::instance().json_write(
+            { { "success", success }, { "solver_stats", m_stats.to_json() } });
+
+        if (success && cache)
+        {
+            Queue decisions;
+            queue_init(&decisions);
+            solver_get_decisionqueue(m_solver, &decisions);
+            std::vector<Id> solution;
+            for (int i = 0; i < decisions.count; ++i)
+            {
+                Id p = decisions.elements[i];
+                if (p > 0 && p != SYSTEMSOLVABLE && pool_id2solvable(m_pool, p)->repo)
+                {
+                    solution.push_back(p);
+                }
+            }
+            queue_free(&decisions);
+            cache->store(cache_key, m_pool, solution);
+        }
         return success;
     }
 
+    Transaction* MSolver::create_transaction()
+    {
+        if (!m_from_cache)
+        {
+            return solver_create_transaction(m_solver);
+        }
+
+        // what libsolv does from the decisions of the solver: the installed
+        // packages that are not part of the solution are erased
+        Queue decisions;
+        queue_init(&decisions);
+        std::set<Id> solution(m_cached_solution.begin(), m_cached_solution.end());
+        for (Id p : m_cached_solution)
+        {
+            queue_push(&decisions, p);
+        }
+        if (m_pool->installed)
+        {
+            Id p;
+            Solvable* s;
+            FOR_REPO_SOLVABLES(m_pool->installed, p, s)
+            {
+                if (solution.find(p) == solution.end())
+                {
+                    queue_push(&decisions, -p);
+                }
+            }
+        }
+        Transaction* transaction = transaction_create_decisionq(m_pool, &decisions, nullptr);
+        queue_free(&decisions);
+        return transaction;
+    }
+
+    bool MSolver::from_cache() const
+    {
+        return m_from_cache;
+    }
+
+    Pool* MSolver::pool() const
+    {
+        return m_pool;
+    }
+
+    SolverStats& MSolver::stats()
+    {
+        return m_stats;
+    }
+
+    const SolverStats& MSolver::stats() const
+    {
+        return m_stats;
+    }
+
     std::string MSolver::problems_to_str()
     {
+        // only successful solutions are cached, they have no problems
+        if (m_from_cache)
+        {
+            return "";
+        }
         Queue problem_queue;
         queue_init(&problem_queue);
         int count = solver_problem_count(m_solver);
@@ -376,6 +657,10 @@ namespace mamba
 
     MSolver::operator Solver*()
     {
+        if (m_from_cache)
+        {
+            throw std::runtime_error("No libsolv solver, the solution comes from the cache");
+        }
         return m_solver;
     }
 }  // namespace mamba
@@ -5,9 +5,11 @@
 // The full license is in the file LICENSE, distributed with this software.
 
 #include "mamba/core/mamba_fs.hpp"
+#include "mamba/core/metrics.hpp"
 #include "mamba/core/output.hpp"
 #include "mamba/core/package_cache.hpp"
 #include "mamba/core/subdirdata.hpp"
+#include "mamba/core/trace.hpp"
 #include "mamba/core/url.hpp"
 
 
@@ -105,6 +107,8 @@ namespace mamba
 
     bool MSubdirData::load()
     {
+        TraceSpan span("repodata", "MSubdirData::load");
+        span.arg("subdir", m_name);
         auto now = fs::file_time_type::clock::now();
         auto cache_age = check_cache(m_json_fn, now);
         if (cache_age != fs::file_time_type::duration::max() && !forbid_cache())
@@ -138,6 +142,7 @@ namespace mamba
 
                     m_loaded = true;
                     m_json_cache_valid = true;
+                    ++Metrics::instance().repodata_cache_hits;
 
                     // check solv cache
                     auto solv_age = check_cache(m_solv_fn, now);
@@ -195,6 +200,8 @@ namespace mamba
 
     bool MSubdirData::finalize_transfer()
     {
+        TraceSpan span("repodata", "MSubdirData::finalize_transfer");
+        span.arg("subdir", m_name).arg("size", m_target->downloaded_size);
         if (m_target->result != 0 || m_target->http_status >= 400)
         {
             LOG_INFO << "Unable to retrieve repodata (response: " << m_target->http_status
@@ -220,6 +227,15 @@ namespace mamba
                                      + std::to_string(m_target->http_status));
         }
 
+        if (m_target->http_status == 304)
+        {
+            ++Metrics::instance().repodata_cache_hits;
+        }
+        else
+        {
+            ++Metrics::instance().repodata_cache_misses;
+        }
+
         if (m_target->http_status == 304)
         {
             // cache still valid
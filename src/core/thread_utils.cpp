@@ -163,4 +163,23 @@ namespace mamba
         }
     }
 
+    /****************
+     * parallel_for *
+     ****************/
+
+    std::size_t default_thread_count()
+    {
+        std::size_t n = std::thread::hardware_concurrency();
+        return n ? n : 1;
+    }
+
+    namespace detail
+    {
+        bool& in_parallel_for()
+        {
+            thread_local bool nested = false;
+            return nested;
+        }
+    }
+
 }  // namespace mamba
@@ -0,0 +1,116 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include <cstdlib>
+#include <fstream>
+
+#include "mamba/core/output.hpp"
+#include "mamba/core/trace.hpp"
+
+namespace mamba
+{
+    Tracer& Tracer::instance()
+    {
+        static Tracer* tracer = []() {
+            auto* res = new Tracer();
+            std::atexit([]() { instance().stop(); });
+            return res;
+        }();
+        return *tracer;
+    }
+
+    void Tracer::start(const fs::path& file)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_enabled.load() && file == m_file)
+        {
+            return;
+        }
+        m_file = file;
+        m_origin = clock::now();
+        m_async_id = 0;
+        m_events.clear();
+        m_events.push_back({ { "name", "process_name" },
+                             { "ph", "M" },
+                             { "pid", 0 },
+                             { "args", { { "name", "mamba" } } } });
+        m_enabled.store(true);
+    }
+
+    void Tracer::stop()
+    {
+        if (!m_enabled.exchange(false))
+        {
+            return;
+        }
+
+        nlohmann::json j = trace();
+        std::ofstream out(m_file);
+        out << j.dump();
+        if (!out)
+        {
+            LOG_ERROR << "Could not write the trace to " << m_file;
+        }
+    }
+
+    void Tracer::complete(const char* category,
+                          const char* name,
+                          clock::time_point start,
+                          clock::time_point end,
+                          nlohmann::json args)
+    {
+        nlohmann::json event = { { "name", name },  { "cat", category },
+                                 { "ph", "X" },     { "pid", 0 },
+                                 { "tid", thread_id() } };
+        std::lock_guard<std::mutex> lock(m_mutex);
+        event["ts"] = timestamp(start);
+        event["dur"] = timestamp(end) - timestamp(start);
+        event["args"] = std::move(args);
+        m_events.push_back(std::move(event));
+    }
+
+    void Tracer::async(const char* category,
+                       const std::string& name,
+                       clock::time_point start,
+                       clock::time_point end,
+                       nlohmann::json args)
+    {
+        nlohmann::json event = { { "name", name }, { "cat", category }, { "pid", 0 },
+                                 { "tid", thread_id() } };
+        std::lock_guard<std::mutex> lock(m_mutex);
+        event["id"] = ++m_async_id;
+
+        nlohmann::json begin = event;
+        begin["ph"] = "b";
+        begin["ts"] = timestamp(start);
+        begin["args"] = std::move(args);
+        m_events.push_back(std::move(begin));
+
+        event["ph"] = "e";
+        event["ts"] = timestamp(end);
+        m_events.push_back(std::move(event));
+    }
+
+    nlohmann::json Tracer::trace() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return { { "traceEvents", m_events }, { "displayTimeUnit", "ms" } };
+    }
+
+    // microseconds since the start of the trace
+    double Tracer::timestamp(clock::time_point time) const
+    {
+        return std::chrono::duration<double, std::micro>(time - m_origin).count();
+    }
+
+    // small ids, in the order threads record their first event
+    int Tracer::thread_id()
+    {
+        static std::atomic<int> next_id(1);
+        thread_local int id = next_id++;
+        return id;
+    }
+}  // namespace mamba
@@ -4,6 +4,7 @@
 //
 // The full license is in the file LICENSE, distributed with this software.
 
+#include <chrono>
 #include <iostream>
 #include <stack>
 #include <thread>
@@ -13,7 +14,10 @@
 #include "mamba/core/transaction.hpp"
 #include "mamba/core/link.hpp"
 #include "mamba/core/match_spec.hpp"
+#include "mamba/core/metrics.hpp"
 #include "mamba/core/thread_utils.hpp"
+#include "mamba/core/trace.hpp"
+#include "mamba/core/transaction_journal.hpp"
 
 namespace
 {
@@ -95,6 +99,8 @@ namespace mamba
 
     void PackageDownloadExtractTarget::validate()
     {
+        TraceSpan span("extract", "PackageDownloadExtractTarget::validate");
+        span.arg("package", m_name).arg("size", m_expected_size);
         m_validation_result = VALIDATION_RESULT::VALID;
         if (m_expected_size && size_t(m_target->downloaded_size) != m_expected_size)
         {
@@ -135,6 +141,10 @@ namespace mamba
             interruption_point();
             m_progress_proxy.set_postfix("Decompressing...");
             LOG_INFO << "Decompressing " << m_tarball_path;
+            TraceSpan span("extract", "PackageDownloadExtractTarget::extract");
+            span.arg("package", m_name).arg("size", m_expected_size);
+            MetricsTimer timer(Metrics::instance().extract_time);
+            ++Metrics::instance().extracted_packages;
             fs::path extract_path;
             try
             {
@@ -149,14 +159,12 @@ namespace mamba
                 LOG_ERROR << "Error when extracting package: " << e.what();
                 m_decompress_exception = e;
                 m_validation_result = VALIDATION_RESULT::EXTRACT_ERROR;
-                m_finished = true;
                 m_progress_proxy.mark_as_completed("Extraction error");
+                m_finished = true;
                 return false;
             }
         }
-
-        m_finished = true;
-        return m_finished;
+        return true;
     }
 
     bool PackageDownloadExtractTarget::extract_from_cache()
@@ -167,6 +175,8 @@ namespace mamba
             std::stringstream final_msg;
             final_msg << "Extracted " << std::left << std::setw(30) << m_name;
             m_progress_proxy.mark_as_completed(final_msg.str());
+            // the target is only released once finished, set last
+            m_finished = true;
             return result;
         }
         // currently we always return true
@@ -197,6 +207,7 @@ namespace mamba
 
         bool result = this->extract();
         m_progress_proxy.mark_as_extracted();
+        m_finished = true;
         return result;
     }
 
@@ -255,16 +266,21 @@ namespace mamba
             pkg_cache_path = cache.query(m_package_info);
             if (cache_path == pkg_cache_path)
             {
+                // finished once the tarball is extracted
+                LOG_INFO << "Using cached tarball " << m_name;
+                ++Metrics::instance().package_cache_hits;
                 m_tarball_path = pkg_cache_path / m_filename;
                 m_progress_proxy = Console::instance().add_progress_bar(m_name);
                 m_validation_result = VALIDATION_RESULT::VALID;
                 thread v(&PackageDownloadExtractTarget::extract_from_cache, this);
                 v.detach();
+                return nullptr;
             }
             else
             {
                 m_tarball_path = cache_path / m_filename;
                 cache.clear_query_cache(m_package_info);
+                ++Metrics::instance().package_cache_misses;
                 // need to download this file
                 LOG_INFO << "Adding " << m_name << " with " << m_url;
 
@@ -278,6 +294,7 @@ namespace mamba
             }
         }
         LOG_INFO << "Using cache " << m_name;
+        ++Metrics::instance().package_cache_hits;
         m_finished = true;
         return nullptr;
     }
@@ -314,10 +331,17 @@ namespace mamba
                 "Cannot create transaction without calling solver.solve() first.");
         }
 
-        m_transaction = solver_create_transaction(solver);
+        m_transaction = solver.create_transaction();
+        auto order_start = std::chrono::steady_clock::now();
         transaction_order(m_transaction, 0);
+        solver.stats().transaction_ordering
+            = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                        - order_start)
+                  .count();
+        LOG_INFO << "Transaction ordering took " << solver.stats().transaction_ordering << " ms";
+        JsonLogger::instance().json_write({ { "solver_stats", solver.stats().to_json() } });
 
-        auto* pool = static_cast<Solver*>(solver)->pool;
+        auto* pool = solver.pool();
 
         m_history_entry = History::UserRequest::prefilled();
 
@@ -382,6 +406,7 @@ namespace mamba
         m_force_reinstall = solver.force_reinstall;
 
         init();
+
         // if no action required, don't even start logging them
         if (!empty())
         {
@@ -523,6 +548,89 @@ namespace mamba
         std::stack<LinkPackage> m_link_stack;
     };
 
+    // Points the transaction context to the journal for the scope of the
+    // transaction, it must not outlive the journal on any way out
+    class JournalBinding
+    {
+    public:
+        JournalBinding(TransactionContext& context, TransactionJournal* journal)
+            : m_context(context)
+        {
+            m_context.journal = journal;
+        }
+
+        ~JournalBinding()
+        {
+            m_context.journal = nullptr;
+        }
+
+        JournalBinding(const JournalBinding&) = delete;
+        JournalBinding& operator=(const JournalBinding&) = delete;
+
+    private:
+        TransactionContext& m_context;
+    };
+
+    void MTransaction::update_cache_usage(
+        const std::map<fs::path, std::vector<std::pair<std::string, bool>>>& cache_usage,
+        const fs::path& prefix)
+    {
+        for (const auto& [cache_path, records] : cache_usage)
+        {
+            PackageCacheData cache(cache_path);
+            if (cache.is_writable() != Writable::WRITABLE)
+            {
+                continue;
+            }
+
+            try
+            {
+                PackageCacheUsage usage(cache_path);
+                LockFile lock(usage.lock_path());
+                usage.load();
+                for (const auto& [pkg, linked] : records)
+                {
+                    if (linked)
+                    {
+                        usage.record_link(pkg, prefix);
+                    }
+                    else
+                    {
+                        usage.record_unlink(pkg, prefix);
+                    }
+                }
+                usage.save();
+            }
+            catch (const std::exception& e)
+            {
+                LOG_WARNING << "Could not update package cache usage in " << cache_path << ": "
+                            << e.what();
+            }
+        }
+
+        const auto& max_size = Context::instance().package_cache_max_size;
+        if (!max_size.empty())
+        {
+            try
+            {
+                std::size_t freed
+                    = prune_package_caches(m_multi_cache, parse_human_readable_filesize(max_size));
+                if (freed)
+                {
+                    std::stringstream msg;
+                    msg << "Removed ";
+                    to_human_readable_filesize(msg, freed);
+                    msg << " of least recently used packages from the package cache";
+                    LOG_INFO << msg.str();
+                }
+            }
+            catch (const std::exception& e)
+            {
+                LOG_WARNING << "Could not prune the package cache: " << e.what();
+            }
+        }
+    }
+
     bool MTransaction::execute(PrefixData& prefix)
     {
         auto& ctx = Context::instance();
@@ -538,7 +646,7 @@ namespace mamba
                 { { "message", "All requested packages already installed" } });
         // finally, print the JSON
         if (ctx.json)
-            Console::instance().print(JsonLogger::instance().json_log.unflatten().dump(4), true);
+            Console::instance().print(JsonLogger::instance().json_log.dump(4), true);
 
         if (ctx.dry_run)
         {
@@ -548,10 +656,37 @@ namespace mamba
 
         Console::stream() << "\n\nTransaction starting";
         m_transaction_context = TransactionContext(prefix.path(), find_python_version());
+        m_transaction_context.defer_pyc_compilation = true;
+        m_transaction_context.defer_post_link = true;
         History::UserRequest ur = History::UserRequest::prefilled();
 
         TransactionRollback rollback;
 
+        // rolled back when destroyed before the commit, e.g. on exception.
+        // A transaction interrupted earlier is rolled back first.
+        std::unique_ptr<TransactionJournal> journal;
+        if (ctx.transaction_journal)
+        {
+            journal = std::make_unique<TransactionJournal>(prefix.path());
+        }
+        else
+        {
+            TransactionJournal::recover(prefix.path());
+        }
+        JournalBinding journal_binding(m_transaction_context, journal.get());
+
+        // (package, linked) pairs per package cache, written to the
+        // usage indexes once the transaction succeeded
+        std::map<fs::path, std::vector<std::pair<std::string, bool>>> cache_usage;
+        auto record_usage = [&cache_usage](const fs::path& cache_path,
+                                           const PackageInfo& pkg,
+                                           bool linked) {
+            if (!cache_path.empty())
+            {
+                cache_usage[cache_path].emplace_back(pkg.str(), linked);
+            }
+        };
+
         auto* pool = m_transaction->pool;
 
         for (int i = 0; i < m_transaction->steps.count && !is_sig_interrupted(); i++)
@@ -589,10 +724,12 @@ namespace mamba
                                      &m_transaction_context);
                     up.execute();
                     rollback.record(up);
+                    record_usage(ul_cache_path, p_unlink, false);
 
                     LinkPackage lp(p_link, l_cache_path, &m_transaction_context);
                     lp.execute();
                     rollback.record(lp);
+                    record_usage(l_cache_path, p_link, true);
 
                     m_history_entry.unlink_dists.push_back(p_unlink.long_str());
                     m_history_entry.link_dists.push_back(p_link.long_str());
@@ -608,6 +745,7 @@ namespace mamba
                         p, cache_path.empty() ? m_cache_path : cache_path, &m_transaction_context);
                     up.execute();
                     rollback.record(up);
+                    record_usage(cache_path, p, false);
                     m_history_entry.unlink_dists.push_back(p.long_str());
                     break;
                 }
@@ -619,6 +757,7 @@ namespace mamba
                     LinkPackage lp(p, cache_path, &m_transaction_context);
                     lp.execute();
                     rollback.record(lp);
+                    record_usage(cache_path, p, true);
                     m_history_entry.link_dists.push_back(p.long_str());
                     break;
                 }
@@ -630,16 +769,46 @@ namespace mamba
             }
         }
 
+        // one compilation for all the noarch python packages, the records
+        // are updated before a possible rollback
+        if (!is_sig_interrupted())
+        {
+            compile_deferred_pyc_files(&m_transaction_context);
+        }
+        // a failing script doesn't undo the transaction, as when the scripts
+        // are run while linking
+        if (!is_sig_interrupted())
+        {
+            auto failed = run_deferred_post_link_scripts(&m_transaction_context);
+            if (!failed.empty())
+            {
+                LOG_WARNING << "Post-link scripts failed, the packages stay linked: "
+                            << join(", ", failed);
+            }
+        }
+
         bool interrupted = is_sig_interrupted();
         if (interrupted)
         {
             Console::stream() << "Transaction interrupted, rollbacking";
-            rollback.rollback();
+            if (journal)
+            {
+                journal->rollback();
+            }
+            else
+            {
+                rollback.rollback();
+            }
         }
         else
         {
+            if (journal)
+            {
+                journal->commit();
+            }
             Console::stream() << "Transaction finished";
             prefix.history().add_entry(m_history_entry);
+            update_cache_usage(cache_usage, prefix.path());
         }
         return !interrupted;
     }
@@ -729,6 +898,16 @@ namespace mamba
 
         Console::instance().init_multi_progress(ProgressBarMode::aggregated);
 
+        // Verify the cached packages up-front and concurrently, the
+        // following lookups then hit the query cache
+        std::vector<PackageInfo> to_install_infos;
+        to_install_infos.reserve(m_to_install.size());
+        for (Solvable* s : m_to_install)
+        {
+            to_install_infos.emplace_back(s);
+        }
+        m_multi_cache.query(to_install_infos);
+
         for (auto& s : m_to_install)
         {
             std::string url;
@@ -799,6 +978,8 @@ namespace mamba
             }
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
+        // the final state of the progress bars, before the linking messages
+        Console::instance().render_progress();
 
         for (const auto& t : targets)
         {
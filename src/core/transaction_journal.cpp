@@ -0,0 +1,471 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/locking.h>
+#else
+#include <unistd.h>
+#endif
+#include <fcntl.h>
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+#include "mamba/core/output.hpp"
+#include "mamba/core/transaction_journal.hpp"
+
+#define TRANSACTION_JOURNAL_FILE "journal"
+#define TRANSACTION_BACKUP_DIR "backup"
+
+namespace mamba
+{
+    namespace
+    {
+        // Journal operations, one per line followed by the relative path
+        constexpr char JOURNAL_CREATE = 'C';
+        constexpr char JOURNAL_BACKUP = 'B';
+        constexpr char JOURNAL_DIRECTORY = 'D';
+        // Written once the created files are removed by a rollback
+        constexpr char JOURNAL_RESTORING = 'R';
+
+        fs::path lock_path(const fs::path& prefix)
+        {
+            return prefix / "conda-meta" / TRANSACTION_JOURNAL_DIR ".lock";
+        }
+
+        // Renames when possible, e.g. not across mount points inside the prefix
+        void move_path(const fs::path& from, const fs::path& to)
+        {
+            std::error_code ec;
+            fs::rename(from, to, ec);
+            if (ec)
+            {
+                LOG_DEBUG << "Could not rename " << from << ", copying it: " << ec.message();
+                fs::copy(from,
+                         to,
+                         fs::copy_options::copy_symlinks | fs::copy_options::recursive);
+                fs::remove_all(from);
+            }
+        }
+
+        // The lock file is never removed: a process waiting on it would
+        // otherwise hold a lock on an unlinked file while a third one
+        // creates and locks a new one.
+        int lock_file(const fs::path& path)
+        {
+#ifdef _WIN32
+            int fd = _wopen(path.c_str(), _O_RDWR | _O_CREAT, _S_IREAD | _S_IWRITE);
+#else
+            int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0666);
+#endif
+            if (fd < 0)
+            {
+                throw std::runtime_error("Could not open lock file " + path.string() + ": "
+                                         + std::strerror(errno));
+            }
+#ifdef _WIN32
+            // LK_LOCK gives up with EDEADLOCK after 10 attempts
+            while (_locking(fd, LK_LOCK, 1) != 0)
+            {
+                if (errno != EDEADLOCK)
+                {
+                    int err = errno;
+                    _close(fd);
+                    throw std::runtime_error("Could not lock " + path.string() + ": "
+                                             + std::strerror(err));
+                }
+            }
+#else
+            struct flock lock = {};
+            lock.l_type = F_WRLCK;
+            lock.l_whence = SEEK_SET;
+            lock.l_start = 0;
+            lock.l_len = 1;
+            while (fcntl(fd, F_SETLKW, &lock) != 0)
+            {
+                if (errno != EINTR)
+                {
+                    int err = errno;
+                    ::close(fd);
+                    throw std::runtime_error("Could not lock " + path.string() + ": "
+                                             + std::strerror(err));
+                }
+            }
+#endif
+            return fd;
+        }
+
+        void unlock_file(int fd)
+        {
+#ifdef _WIN32
+            _locking(fd, LK_UNLCK, 1);
+            _close(fd);
+#else
+            // closing the descriptor releases the lock
+            ::close(fd);
+#endif
+        }
+
+        // Record locks are per process, the threads of a process are
+        // serialized by a mutex per prefix
+        std::mutex& prefix_mutex(const fs::path& prefix)
+        {
+            static std::mutex mutexes_mutex;
+            static std::map<std::string, std::mutex> mutexes;
+            std::lock_guard<std::mutex> lock(mutexes_mutex);
+            return mutexes[fs::absolute(prefix).lexically_normal().string()];
+        }
+
+        void remove_empty_parents(const fs::path& path, const fs::path& prefix)
+        {
+            std::error_code ec;
+            for (fs::path p = path.parent_path(); p != prefix && p.has_relative_path();
+                 p = p.parent_path())
+            {
+                if (!fs::is_directory(p, ec) || !fs::is_empty(p, ec) || !fs::remove(p, ec))
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    class TransactionJournal::PrefixLock
+    {
+    public:
+        explicit PrefixLock(const fs::path& prefix)
+            : m_guard(prefix_mutex(prefix))
+        {
+            fs::create_directories(prefix / "conda-meta");
+            m_fd = lock_file(lock_path(prefix));
+        }
+
+        ~PrefixLock()
+        {
+            unlock_file(m_fd);
+        }
+
+        PrefixLock(const PrefixLock&) = delete;
+        PrefixLock& operator=(const PrefixLock&) = delete;
+
+    private:
+        std::unique_lock<std::mutex> m_guard;
+        int m_fd;
+    };
+
+    TransactionJournal::TransactionJournal(const fs::path& prefix)
+        : m_prefix(prefix)
+        , m_dir(journal_dir(prefix))
+    {
+        m_lock = std::make_unique<PrefixLock>(m_prefix);
+
+        // left by a process that died during a transaction
+        if (pending(m_prefix))
+        {
+            LOG_WARNING << "Rolling back an interrupted transaction in " << m_prefix;
+            replay(m_prefix);
+        }
+        fs::remove_all(m_dir);
+        fs::create_directories(m_dir / TRANSACTION_BACKUP_DIR);
+
+        m_journal.open(m_dir / TRANSACTION_JOURNAL_FILE, std::ios::out | std::ios::trunc);
+        if (!m_journal)
+        {
+            throw std::runtime_error("Could not open transaction journal in "
+                                     + m_dir.string());
+        }
+        LOG_DEBUG << "Transaction journal opened in " << m_dir;
+    }
+
+    TransactionJournal::~TransactionJournal()
+    {
+        if (!m_active)
+        {
+            return;
+        }
+
+        // an exception left the transaction half-way
+        try
+        {
+            LOG_WARNING << "Transaction not committed, rolling back";
+            rollback();
+        }
+        catch (const std::exception& e)
+        {
+            LOG_ERROR << "Could not roll back the transaction, the next one will: " << e.what();
+        }
+    }
+
+    fs::path TransactionJournal::journal_dir(const fs::path& prefix)
+    {
+        return prefix / "conda-meta" / TRANSACTION_JOURNAL_DIR;
+    }
+
+    bool TransactionJournal::pending(const fs::path& prefix)
+    {
+        return fs::exists(journal_dir(prefix) / TRANSACTION_JOURNAL_FILE);
+    }
+
+    bool TransactionJournal::recover(const fs::path& prefix)
+    {
+        fs::path dir = journal_dir(prefix);
+        if (!fs::exists(dir))
+        {
+            return false;
+        }
+
+        // waits for a transaction running in another thread or process
+        PrefixLock lock(prefix);
+        bool interrupted = pending(prefix);
+        if (interrupted)
+        {
+            LOG_WARNING << "Rolling back an interrupted transaction in " << prefix;
+            replay(prefix);
+        }
+        // also cleans the backup of a committed transaction
+        fs::remove_all(dir);
+        return interrupted;
+    }
+
+    const fs::path& TransactionJournal::prefix() const
+    {
+        return m_prefix;
+    }
+
+    std::string TransactionJournal::relative(const fs::path& path) const
+    {
+        return path.lexically_relative(m_prefix).string();
+    }
+
+    void TransactionJournal::write(char op, const std::string& rel_path)
+    {
+        // the line must be on disk before the file system is changed
+        m_journal << op << ' ' << rel_path << '\n';
+        m_journal.flush();
+        if (!m_journal)
+        {
+            throw std::runtime_error("Could not write transaction journal in "
+                                     + m_dir.string());
+        }
+    }
+
+    void TransactionJournal::remove(const fs::path& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!lexists(path))
+        {
+            return;
+        }
+
+        std::string rel_path = relative(path);
+        fs::path backup = m_dir / TRANSACTION_BACKUP_DIR / rel_path;
+        if (m_created.count(rel_path) || lexists(backup))
+        {
+            // not part of the initial state of the prefix
+            fs::remove(path);
+            return;
+        }
+        if (fs::is_directory(path) && !fs::is_symlink(path) && !fs::is_empty(path))
+        {
+            LOG_WARNING << "Not removing non-empty directory " << path;
+            return;
+        }
+
+        write(JOURNAL_BACKUP, rel_path);
+        fs::create_directories(backup.parent_path());
+        move_path(path, backup);
+    }
+
+    void TransactionJournal::create(const fs::path& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string rel_path = relative(path);
+        if (!m_created.insert(rel_path).second)
+        {
+            return;
+        }
+
+        // the missing parents are created by the caller, outermost first
+        std::vector<fs::path> new_dirs;
+        for (fs::path p = path.parent_path(); p != m_prefix && p.has_relative_path();
+             p = p.parent_path())
+        {
+            if (lexists(p))
+            {
+                break;
+            }
+            new_dirs.push_back(p);
+        }
+        for (auto it = new_dirs.rbegin(); it != new_dirs.rend(); ++it)
+        {
+            std::string rel_dir = relative(*it);
+            if (m_created_dirs.insert(rel_dir).second)
+            {
+                write(JOURNAL_DIRECTORY, rel_dir);
+            }
+        }
+
+        fs::path backup = m_dir / TRANSACTION_BACKUP_DIR / rel_path;
+        if (lexists(path) && !lexists(backup))
+        {
+            write(JOURNAL_BACKUP, rel_path);
+            fs::create_directories(backup.parent_path());
+            move_path(path, backup);
+        }
+        write(JOURNAL_CREATE, rel_path);
+    }
+
+    void TransactionJournal::create(const std::vector<fs::path>& paths)
+    {
+        for (const auto& p : paths)
+        {
+            create(p);
+        }
+    }
+
+    void TransactionJournal::commit()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_journal.close();
+        // the transaction is committed once the journal is gone
+        fs::remove(m_dir / TRANSACTION_JOURNAL_FILE);
+        m_active = false;
+
+        std::error_code ec;
+        fs::remove_all(m_dir, ec);
+        if (ec)
+        {
+            LOG_WARNING << "Could not remove transaction backup " << m_dir << ": "
+                        << ec.message();
+        }
+        m_lock.reset();
+    }
+
+    void TransactionJournal::rollback()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_journal.close();
+        replay(m_prefix);
+        m_active = false;
+        fs::remove_all(m_dir);
+        m_lock.reset();
+    }
+
+    // Undoes the journaled operations. Can be interrupted and run again: the
+    // created files are all removed before any backup is moved back, which
+    // is marked in the journal.
+    void TransactionJournal::replay(const fs::path& prefix)
+    {
+        fs::path dir = journal_dir(prefix);
+        fs::path journal_file = dir / TRANSACTION_JOURNAL_FILE;
+
+        std::vector<std::pair<char, std::string>> entries;
+        bool restoring = false;
+        {
+            std::ifstream in(journal_file, std::ios::in | std::ios::binary);
+            std::string line;
+            // a line without its newline was being written when the process died
+            while (std::getline(in, line) && !in.eof())
+            {
+                if (line.empty())
+                {
+                    continue;
+                }
+                if (line[0] == JOURNAL_RESTORING)
+                {
+                    restoring = true;
+                }
+                else if (line.size() > 2)
+                {
+                    entries.emplace_back(line[0], line.substr(2));
+                }
+            }
+        }
+        LOG_INFO << "Rolling back " << entries.size() << " journaled operations in " << prefix;
+
+        if (!restoring)
+        {
+            for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+            {
+                if (it->first != JOURNAL_CREATE)
+                {
+                    continue;
+                }
+                fs::path p = prefix / it->second;
+                std::error_code ec;
+                if (fs::is_directory(p) && !fs::is_symlink(p))
+                {
+                    if (fs::is_empty(p))
+                    {
+                        fs::remove(p, ec);
+                    }
+                    else
+                    {
+                        LOG_WARNING << "Not removing non-empty directory " << p;
+                    }
+                }
+                else if (lexists(p))
+                {
+                    fs::remove(p, ec);
+                }
+                if (ec)
+                {
+                    LOG_WARNING << "Could not remove " << p << ": " << ec.message();
+                }
+                remove_empty_parents(p, prefix);
+            }
+
+            // with what was written in them besides the journaled files,
+            // e.g. by the post-link scripts
+            for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+            {
+                if (it->first != JOURNAL_DIRECTORY)
+                {
+                    continue;
+                }
+                fs::path p = prefix / it->second;
+                std::error_code ec;
+                if (fs::is_directory(p) && !fs::is_symlink(p))
+                {
+                    fs::remove_all(p, ec);
+                }
+                if (ec)
+                {
+                    LOG_WARNING << "Could not remove " << p << ": " << ec.message();
+                }
+                remove_empty_parents(p, prefix);
+            }
+
+            std::ofstream out(journal_file, std::ios::out | std::ios::app);
+            out << JOURNAL_RESTORING << '\n';
+        }
+
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+        {
+            if (it->first != JOURNAL_BACKUP)
+            {
+                continue;
+            }
+            fs::path backup = dir / TRANSACTION_BACKUP_DIR / it->second;
+            if (!lexists(backup))
+            {
+                continue;
+            }
+            fs::path p = prefix / it->second;
+            fs::create_directories(p.parent_path());
+            if (lexists(p))
+            {
+                fs::remove_all(p);
+            }
+            move_path(backup, p);
+        }
+    }
+}  // namespace mamba
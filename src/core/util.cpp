@@ -67,6 +67,46 @@ namespace mamba
         o << std::fixed << std::setprecision(precision) << bytes << sizes[order];
     }
 
+    std::size_t parse_human_readable_filesize(const std::string& size)
+    {
+        std::string s = to_upper(strip(size));
+        if (ends_with(s, "B"))
+        {
+            s.pop_back();
+        }
+
+        const std::string units = "KMGT";
+        std::size_t multiplier = 1;
+        if (!s.empty())
+        {
+            auto pos = units.find(s.back());
+            if (pos != std::string::npos)
+            {
+                s.pop_back();
+                for (std::size_t i = 0; i <= pos; ++i)
+                {
+                    multiplier *= 1024;
+                }
+            }
+        }
+
+        std::size_t idx = 0;
+        double value = 0;
+        try
+        {
+            value = std::stod(s, &idx);
+        }
+        catch (const std::exception&)
+        {
+            idx = 0;
+        }
+        if (s.empty() || idx != s.size() || value < 0)
+        {
+            throw std::runtime_error("Invalid size: '" + size + "'");
+        }
+        return static_cast<std::size_t>(value * multiplier);
+    }
+
     std::vector<fs::path> filter_dir(const fs::path& dir, const std::string& suffix)
     {
         std::vector<fs::path> result;
@@ -14,6 +14,7 @@
 #include "mamba/core/pool.hpp"
 #include "mamba/core/prefix_data.hpp"
 #include "mamba/core/query.hpp"
+#include "mamba/core/query_server.hpp"
 #include "mamba/core/repo.hpp"
 #include "mamba/core/solver.hpp"
 #include "mamba/core/subdirdata.hpp"
@@ -79,6 +80,18 @@ PYBIND11_MODULE(mamba_api, m)
             return self.execute(target_prefix);
         });
 
+    py::class_<SolverStats>(m, "SolverStats")
+        .def_readonly("pool_creation", &SolverStats::pool_creation)
+        .def_readonly("whatprovides", &SolverStats::whatprovides)
+        .def_readonly("rule_generation", &SolverStats::rule_generation)
+        .def_readonly("solving", &SolverStats::solving)
+        .def_readonly("transaction_ordering", &SolverStats::transaction_ordering)
+        .def_readonly("solvables", &SolverStats::solvables)
+        .def_readonly("rules", &SolverStats::rules)
+        .def_readonly("learnt_rules", &SolverStats::learnt_rules)
+        .def_readonly("decisions", &SolverStats::decisions)
+        .def("to_json", [](const SolverStats& self) { return self.to_json().dump(); });
+
     py::class_<MSolver>(m, "Solver")
         .def(py::init<MPool&, std::vector<std::pair<int, int>>>())
         .def(py::init<MPool&, std::vector<std::pair<int, int>>, const PrefixData*>())
@@ -89,7 +102,8 @@ PYBIND11_MODULE(mamba_api, m)
         .def("set_postsolve_flags", &MSolver::set_postsolve_flags)
         .def("is_solved", &MSolver::is_solved)
         .def("problems_to_str", &MSolver::problems_to_str)
-        .def("solve", &MSolver::solve);
+        .def("solve", &MSolver::solve)
+        .def("stats", [](const MSolver& self) { return self.stats(); });
 
     py::class_<History>(m, "History")
         .def(py::init<const std::string&>())
@@ -107,6 +121,14 @@ PYBIND11_MODULE(mamba_api, m)
         .def("depends", &Query::depends)
     ;*/
 
+    py::class_<QueryServer>(m, "QueryServer")
+        .def(py::init<>())
+        .def("handle", &QueryServer::handle)
+        .def(
+            "serve",
+            [](QueryServer& self, const std::string& socket_path) { self.serve(socket_path); },
+            py::call_guard<py::gil_scoped_release>());
+
     py::enum_<query::RESULT_FORMAT>(m, "QueryFormat")
         .value("JSON", query::RESULT_FORMAT::JSON)
         .value("TREE", query::RESULT_FORMAT::TREE)
@@ -273,7 +295,21 @@ PYBIND11_MODULE(mamba_api, m)
 
     m.def("get_channels", &get_channels);
 
-    m.def("transmute", &transmute);
+    m.def("transmute",
+          py::overload_cast<const fs::path&, const fs::path&, int, int>(&transmute),
+          py::arg("source_package"),
+          py::arg("destination_package"),
+          py::arg("compression_level"),
+          py::arg("compression_threads") = 1);
+    m.def("transmute",
+          py::overload_cast<const std::vector<std::pair<fs::path, fs::path>>&,
+                            int,
+                            int,
+                            std::size_t>(&transmute),
+          py::arg("packages"),
+          py::arg("compression_level"),
+          py::arg("compression_threads") = 1,
+          py::arg("max_threads") = 0);
 
     m.attr("SOLVER_SOLVABLE") = SOLVER_SOLVABLE;
     m.attr("SOLVER_SOLVABLE_NAME") = SOLVER_SOLVABLE_NAME;
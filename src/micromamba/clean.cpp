@@ -32,12 +32,17 @@ init_clean_parser(CLI::App* subcom)
     auto& clean_tarballs = config.insert(Configurable("clean_tarballs", false)
                                              .group("cli")
                                              .description("Remove cached package tarballs"));
+    auto& max_size = config.at("package_cache_max_size").get_wrapped<std::string>();
 
     subcom->add_flag("-a,--all", clean_all.set_cli_config(0), clean_all.description());
     subcom->add_flag("-i,--index-cache", clean_index.set_cli_config(0), clean_index.description());
     subcom->add_flag("-p,--packages", clean_pkgs.set_cli_config(0), clean_pkgs.description());
     subcom->add_flag(
         "-t,--tarballs", clean_tarballs.set_cli_config(0), clean_tarballs.description());
+    subcom->add_option(
+        "--max-size",
+        max_size.set_cli_config(""),
+        "Remove least recently used unused packages until the cache fits in this size (e.g. 20G)");
 }
 
 void
@@ -57,6 +62,8 @@ set_clean_command(CLI::App* subcom)
             options = options | MAMBA_CLEAN_PKGS;
         if (config.at("clean_tarballs").compute().value<bool>())
             options = options | MAMBA_CLEAN_TARBALLS;
+        if (config.at("package_cache_max_size").cli_configured())
+            options = options | MAMBA_CLEAN_LRU;
 
         clean(options);
     });
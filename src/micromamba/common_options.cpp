@@ -44,6 +44,20 @@ init_general_options(CLI::App* subcom)
                    "Set verbosity (higher verbosity with multiple -v, e.g. -vvv)")
         ->group(cli_group);
 
+    auto& log_file = config.at("log_file").get_wrapped<fs::path>();
+    subcom->add_option("--log-file", log_file.set_cli_config(""), log_file.description())
+        ->group(cli_group);
+
+    auto& trace_file = config.at("trace_file").get_wrapped<fs::path>();
+    subcom->add_option("--trace", trace_file.set_cli_config(""), trace_file.description())
+        ->group(cli_group);
+
+    auto& metrics_file = config.at("metrics_file").get_wrapped<fs::path>();
+    subcom
+        ->add_option(
+            "--metrics-file", metrics_file.set_cli_config(""), metrics_file.description())
+        ->group(cli_group);
+
     auto& quiet = config.at("quiet").get_wrapped<bool>();
     subcom->add_flag("-q,--quiet", quiet.set_cli_config(0), quiet.description())->group(cli_group);
 
@@ -10,6 +10,7 @@
 #include "mamba/api/configuration.hpp"
 #include "mamba/api/install.hpp"
 
+#include "mamba/core/package_cache.hpp"
 #include "mamba/core/package_handling.hpp"
 #include "mamba/core/util.hpp"
 #include "mamba/core/package_info.hpp"
@@ -41,6 +42,14 @@ init_constructor_parser(CLI::App* subcom)
                                               .description("Extract given tarball into prefix"));
     subcom->add_flag(
         "--extract-tarball", extract_tarball.set_cli_config(0), extract_tarball.description());
+
+    auto& write_manifest
+        = config.insert(Configurable("constructor_write_manifest", false)
+                            .group("cli")
+                            .description("Write the manifest of <prefix>/pkgs, to be used "
+                                         "as a read-only package cache"));
+    subcom->add_flag(
+        "--write-manifest", write_manifest.set_cli_config(0), write_manifest.description());
 }
 
 void
@@ -54,14 +63,18 @@ set_constructor_command(CLI::App* subcom)
         auto& prefix = c.at("constructor_prefix").compute().value<fs::path>();
         auto& extract_conda_pkgs = c.at("constructor_extract_conda_pkgs").compute().value<bool>();
         auto& extract_tarball = c.at("constructor_extract_tarball").compute().value<bool>();
+        auto& write_manifest = c.at("constructor_write_manifest").compute().value<bool>();
 
-        construct(prefix, extract_conda_pkgs, extract_tarball);
+        construct(prefix, extract_conda_pkgs, extract_tarball, write_manifest);
     });
 }
 
 
 void
-construct(const fs::path& prefix, bool extract_conda_pkgs, bool extract_tarball)
+construct(const fs::path& prefix,
+          bool extract_conda_pkgs,
+          bool extract_tarball,
+          bool write_manifest)
 {
     auto& config = Configuration::instance();
 
@@ -130,6 +143,15 @@ construct(const fs::path& prefix, bool extract_conda_pkgs, bool extract_tarball)
         extract_archive(extract_tarball_path, prefix);
         fs::remove(extract_tarball_path);
     }
+
+    if (write_manifest)
+    {
+        PackageCacheManifest manifest(prefix / "pkgs");
+        manifest.build();
+        manifest.save();
+        std::cout << "Wrote " << manifest.size() << " packages to " << manifest.path()
+                  << std::endl;
+    }
 }
 
 
@@ -11,7 +11,10 @@
 
 
 void
-construct(const fs::path& prefix, bool extract_conda_pkgs, bool extract_tarball);
+construct(const fs::path& prefix,
+          bool extract_conda_pkgs,
+          bool extract_tarball,
+          bool write_manifest = false);
 
 void
 read_binary_from_stdin_and_write_to_file(fs::path& filename);
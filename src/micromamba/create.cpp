@@ -6,6 +6,7 @@
 
 #include "common_options.hpp"
 
+#include "mamba/api/configuration.hpp"
 #include "mamba/api/create.hpp"
 
 
@@ -16,5 +17,9 @@ set_create_command(CLI::App* subcom)
 {
     init_install_options(subcom);
 
+    auto& config = Configuration::instance();
+    auto& clone = config.at("clone").get_wrapped<std::string>();
+    subcom->add_option("--clone", clone.set_cli_config(""), clone.description());
+
     subcom->callback([&]() { create(); });
 }
@@ -0,0 +1,40 @@
+// Copyright (c) 2019, QuantStack and Mamba Contributors
+//
+// Distributed under the terms of the BSD 3-Clause License.
+//
+// The full license is in the file LICENSE, distributed with this software.
+
+#include "common_options.hpp"
+
+#include "mamba/api/configuration.hpp"
+#include "mamba/api/query_server.hpp"
+
+
+using namespace mamba;  // NOLINT(build/namespaces)
+
+void
+init_query_server_parser(CLI::App* subcom)
+{
+    init_general_options(subcom);
+    init_channel_parser(subcom);
+
+    auto& config = Configuration::instance();
+
+    auto& socket = config.insert(Configurable("query_server_socket", std::string(""))
+                                     .group("cli")
+                                     .description("Path of the Unix socket to listen on"));
+    subcom->add_option("socket", socket.set_cli_config(""), socket.description())->required();
+}
+
+void
+set_query_server_command(CLI::App* subcom)
+{
+    init_query_server_parser(subcom);
+
+    subcom->callback([]() {
+        auto& config = Configuration::instance();
+        auto& socket = config.at("query_server_socket").compute().value<std::string>();
+
+        query_server(socket);
+    });
+}
@@ -55,6 +55,10 @@ set_umamba_command(CLI::App* com)
     CLI::App* list_subcom = com->add_subcommand("list", "List packages in active environment");
     set_list_command(list_subcom);
 
+    CLI::App* query_server_subcom = com->add_subcommand(
+        "query-server", "Answer repoquery requests on a Unix socket from pools kept loaded");
+    set_query_server_command(query_server_subcom);
+
     CLI::App* clean_subcom = com->add_subcommand("clean", "Clean package cache");
     set_clean_command(clean_subcom);
 
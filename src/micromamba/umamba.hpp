@@ -44,6 +44,9 @@ set_install_command(CLI::App* subcom);
 void
 set_list_command(CLI::App* subcom);
 
+void
+set_query_server_command(CLI::App* subcom);
+
 void
 set_remove_command(CLI::App* subcom);
 
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "nlohmann/json.hpp"
+
+#include "mamba/core/content_store.hpp"
+#include "mamba/core/context.hpp"
+#include "mamba/core/package_handling.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/validate.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        // Writes a minimal extracted package with a single file
+        fs::path make_package(const fs::path& pkgs_dir,
+                              const std::string& name,
+                              const std::string& content)
+        {
+            fs::path pkg_dir = pkgs_dir / name;
+            fs::create_directories(pkg_dir / "info");
+            fs::create_directories(pkg_dir / "lib");
+            {
+                std::ofstream f(pkg_dir / "lib" / "data.txt");
+                f << content;
+            }
+
+            nlohmann::json paths;
+            paths["paths_version"] = 1;
+            paths["paths"] = { { { "_path", "lib/data.txt" },
+                                 { "path_type", "hardlink" },
+                                 { "sha256", validate::sha256sum(pkg_dir / "lib" / "data.txt") },
+                                 { "size_in_bytes", content.size() } } };
+            std::ofstream f(pkg_dir / "info" / "paths.json");
+            f << paths.dump(4);
+            return pkg_dir;
+        }
+    }
+
+    TEST(content_store, deduplicate)
+    {
+        TemporaryDirectory tmp_dir;
+        ContentStore store(tmp_dir.path());
+
+        auto pkg_a = make_package(tmp_dir.path(), "a-1.0-0", "identical content");
+        auto pkg_b = make_package(tmp_dir.path(), "b-1.0-0", "identical content");
+        auto pkg_c = make_package(tmp_dir.path(), "c-1.0-0", "other content");
+
+        store.deduplicate(pkg_a);
+        store.deduplicate(pkg_b);
+        store.deduplicate(pkg_c);
+
+        EXPECT_EQ(fs::hard_link_count(pkg_a / "lib" / "data.txt"), 3);
+        EXPECT_EQ(fs::hard_link_count(pkg_c / "lib" / "data.txt"), 2);
+        EXPECT_TRUE(store.unreferenced_blobs().empty());
+
+        // deduplicating twice is a no-op
+        store.deduplicate(pkg_b);
+        EXPECT_EQ(fs::hard_link_count(pkg_b / "lib" / "data.txt"), 3);
+
+        std::ifstream f(pkg_b / "lib" / "data.txt");
+        std::string content;
+        std::getline(f, content);
+        EXPECT_EQ(content, "identical content");
+    }
+
+    TEST(content_store, unreferenced_blobs)
+    {
+        TemporaryDirectory tmp_dir;
+        ContentStore store(tmp_dir.path());
+
+        auto pkg_a = make_package(tmp_dir.path(), "a-1.0-0", "identical content");
+        auto pkg_b = make_package(tmp_dir.path(), "b-1.0-0", "identical content");
+        store.deduplicate(pkg_a);
+        store.deduplicate(pkg_b);
+
+        fs::remove_all(pkg_a);
+        EXPECT_TRUE(store.unreferenced_blobs().empty());
+
+        fs::remove_all(pkg_b);
+        auto blobs = store.unreferenced_blobs();
+        ASSERT_EQ(blobs.size(), 1);
+        EXPECT_EQ(blobs[0].parent_path().parent_path(), store.path());
+    }
+
+    TEST(content_store, link)
+    {
+        TemporaryDirectory tmp_dir;
+        ContentStore store(tmp_dir.path());
+
+        auto pkg_a = make_package(tmp_dir.path(), "a-1.0-0", "identical content");
+        store.deduplicate(pkg_a);
+
+        auto sha = validate::sha256sum(pkg_a / "lib" / "data.txt");
+        auto perms = fs::status(pkg_a / "lib" / "data.txt").permissions();
+        fs::path target = tmp_dir.path() / "b-1.0-0" / "lib" / "data.txt";
+
+        EXPECT_TRUE(store.link(sha, perms, target));
+        EXPECT_EQ(fs::hard_link_count(target), 3);
+        EXPECT_FALSE(store.link(std::string(64, '0'), perms, target));
+    }
+
+#ifndef _WIN32
+    TEST(content_store, extract_with_umask)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path pkgs_dir = tmp_dir.path() / "pkgs";
+        fs::create_directories(pkgs_dir);
+        auto pkg_dir = make_package(tmp_dir.path(), "src", "executable content");
+        fs::permissions(pkg_dir / "lib" / "data.txt",
+                        fs::perms::owner_all | fs::perms::group_all | fs::perms::others_read
+                            | fs::perms::others_exec);
+        create_package(pkg_dir, pkgs_dir / "a-1.0-0.conda", 1);
+        create_package(pkg_dir, pkgs_dir / "b-1.0-0.conda", 1);
+
+        mode_t old_mask = ::umask(0027);
+        bool use_content_store = Context::instance().use_content_store;
+        Context::instance().use_content_store = true;
+
+        // a stores its file, the extraction of b links it from the store
+        fs::path pkg_a = extract(pkgs_dir / "a-1.0-0.conda");
+        fs::path pkg_b = extract(pkgs_dir / "b-1.0-0.conda");
+
+        // the entry and the file on disk give the same key
+        ContentStore store(pkgs_dir);
+        auto sha = validate::sha256sum(pkg_a / "lib" / "data.txt");
+        fs::path blob = store.blob_path(sha, fs::status(pkg_a / "lib" / "data.txt").permissions());
+        EXPECT_EQ(blob, store.blob_path(sha, static_cast<fs::perms>(0775)));
+        EXPECT_EQ(blob.filename().string(), sha + "-750");
+
+        Context::instance().use_content_store = use_content_store;
+        ::umask(old_mask);
+
+        EXPECT_EQ(fs::hard_link_count(pkg_b / "lib" / "data.txt"), 3);
+        EXPECT_TRUE(fs::equivalent(pkg_a / "lib" / "data.txt", pkg_b / "lib" / "data.txt"));
+        EXPECT_TRUE(fs::equivalent(blob, pkg_b / "lib" / "data.txt"));
+        EXPECT_EQ(store.unreferenced_blobs().size(), 0);
+    }
+#endif
+}  // namespace mamba
@@ -8,6 +8,7 @@
 #include "mamba/core/history.hpp"
 #include "mamba/core/link.hpp"
 #include "mamba/core/match_spec.hpp"
+#include "mamba/core/validate.hpp"
 
 namespace mamba
 {
@@ -264,11 +265,48 @@ namespace mamba
         proxy.set_progress(50, 100);
         proxy.set_postfix("Downloading");
         proxy.mark_as_completed("conda-forge channel downloaded");
+        // drawn on the next frame
+        Console::instance().render_progress();
         std::string output = testing::internal::GetCapturedStdout();
         EXPECT_TRUE(ends_with(output, "conda-forge channel downloaded\n"));
         Context::instance().no_progress_bars = false;
     }
 
+    TEST(output, json_logger)
+    {
+        auto& ctx = Context::instance();
+        ctx.json = true;
+        auto& logger = JsonLogger::instance();
+
+        logger.json_write({ { "success", true }, { "stats", { { "solvables", 3 } } } });
+        logger.json_down("actions");
+        logger.json_write({ { "PREFIX", "/prefix" } });
+        logger.json_down("LINK");
+        logger.json_append(nlohmann::json({ { "name", "a" }, { "depends", { "b", "c" } } }));
+        logger.json_append(nlohmann::json({ { "name", "b" } }));
+        logger.json_up();
+        logger.json_down("FETCH");
+        logger.json_append(std::string("c"));
+        logger.json_up();
+        logger.json_up();
+        logger.json_write({ { "stats", { { "time", 1 } } }, { "dry_run", false } });
+
+        nlohmann::json expected = R"({
+            "success": true,
+            "dry_run": false,
+            "stats": { "solvables": 3, "time": 1 },
+            "actions": {
+                "PREFIX": "/prefix",
+                "LINK": [ { "name": "a", "depends": ["b", "c"] }, { "name": "b" } ],
+                "FETCH": [ "c" ]
+            }
+        })"_json;
+        EXPECT_EQ(logger.json_log, expected);
+
+        logger.json_log = nlohmann::json();
+        ctx.json = false;
+    }
+
     class OutputPromptTests : public testing::TestWithParam<std::tuple<std::string, char, bool>>
     {
     };
@@ -399,6 +437,84 @@ namespace mamba
         }
     }
 
+    TEST(link, unlink_packages)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path prefix = tmp_dir.path();
+        fs::create_directories(prefix / "conda-meta");
+        fs::create_directories(prefix / "lib" / "a" / "sub");
+        fs::create_directories(prefix / "lib" / "b");
+        std::ofstream(prefix / "lib" / "a" / "sub" / "f1.txt") << "x";
+        std::ofstream(prefix / "lib" / "a" / "f2.txt") << "x";
+        std::ofstream(prefix / "lib" / "b" / "f3.txt") << "x";
+        std::ofstream(prefix / "lib" / "b" / "other.txt") << "x";
+
+        PackageInfo a("a", "1.0", "0", 0), b("b", "1.0", "0", 0);
+        std::ofstream(prefix / "conda-meta" / "a-1.0-0.json")
+            << R"({"name": "a", "files": ["lib/a/sub/f1.txt", "lib/a/f2.txt"]})";
+        std::ofstream(prefix / "conda-meta" / "b-1.0-0.json")
+            << R"({"name": "b", "files": ["lib/b/f3.txt"]})";
+
+        TransactionContext context(prefix, "");
+        EXPECT_EQ(unlink_packages({ a, b }, &context), 3);
+        EXPECT_FALSE(fs::exists(prefix / "lib" / "a"));
+        EXPECT_FALSE(fs::exists(prefix / "conda-meta" / "a-1.0-0.json"));
+        EXPECT_FALSE(fs::exists(prefix / "conda-meta" / "b-1.0-0.json"));
+        // directories with files from elsewhere are kept
+        EXPECT_TRUE(fs::exists(prefix / "lib" / "b" / "other.txt"));
+        EXPECT_TRUE(fs::exists(prefix / "conda-meta"));
+    }
+
+    TEST(link, clone_packages)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path source = tmp_dir.path() / "src";
+        fs::path target = tmp_dir.path() / "target-prefix";
+        fs::create_directories(source / "conda-meta");
+        fs::create_directories(source / "bin");
+        fs::create_directories(source / "lib");
+
+        std::string placeholder = source.string() + std::string(16, 'p');
+        std::string binary = std::string("head") + '\0' + source.string() + "/lib"
+                             + std::string(placeholder.size() - source.string().size(), '\0')
+                             + '\0' + "tail";
+        std::ofstream(source / "lib" / "libfoo.so", std::ios::binary) << binary;
+        std::ofstream(source / "bin" / "foo") << "#!" << source.string() << "/bin/python\n";
+        std::ofstream(source / "lib" / "data.txt") << "data";
+
+        nlohmann::json record = { { "name", "foo" },
+                                  { "version", "1.0" },
+                                  { "build", "0" },
+                                  { "files", { "lib/libfoo.so", "bin/foo", "lib/data.txt" } } };
+        record["paths_data"]["paths"]
+            = { { { "_path", "lib/libfoo.so" },
+                  { "prefix_placeholder", placeholder },
+                  { "file_mode", "binary" } },
+                { { "_path", "bin/foo" },
+                  { "prefix_placeholder", placeholder },
+                  { "file_mode", "text" } },
+                { { "_path", "lib/data.txt" } } };
+        std::ofstream(source / "conda-meta" / "foo-1.0-0.json") << record.dump();
+
+        TransactionContext context(target, "");
+        EXPECT_EQ(clone_packages(source, { PackageInfo("foo", "1.0", "0", 0) }, &context), 3);
+
+        EXPECT_EQ(fs::hard_link_count(target / "lib" / "data.txt"), 2);
+        EXPECT_EQ(read_contents(target / "bin" / "foo"),
+                  "#!" + target.string() + "/bin/python\n");
+
+        // the longer prefix takes the padding, strings keep their offsets
+        std::string cloned = read_contents(target / "lib" / "libfoo.so", std::ios::binary);
+        ASSERT_EQ(cloned.size(), binary.size());
+        EXPECT_EQ(std::string(cloned.c_str() + 5), target.string() + "/lib");
+        EXPECT_EQ(cloned.substr(cloned.size() - 4), "tail");
+
+        nlohmann::json cloned_record;
+        std::ifstream(target / "conda-meta" / "foo-1.0-0.json") >> cloned_record;
+        EXPECT_EQ(cloned_record["paths_data"]["paths"][0]["sha256_in_prefix"],
+                  validate::sha256sum(target / "lib" / "libfoo.so"));
+    }
+
     TEST(utils, quote_for_shell)
     {
         if (!on_win)
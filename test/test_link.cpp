@@ -0,0 +1,310 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+#include "nlohmann/json.hpp"
+
+#include "mamba/core/link.hpp"
+#include "mamba/core/package_cache.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/prefix_data.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/solver.hpp"
+#include "mamba/core/transaction.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        std::string python_version()
+        {
+            std::string version;
+            FILE* out = popen(
+                "python3 -c 'import sys; print(\"%d.%d.%d\" % sys.version_info[:3])' 2>/dev/null",
+                "r");
+            if (out == nullptr)
+            {
+                return version;
+            }
+            char buffer[64];
+            while (fgets(buffer, sizeof(buffer), out) != nullptr)
+            {
+                version += buffer;
+            }
+            pclose(out);
+            return std::string(strip(version));
+        }
+
+        // Writes an extracted package to the package cache
+        PackageInfo make_package(const fs::path& pkgs_dir,
+                                 const std::string& name,
+                                 const std::map<std::string, std::string>& files,
+                                 const std::vector<std::string>& depends = {},
+                                 const std::string& noarch = "")
+        {
+            PackageInfo pkg(name, "1.0", "0", 0);
+            pkg.depends = depends;
+            fs::path pkg_dir = pkgs_dir / pkg.str();
+            fs::create_directories(pkg_dir / "info");
+
+            nlohmann::json paths;
+            paths["paths_version"] = 1;
+            paths["paths"] = nlohmann::json::array();
+            for (const auto& [path, content] : files)
+            {
+                fs::create_directories((pkg_dir / path).parent_path());
+                std::ofstream(pkg_dir / path) << content;
+                paths["paths"].push_back({ { "_path", path },
+                                           { "path_type", "hardlink" },
+                                           { "size_in_bytes", content.size() } });
+            }
+            std::ofstream(pkg_dir / "info" / "paths.json") << paths.dump(4);
+
+            nlohmann::json record = {
+                { "name", name }, { "version", "1.0" }, { "build", "0" }, { "depends", depends }
+            };
+            if (!noarch.empty())
+            {
+                record["noarch"] = noarch;
+            }
+            std::ofstream(pkg_dir / "info" / "repodata_record.json") << record.dump(4);
+            return pkg;
+        }
+
+        nlohmann::json read_record(const fs::path& prefix, const PackageInfo& pkg)
+        {
+            nlohmann::json record;
+            std::ifstream(prefix / "conda-meta" / (pkg.str() + ".json")) >> record;
+            return record;
+        }
+
+        class LinkTest : public ::testing::Test
+        {
+        protected:
+            LinkTest()
+                : m_pkgs_dir(m_tmp_dir.path() / "pkgs")
+                , m_prefix(m_tmp_dir.path() / "prefix")
+                , m_python_version(python_version())
+            {
+                fs::create_directories(m_pkgs_dir);
+                fs::create_directories(m_prefix / "conda-meta");
+            }
+
+            // The python of the environment forwards to the one of the system
+            TransactionContext make_context()
+            {
+                TransactionContext context(m_prefix, m_python_version);
+                fs::path python = m_prefix / context.python_path;
+                fs::create_directories(python.parent_path());
+                std::ofstream(python) << "#!/bin/sh\nexec python3 \"$@\"\n";
+                fs::permissions(python, fs::perms::owner_all);
+                return context;
+            }
+
+            TemporaryDirectory m_tmp_dir;
+            fs::path m_pkgs_dir, m_prefix;
+            std::string m_python_version;
+        };
+    }
+
+#ifndef _WIN32
+    TEST_F(LinkTest, compile_deferred_pyc_files)
+    {
+        if (m_python_version.empty())
+        {
+            GTEST_SKIP() << "python3 is not available";
+        }
+
+        TransactionContext context = make_context();
+        context.defer_pyc_compilation = true;
+        auto a = make_package(m_pkgs_dir,
+                              "a",
+                              { { "site-packages/a/__init__.py", "x = 1\n" },
+                                { "site-packages/a/mod.py", "def f():\n    return 1\n" } },
+                              {},
+                              "python");
+        auto b = make_package(m_pkgs_dir,
+                              "b",
+                              { { "site-packages/b/__init__.py", "y = 2\n" },
+                                { "site-packages/b/broken.py", "def (:\n" } },
+                              {},
+                              "python");
+        for (const auto& pkg : { a, b })
+        {
+            LinkPackage lp(pkg, m_pkgs_dir, &context);
+            EXPECT_TRUE(lp.execute());
+        }
+        ASSERT_EQ(context.deferred_pyc_files.size(), 2);
+
+        // nothing is compiled until the end of the linking
+        auto failed = compile_deferred_pyc_files(&context);
+        EXPECT_TRUE(context.deferred_pyc_files.empty());
+        EXPECT_EQ(failed, std::vector<std::string>({ b.str() }));
+
+        auto pyc = [&](const std::string& path) {
+            return pyc_path(context.site_packages_path / path, context.short_python_version);
+        };
+        std::vector<fs::path> expected = { pyc("a/__init__.py"), pyc("a/mod.py") };
+        for (const auto& f : expected)
+        {
+            EXPECT_TRUE(fs::exists(m_prefix / f)) << f;
+        }
+        auto files_a = read_record(m_prefix, a)["files"].get<std::vector<std::string>>();
+        for (const auto& f : expected)
+        {
+            EXPECT_NE(std::find(files_a.begin(), files_a.end(), f.string()), files_a.end());
+        }
+
+        // the compiled file of b is still recorded, not the broken one
+        EXPECT_TRUE(fs::exists(m_prefix / pyc("b/__init__.py")));
+        EXPECT_FALSE(fs::exists(m_prefix / pyc("b/broken.py")));
+        auto files_b = read_record(m_prefix, b)["files"].get<std::vector<std::string>>();
+        EXPECT_NE(std::find(files_b.begin(), files_b.end(), pyc("b/__init__.py").string()),
+                  files_b.end());
+        EXPECT_EQ(std::find(files_b.begin(), files_b.end(), pyc("b/broken.py").string()),
+                  files_b.end());
+    }
+
+    TEST_F(LinkTest, deferred_post_link_scripts)
+    {
+        TransactionContext context(m_prefix, "");
+        context.defer_post_link = true;
+        // the scripts log their order, b needs c which is linked after it
+        auto a = make_package(m_pkgs_dir,
+                              "a",
+                              { { "bin/.a-post-link.sh",
+                                  "sleep 1\necho a >> \"$PREFIX/order.txt\"\n" } });
+        auto b = make_package(m_pkgs_dir,
+                              "b",
+                              { { "bin/.b-post-link.sh",
+                                  "test -f \"$PREFIX/lib/c.txt\" || exit 1\n"
+                                  "echo b >> \"$PREFIX/order.txt\"\n" } },
+                              { "a" });
+        auto c = make_package(m_pkgs_dir,
+                              "c",
+                              { { "lib/c.txt", "c" },
+                                { "bin/.c-post-link.sh", "echo c >> \"$PREFIX/order.txt\"\n" } },
+                              { "b >=1.0" });
+        for (const auto& pkg : { a, b, c })
+        {
+            LinkPackage lp(pkg, m_pkgs_dir, &context);
+            EXPECT_TRUE(lp.execute());
+        }
+        EXPECT_FALSE(fs::exists(m_prefix / "order.txt"));
+        ASSERT_EQ(context.deferred_post_link.size(), 3);
+
+        run_deferred_post_link_scripts(&context);
+        EXPECT_TRUE(context.deferred_post_link.empty());
+        std::ifstream order(m_prefix / "order.txt");
+        EXPECT_EQ(std::string(std::istreambuf_iterator<char>(order), {}), "a\nb\nc\n");
+    }
+
+    TEST_F(LinkTest, deferred_post_link_scripts_failure)
+    {
+        TransactionContext context(m_prefix, "");
+        context.defer_post_link = true;
+        auto a = make_package(m_pkgs_dir, "a", { { "bin/.a-post-link.sh", "exit 1\n" } });
+        auto b = make_package(m_pkgs_dir,
+                              "b",
+                              { { "bin/.b-post-link.sh", "touch \"$PREFIX/b.txt\"\n" } },
+                              { "a" });
+        auto x = make_package(m_pkgs_dir,
+                              "x",
+                              { { "bin/.x-post-link.sh", "touch \"$PREFIX/x.txt\"\n" } });
+        for (const auto& pkg : { a, b, x })
+        {
+            LinkPackage lp(pkg, m_pkgs_dir, &context);
+            EXPECT_TRUE(lp.execute());
+        }
+
+        // the dependent script is not run, the independent one is
+        auto failed = run_deferred_post_link_scripts(&context);
+        EXPECT_EQ(failed, std::vector<std::string>({ a.str(), b.str() }));
+        EXPECT_FALSE(fs::exists(m_prefix / "b.txt"));
+        EXPECT_TRUE(fs::exists(m_prefix / "x.txt"));
+        EXPECT_TRUE(context.deferred_post_link.empty());
+    }
+
+    TEST_F(LinkTest, transaction_with_failing_post_link)
+    {
+        std::ofstream(m_tmp_dir.path() / "repodata.json") << R"({
+            "info": { "subdir": "linux-64" },
+            "packages": {
+                "a-1.0-0.tar.bz2": {
+                    "build": "0", "build_number": 0, "depends": [], "name": "a",
+                    "version": "1.0", "subdir": "linux-64", "size": 1,
+                    "md5": "0123456789abcdef0123456789abcdef"
+                }
+            }
+        })";
+        MPool pool;
+        MRepo repo(pool,
+                   "channel",
+                   m_tmp_dir.path() / "repodata.json",
+                   { "https://conda.anaconda.org/channel/linux-64/repodata.json", false, "", "" });
+        MSolver solver(pool);
+        solver.add_jobs({ "a" }, SOLVER_INSTALL);
+        ASSERT_TRUE(solver.solve());
+
+        // the package is in the cache, with the record of its solvable
+        auto pkg = make_package(m_pkgs_dir,
+                                "a",
+                                { { "lib/a.txt", "a" }, { "bin/.a-post-link.sh", "exit 1\n" } });
+        Id p;
+        Solvable* s;
+        FOR_REPO_SOLVABLES(repo.repo(), p, s)
+        {
+            std::ofstream(m_pkgs_dir / pkg.str() / "info" / "repodata_record.json")
+                << PackageInfo(s).json().dump(4);
+        }
+
+        // the failing script is reported, the transaction is complete
+        MultiPackageCache caches({ m_pkgs_dir });
+        MTransaction transaction(solver, caches, m_pkgs_dir.string());
+        PrefixData prefix(m_prefix);
+        EXPECT_TRUE(transaction.execute(prefix));
+        EXPECT_TRUE(fs::exists(m_prefix / "lib" / "a.txt"));
+        EXPECT_TRUE(fs::exists(m_prefix / "conda-meta" / (pkg.str() + ".json")));
+        auto history = read_lines(m_prefix / "conda-meta" / "history");
+        EXPECT_NE(std::find(history.begin(),
+                            history.end(),
+                            "+https://conda.anaconda.org/channel/linux-64::a-1.0-0"),
+                  history.end());
+    }
+#endif
+
+    TEST_F(LinkTest, clone_packages_failure)
+    {
+        // the binary file can't hold the longer prefix, nothing is left behind
+        fs::path source = m_tmp_dir.path() / "src";
+        std::string binary = std::string("x\0", 2) + source.string() + std::string("/lib\0y", 6);
+        fs::create_directories(source / "conda-meta");
+        fs::create_directories(source / "lib" / "sub");
+        std::ofstream(source / "lib" / "sub" / "a.txt") << "a";
+        std::ofstream(source / "lib" / "b.bin", std::ios::binary) << binary;
+
+        PackageInfo a("a", "1.0", "0", 0), b("b", "1.0", "0", 0);
+        nlohmann::json record_a = { { "name", "a" }, { "files", { "lib/sub/a.txt" } } };
+        nlohmann::json record_b
+            = { { "name", "b" },
+                { "paths_data",
+                  { { "paths",
+                      { { { "_path", "lib/b.bin" },
+                          { "path_type", "hardlink" },
+                          { "file_mode", "binary" },
+                          { "prefix_placeholder", source.string() } } } } } } };
+        std::ofstream(source / "conda-meta" / (a.str() + ".json")) << record_a.dump(4);
+        std::ofstream(source / "conda-meta" / (b.str() + ".json")) << record_b.dump(4);
+
+        TransactionContext context(m_prefix, "");
+        EXPECT_THROW(clone_packages(source, { a, b }, &context), std::runtime_error);
+        EXPECT_FALSE(fs::exists(m_prefix / "lib"));
+        EXPECT_TRUE(fs::is_empty(m_prefix / "conda-meta"));
+
+        // the files of the source prefix are untouched
+        EXPECT_TRUE(fs::exists(source / "lib" / "sub" / "a.txt"));
+        EXPECT_EQ(read_contents(source / "lib" / "b.bin", std::ios::in | std::ios::binary),
+                  binary);
+    }
+}  // namespace mamba
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "mamba/core/log_sink.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    TEST(log_sink, log_file)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path log_file = tmp_dir.path() / "mamba.log";
+        LogSink sink;
+        sink.set_stderr(false);
+        sink.set_log_file(log_file);
+
+        sink.push(LogSeverity::kInfo, "first");
+        sink.push(LogSeverity::kWarning, "second");
+        sink.flush();
+        EXPECT_EQ(read_lines(log_file),
+                  std::vector<std::string>({ "INFO    first", "WARNING second" }));
+
+        // written directly once stopped
+        sink.stop();
+        sink.push(LogSeverity::kError, "third");
+        sink.flush();
+        EXPECT_EQ(read_lines(log_file).back(), "ERROR   third");
+    }
+
+    TEST(log_sink, producers)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path log_file = tmp_dir.path() / "mamba.log";
+        std::size_t n_threads = 4, n_messages = 20000;
+        {
+            LogSink sink(16);
+            sink.set_stderr(false);
+            sink.set_log_file(log_file);
+
+            std::vector<std::thread> producers;
+            for (std::size_t t = 0; t < n_threads; ++t)
+            {
+                producers.emplace_back([&sink, t, n_messages]() {
+                    for (std::size_t i = 0; i < n_messages; ++i)
+                    {
+                        sink.push(LogSeverity::kDebug, concat(std::to_string(t), " message"));
+                    }
+                    sink.push(LogSeverity::kError, concat(std::to_string(t), " done"));
+                });
+            }
+            for (auto& producer : producers)
+            {
+                producer.join();
+            }
+            sink.flush();
+
+            // the messages are either written, whole, or counted as dropped
+            std::size_t written = 0, done = 0;
+            for (const auto& line : read_lines(log_file))
+            {
+                if (ends_with(line, " message"))
+                {
+                    EXPECT_TRUE(starts_with(line, "DEBUG   "));
+                    ++written;
+                }
+                else if (ends_with(line, " done"))
+                {
+                    ++done;
+                }
+                else
+                {
+                    EXPECT_TRUE(ends_with(line, "log messages dropped"));
+                }
+            }
+            EXPECT_EQ(written + sink.dropped(), n_threads * n_messages);
+            EXPECT_EQ(done, n_threads);
+        }
+    }
+
+    TEST(log_sink, error_after_queued_records)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path log_file = tmp_dir.path() / "mamba.log";
+        LogSink sink(4);
+        sink.set_stderr(false);
+        sink.set_log_file(log_file);
+
+        // the errors written directly when the ring is full come after the
+        // records already in the ring
+        for (int i = 0; i < 100; ++i)
+        {
+            for (int j = 0; j < 8; ++j)
+            {
+                sink.push(LogSeverity::kInfo, concat(std::to_string(i), " queued"));
+            }
+            sink.push(LogSeverity::kError, concat(std::to_string(i), " error"));
+        }
+        sink.flush();
+
+        int last_error = -1;
+        for (const auto& line : read_lines(log_file))
+        {
+            int round = std::atoi(line.substr(8).c_str());
+            if (ends_with(line, " queued"))
+            {
+                EXPECT_GT(round, last_error) << line;
+            }
+            else if (ends_with(line, " error"))
+            {
+                EXPECT_EQ(round, last_error + 1) << line;
+                last_error = round;
+            }
+        }
+        EXPECT_EQ(last_error, 99);
+    }
+
+    TEST(log_sink, push_during_stop)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path log_file = tmp_dir.path() / "mamba.log";
+        std::size_t n_threads = 4, n_messages = 2000;
+        LogSink sink(1 << 16);
+        sink.set_stderr(false);
+        sink.set_log_file(log_file);
+
+        // no record is left in the ring by a push racing with stop()
+        std::vector<std::thread> producers;
+        for (std::size_t t = 0; t < n_threads; ++t)
+        {
+            producers.emplace_back([&sink, n_messages]() {
+                for (std::size_t i = 0; i < n_messages; ++i)
+                {
+                    sink.push(LogSeverity::kInfo, "message");
+                }
+            });
+        }
+        sink.stop();
+        for (auto& producer : producers)
+        {
+            producer.join();
+        }
+        sink.flush();
+        EXPECT_EQ(sink.dropped(), 0);
+        EXPECT_EQ(read_lines(log_file).size(), n_threads * n_messages);
+    }
+}  // namespace mamba
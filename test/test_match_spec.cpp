@@ -0,0 +1,254 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <regex>
+
+#include "mamba/core/match_spec.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        // MatchSpec::parse as it was with std::regex, without the package
+        // files which do not go through the tokenizer
+        MatchSpec regex_parse(const std::string& spec)
+        {
+            MatchSpec ms;
+            ms.spec = spec;
+            std::string spec_str = spec;
+
+            std::size_t idx = spec_str.find('#');
+            if (idx != std::string::npos)
+            {
+                spec_str = spec_str.substr(0, idx);
+            }
+            spec_str = strip(spec_str);
+
+            auto extract_kv = [&spec_str](const std::string& kv_string, auto& map) {
+                static std::regex kv_re(
+                    "([a-zA-Z0-9_-]+?)=([\"\']?)([^\'\"]*?)(\\2)(?:[\'\", ]|$)");
+                std::cmatch kv_match;
+                const char* text_iter = kv_string.c_str();
+
+                while (std::regex_search(text_iter, kv_match, kv_re))
+                {
+                    auto key = kv_match[1].str();
+                    auto value = kv_match[3].str();
+                    if (key.size() == 0 || value.size() == 0)
+                    {
+                        throw std::runtime_error("key-value mismatch in brackets " + spec_str);
+                    }
+                    text_iter += kv_match.position() + kv_match.length();
+                    map[key] = value;
+                }
+            };
+
+            std::smatch match;
+            static std::regex brackets_re(".*(?:(\\[.*\\]))");
+            if (std::regex_search(spec_str, match, brackets_re))
+            {
+                auto brackets_str = match[1].str();
+                brackets_str = brackets_str.substr(1, brackets_str.size() - 2);
+                extract_kv(brackets_str, ms.brackets);
+                spec_str.erase(match.position(1), match.length(1));
+            }
+
+            static std::regex parens_re(".*(?:(\\(.*\\)))");
+            if (std::regex_search(spec_str, match, parens_re))
+            {
+                auto parens_str = match[1].str();
+                parens_str = parens_str.substr(1, parens_str.size() - 2);
+                extract_kv(parens_str, ms.parens);
+                if (parens_str.find("optional") != parens_str.npos)
+                {
+                    ms.optional = true;
+                }
+                spec_str.erase(match.position(1), match.length(1));
+            }
+
+            auto m5 = rsplit(spec_str, ":", 2);
+            if (m5.size() == 3)
+            {
+                ms.channel = m5[0];
+                ms.ns = m5[1];
+                spec_str = m5[2];
+            }
+            else if (m5.size() == 2)
+            {
+                ms.ns = m5[0];
+                spec_str = m5[1];
+            }
+            else
+            {
+                spec_str = m5[0];
+            }
+
+            if (spec_str.back() == '=')
+            {
+                spec_str.push_back('*');
+            }
+            static std::regex version_build_re("([^ =<>!~]+)?([><!=~ ].+)?");
+            std::smatch vb_match;
+            if (std::regex_match(spec_str, vb_match, version_build_re))
+            {
+                ms.name = vb_match[1].str();
+                ms.version = strip(vb_match[2].str());
+                if (ms.name.size() == 0)
+                {
+                    throw std::runtime_error("Invalid spec, no package name found: " + spec_str);
+                }
+            }
+            else
+            {
+                throw std::runtime_error("Invalid spec, no package name found: " + spec_str);
+            }
+
+            if (!ms.version.empty())
+            {
+                if (ms.version.find("[") != ms.version.npos)
+                {
+                    throw std::runtime_error(
+                        "Invalid match spec: multiple bracket sections not allowed " + spec);
+                }
+
+                auto [pv, pb] = MatchSpec::parse_version_and_build(std::string(strip(ms.version)));
+                ms.version = pv;
+                ms.build = pb;
+
+                if (ms.version.size() >= 2 && ms.version[0] == '=')
+                {
+                    auto rest = ms.version.substr(1);
+                    if (ms.version[1] == '=' && ms.build.empty())
+                    {
+                        ms.version = ms.version.substr(2);
+                    }
+                    else if (rest.find_first_of("=,|") == rest.npos)
+                    {
+                        if (ms.build.empty() && ms.version.back() != '*')
+                        {
+                            ms.version = concat(ms.version, "*");
+                        }
+                        else
+                        {
+                            ms.version = rest;
+                        }
+                    }
+                }
+            }
+
+            for (auto& [k, v] : ms.brackets)
+            {
+                if (k == "build_number")
+                    ms.build_number = v;
+                else if (k == "build")
+                    ms.build = v;
+                else if (k == "version")
+                    ms.version = v;
+                else if (k == "channel")
+                    ms.channel = v;
+                else if (k == "subdir")
+                    ms.subdir = v;
+                else if (k == "url")
+                {
+                    ms.is_file = true;
+                    ms.url = v;
+                }
+                else if (k == "fn")
+                {
+                    ms.is_file = true;
+                    ms.fn = v;
+                }
+            }
+            return ms;
+        }
+
+        // the parsed fields, or the error
+        std::string parsed(const std::string& spec, bool with_regex)
+        {
+            try
+            {
+                MatchSpec ms = with_regex ? regex_parse(spec) : MatchSpec(spec);
+                std::map<std::string, std::string> brackets(ms.brackets.begin(),
+                                                            ms.brackets.end());
+                std::map<std::string, std::string> parens(ms.parens.begin(), ms.parens.end());
+                std::stringstream s;
+                s << ms.name << "|" << ms.version << "|" << ms.build << "|" << ms.channel << "|"
+                  << ms.ns << "|" << ms.subdir << "|" << ms.fn << "|" << ms.url << "|"
+                  << ms.build_number << "|" << ms.is_file << "|" << ms.optional;
+                for (const auto& [k, v] : brackets)
+                {
+                    s << "|[" << k << "=" << v << "]";
+                }
+                for (const auto& [k, v] : parens)
+                {
+                    s << "|(" << k << "=" << v << ")";
+                }
+                return s.str();
+            }
+            catch (const std::exception& e)
+            {
+                return std::string("error: ") + e.what();
+            }
+        }
+    }
+
+    TEST(match_spec, same_as_regex)
+    {
+        std::vector<std::string> specs = {
+            "python >=3.6,<3.7.0a0",
+            "numpy 1.19.*",
+            "libblas=*=*mkl",
+            "libblas=[build=*mkl]",
+            "conda-forge::xtensor==0.21.5=h4bd325d_0",
+            "conda-forge/linux-64::python=3.9[build_number=1]",
+            "pytorch[version='>=1.8', build=\"*cuda*\"]",
+            "scipy[version=1.5.2,build=py38h8c5af15_0, channel=conda-forge]",
+            "_openmp_mutex >=4.5",
+            "libgcc-ng>=9.3.0",
+            "python_abi 3.9.* *_cp39",
+            "openssl !=1.1.1e",
+            "ca-certificates",
+            "foo (optional)",
+            "foo (target=blarg,optional)",
+            "foo[build=' ']",
+            "foo[build=\"bar']",
+            "foo[build=]",
+            "foo[a=b=c, d='e f']",
+            "foo[ =x, -=y]",
+            "foo[a=1][b=2]",
+            "foo[a=1]\n[b=2]",
+            "foo\r[a=1]",
+            "foo =",
+            "foo ==",
+            "foo >=1.0 # comment",
+            "foo 1.0|2.0 py_0",
+            "foo~=1.0",
+        };
+
+        std::mt19937 rng(42);
+        const std::vector<std::string> tokens
+            = { "numpy", "py",  "-",     "_",  "1.2",   "3",   "*",     " ",  "  ", "=",
+                "==",    ">=",  "<",     "!=", "~=",    ",",   "|",     "[",  "]",  "(",
+                ")",     "'",   "\"",    "a=", "build", "=b",  "k=v",   "\n", "\r", "#",
+                "optional", "version=", "channel=", "subdir=", "build_number=", "fn=", "url=" };
+        std::uniform_int_distribution<std::size_t> token(0, tokens.size() - 1);
+        std::uniform_int_distribution<int> length(1, 12);
+        for (int i = 0; i < 20000; ++i)
+        {
+            // always starting with a name, the former parser read an empty
+            // string when it was stripped
+            std::string spec = i % 4 == 0 ? "conda-forge::numpy" : "numpy";
+            for (int n = length(rng); n > 0; --n)
+            {
+                spec += tokens[token(rng)];
+            }
+            specs.push_back(spec);
+        }
+
+        for (const auto& spec : specs)
+        {
+            EXPECT_EQ(parsed(spec, false), parsed(spec, true)) << spec;
+        }
+    }
+}  // namespace mamba
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "mamba/core/metrics.hpp"
+#include "mamba/core/package_cache.hpp"
+#include "mamba/core/package_handling.hpp"
+#include "mamba/core/transaction.hpp"
+#include "mamba/core/util.hpp"
+#include "mamba/core/validate.hpp"
+
+namespace mamba
+{
+    TEST(metrics, counters)
+    {
+        auto& metrics = Metrics::instance();
+        std::size_t linked_files = metrics.linked_files;
+        std::int64_t link_time = metrics.link_time;
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < 4; ++i)
+        {
+            workers.emplace_back([&metrics]() {
+                for (int j = 0; j < 1000; ++j)
+                {
+                    MetricsTimer timer(metrics.link_time);
+                    ++metrics.linked_files;
+                }
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        EXPECT_EQ(metrics.linked_files - linked_files, 4000);
+        EXPECT_GT(metrics.link_time, link_time);
+        EXPECT_GT(peak_rss(), 0);
+    }
+
+    TEST(metrics, downloads_per_host)
+    {
+        auto& metrics = Metrics::instance();
+        metrics.add_download("https://metrics.test/channel/noarch/repodata.json", 1000, 500);
+        metrics.add_download("https://metrics.test/channel/noarch/pkg.tar.bz2", 3000, 1000);
+        metrics.add_download("https://other.metrics.test/pkg.tar.bz2", 10, 0);
+
+        auto j = metrics.json();
+        auto host = j["downloads"]["metrics.test"];
+        EXPECT_EQ(host["count"], 2);
+        EXPECT_EQ(host["bytes"], 4000);
+        EXPECT_DOUBLE_EQ(host["seconds"].get<double>(), 5.);
+        EXPECT_EQ(j["downloads"]["other.metrics.test"]["bytes"], 10);
+        EXPECT_TRUE(j["repodata_cache"].contains("hits"));
+        EXPECT_TRUE(j["link"].contains("files"));
+
+        std::string text = metrics.prometheus();
+        EXPECT_NE(text.find("# TYPE mamba_download_bytes_total counter\n"), std::string::npos);
+        EXPECT_NE(text.find("mamba_download_bytes_total{host=\"metrics.test\"} 4000\n"),
+                  std::string::npos);
+        EXPECT_NE(text.find("\nmamba_peak_rss_bytes "), std::string::npos);
+    }
+
+    TEST(metrics, metrics_file)
+    {
+        TemporaryDirectory tmp_dir;
+        auto& metrics = Metrics::instance();
+
+        fs::path json_file = tmp_dir.path() / "metrics.json";
+        metrics.start(json_file);
+        metrics.stop();
+        nlohmann::json j;
+        std::ifstream(json_file) >> j;
+        EXPECT_TRUE(j.contains("peak_rss"));
+
+        fs::path prom_file = tmp_dir.path() / "metrics.prom";
+        metrics.start(prom_file);
+        metrics.stop();
+        std::stringstream text;
+        text << std::ifstream(prom_file).rdbuf();
+        EXPECT_TRUE(starts_with(text.str(), "# HELP mamba_downloads_total"));
+        EXPECT_NE(text.str().find("\nmamba_linked_files_total "), std::string::npos);
+
+        // written once
+        fs::remove(prom_file);
+        metrics.stop();
+        EXPECT_FALSE(fs::exists(prom_file));
+    }
+
+    TEST(metrics, package_cache_tarball_hit)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path pkgs_dir = tmp_dir.path() / "pkgs";
+        fs::path pkg_dir = tmp_dir.path() / "a-1.0-0";
+        fs::create_directories(pkgs_dir);
+        fs::create_directories(pkg_dir / "info");
+        std::ofstream(pkg_dir / "info" / "index.json")
+            << R"({ "name": "a", "version": "1.0", "build": "0" })";
+        create_package(pkg_dir, pkgs_dir / "a-1.0-0.tar.bz2", 1);
+
+        // only the tarball is in the writable cache, it is extracted
+        PackageInfo pkg("a", "1.0", "0", 0);
+        pkg.fn = "a-1.0-0.tar.bz2";
+        pkg.url = "https://metrics.test/channel/noarch/a-1.0-0.tar.bz2";
+        pkg.md5 = validate::md5sum((pkgs_dir / pkg.fn).string());
+        MultiPackageCache caches({ pkgs_dir });
+
+        auto& metrics = Metrics::instance();
+        std::size_t hits = metrics.package_cache_hits;
+        std::size_t misses = metrics.package_cache_misses;
+        PackageDownloadExtractTarget target(pkg);
+        EXPECT_EQ(target.target(pkgs_dir, caches), nullptr);
+        while (!target.finished())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_TRUE(fs::exists(pkgs_dir / "a-1.0-0" / "info" / "repodata_record.json"));
+        EXPECT_EQ(metrics.package_cache_hits - hits, 1);
+        EXPECT_EQ(metrics.package_cache_misses, misses);
+    }
+}  // namespace mamba
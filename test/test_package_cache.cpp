@@ -0,0 +1,264 @@
+#include <gtest/gtest.h>
+
+#include "nlohmann/json.hpp"
+
+#include "mamba/core/context.hpp"
+#include "mamba/core/package_cache.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        void make_package(const fs::path& pkgs_dir, const std::string& name, std::size_t size)
+        {
+            fs::create_directories(pkgs_dir / name / "info");
+            std::ofstream(pkgs_dir / name / "info" / "index.json") << "{}";
+            std::ofstream(pkgs_dir / name / "data") << std::string(size, 'x');
+        }
+
+        void make_env_record(const fs::path& prefix, const std::string& name)
+        {
+            fs::create_directories(prefix / "conda-meta");
+            std::ofstream(prefix / "conda-meta" / (name + ".json")) << "{}";
+        }
+
+        void make_record(const fs::path& pkgs_dir,
+                         const std::string& name,
+                         const std::string& sha256)
+        {
+            fs::create_directories(pkgs_dir / name / "info");
+            nlohmann::json record = { { "fn", name + ".tar.bz2" },
+                                      { "url", "https://conda.anaconda.org/conda-forge/" + name },
+                                      { "sha256", sha256 },
+                                      { "size", 10 } };
+            std::ofstream(pkgs_dir / name / "info" / "repodata_record.json") << record.dump();
+        }
+
+        PackageInfo make_package_info(const std::string& name, const std::string& sha256)
+        {
+            PackageInfo pkg(name, "1.0", "0", 0);
+            pkg.fn = name + "-1.0-0.tar.bz2";
+            pkg.url = "https://conda.anaconda.org/conda-forge/" + pkg.fn;
+            pkg.sha256 = sha256;
+            pkg.size = 10;
+            return pkg;
+        }
+
+        // An extracted package matching make_package_info(name, sha256)
+        void make_extracted(const fs::path& pkgs_dir,
+                            const std::string& name,
+                            const std::string& sha256)
+        {
+            PackageInfo pkg = make_package_info(name, sha256);
+            fs::path info = pkgs_dir / (name + "-1.0-0") / "info";
+            fs::create_directories(info);
+            nlohmann::json record = { { "fn", pkg.fn },
+                                      { "url", pkg.url },
+                                      { "sha256", sha256 },
+                                      { "size", pkg.size } };
+            std::ofstream(info / "repodata_record.json") << record.dump();
+            std::ofstream(info / "paths.json") << R"({"paths": [], "paths_version": 1})";
+        }
+
+        class PackageCacheUsageTest : public ::testing::Test
+        {
+        protected:
+            PackageCacheUsageTest()
+                : m_root_prefix(Context::instance().root_prefix)
+                , m_envs_dirs(Context::instance().envs_dirs)
+            {
+                Context::instance().root_prefix = m_tmp_dir.path() / "root";
+                Context::instance().envs_dirs = { m_tmp_dir.path() / "root" / "envs" };
+                m_pkgs_dir = m_tmp_dir.path() / "pkgs";
+                m_prefix = m_tmp_dir.path() / "root" / "envs" / "env";
+                fs::create_directories(m_pkgs_dir);
+            }
+
+            ~PackageCacheUsageTest()
+            {
+                Context::instance().root_prefix = m_root_prefix;
+                Context::instance().envs_dirs = m_envs_dirs;
+            }
+
+            TemporaryDirectory m_tmp_dir;
+            fs::path m_pkgs_dir, m_prefix;
+            fs::path m_root_prefix;
+            std::vector<fs::path> m_envs_dirs;
+        };
+    }
+
+    TEST_F(PackageCacheUsageTest, seed_and_persist)
+    {
+        make_package(m_pkgs_dir, "a-1.0-0", 100);
+        make_package(m_pkgs_dir, "b-1.0-0", 100);
+        make_env_record(m_prefix, "a-1.0-0");
+
+        {
+            // no index yet, environments are scanned
+            PackageCacheUsage usage(m_pkgs_dir);
+            usage.load();
+            usage.scan();
+            EXPECT_EQ(usage.entries().at("a-1.0-0").prefixes.size(), 1);
+            EXPECT_TRUE(usage.entries().at("b-1.0-0").prefixes.empty());
+            usage.record_link("b-1.0-0", m_prefix);
+            usage.save();
+        }
+
+        make_env_record(m_prefix, "b-1.0-0");
+        PackageCacheUsage usage(m_pkgs_dir);
+        usage.load();
+        usage.scan();
+        EXPECT_EQ(usage.entries().at("b-1.0-0").prefixes.size(), 1);
+        EXPECT_GE(usage.entries().at("b-1.0-0").size, 100);
+
+        // removed environments do not keep packages alive
+        fs::remove_all(m_prefix);
+        usage.scan();
+        EXPECT_TRUE(usage.entries().at("a-1.0-0").prefixes.empty());
+        EXPECT_TRUE(usage.entries().at("b-1.0-0").prefixes.empty());
+    }
+
+    TEST_F(PackageCacheUsageTest, lru_candidates)
+    {
+        make_package(m_pkgs_dir, "a-1.0-0", 1000);
+        make_package(m_pkgs_dir, "b-1.0-0", 1000);
+        make_package(m_pkgs_dir, "c-1.0-0", 1000);
+        make_env_record(m_prefix, "c-1.0-0");
+        fs::last_write_time(m_pkgs_dir / "b-1.0-0",
+                            fs::file_time_type::clock::now() - std::chrono::hours(1));
+
+        PackageCacheUsage usage(m_pkgs_dir);
+        usage.load();
+        usage.record_link("c-1.0-0", m_prefix);
+        usage.record_link("a-1.0-0", m_prefix);
+        usage.record_unlink("a-1.0-0", m_prefix);
+        usage.scan();
+
+        // b was never used, a is more recent
+        std::size_t total = usage.total_size();
+        EXPECT_TRUE(usage.lru_candidates(total).empty());
+        EXPECT_EQ(usage.lru_candidates(total - 1), std::vector<std::string>({ "b-1.0-0" }));
+        EXPECT_EQ(usage.lru_candidates(0), std::vector<std::string>({ "b-1.0-0", "a-1.0-0" }));
+
+        usage.remove_package("b-1.0-0");
+        EXPECT_FALSE(fs::exists(m_pkgs_dir / "b-1.0-0"));
+        EXPECT_EQ(usage.entries().count("b-1.0-0"), 0);
+    }
+
+    TEST(package_cache_manifest, build_and_load)
+    {
+        TemporaryDirectory tmp_dir;
+        make_record(tmp_dir.path(), "a-1.0-0", "aaaa");
+        make_record(tmp_dir.path(), "b-1.0-0", "");
+        fs::create_directories(tmp_dir.path() / "c-1.0-0");
+
+        PackageCacheManifest manifest(tmp_dir.path());
+        EXPECT_FALSE(manifest.load());
+        manifest.build();
+        manifest.save();
+
+        // packages without checksum cannot be looked up
+        PackageCacheManifest loaded(tmp_dir.path());
+        EXPECT_TRUE(loaded.load());
+        EXPECT_EQ(loaded.size(), 1);
+        ASSERT_NE(loaded.find("a-1.0-0"), nullptr);
+        EXPECT_EQ(loaded.find("a-1.0-0")->fn, "a-1.0-0.tar.bz2");
+
+        EXPECT_TRUE(loaded.contains(make_package_info("a", "aaaa")));
+        EXPECT_FALSE(loaded.contains(make_package_info("a", "bbbb")));
+        EXPECT_FALSE(loaded.contains(make_package_info("b", "")));
+    }
+
+    TEST(package_cache_manifest, readonly_layer)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path local = tmp_dir.path() / "local";
+        fs::path layer = tmp_dir.path() / "layer";
+        make_record(layer, "a-1.0-0", "aaaa");
+        PackageCacheManifest manifest(layer);
+        manifest.build();
+        manifest.save();
+
+        // lookups only use the manifest
+        fs::remove_all(layer / "a-1.0-0");
+
+        auto readonly_pkgs_dirs = Context::instance().readonly_pkgs_dirs;
+        Context::instance().readonly_pkgs_dirs = { layer };
+        MultiPackageCache caches({ local });
+        Context::instance().readonly_pkgs_dirs = readonly_pkgs_dirs;
+
+        EXPECT_EQ(caches.first_cache_path(make_package_info("a", "aaaa")), layer);
+        EXPECT_TRUE(caches.first_cache_path(make_package_info("b", "bbbb")).empty());
+        for (auto* c : caches.writable_caches())
+        {
+            EXPECT_FALSE(c->is_read_only());
+        }
+    }
+
+    TEST(multi_package_cache, batched_query)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path batched = tmp_dir.path() / "batched";
+        fs::path serial = tmp_dir.path() / "serial";
+        for (const auto& pkgs_dir : { batched, serial })
+        {
+            make_extracted(pkgs_dir, "a", "aaaa");
+            make_extracted(pkgs_dir, "b", "aaaa");
+        }
+        // a is valid, b has a wrong checksum and d is missing
+        std::vector<PackageInfo> pkgs = { make_package_info("a", "aaaa"),
+                                          make_package_info("b", "bbbb"),
+                                          make_package_info("d", "dddd"),
+                                          make_package_info("a", "aaaa") };
+
+        MultiPackageCache batched_caches({ batched });
+        MultiPackageCache serial_caches({ serial });
+        auto res = batched_caches.query(pkgs);
+        ASSERT_EQ(res.size(), pkgs.size());
+        for (std::size_t i = 0; i < pkgs.size(); ++i)
+        {
+            auto expected = serial_caches.query(pkgs[i]);
+            EXPECT_EQ(res[i].empty(), expected.empty()) << pkgs[i].str();
+            // the query cache is filled the same way
+            EXPECT_EQ(batched_caches.query(pkgs[i]).empty(), expected.empty());
+        }
+        EXPECT_EQ(res[0], batched);
+        EXPECT_TRUE(res[1].empty());
+        EXPECT_TRUE(res[2].empty());
+        EXPECT_EQ(res[3], batched);
+        // the invalid package was removed in both
+        EXPECT_FALSE(fs::exists(batched / "b-1.0-0"));
+        EXPECT_FALSE(fs::exists(serial / "b-1.0-0"));
+    }
+
+#ifndef _WIN32
+    TEST(multi_package_cache, batched_query_error)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path pkgs_dir = tmp_dir.path();
+        make_extracted(pkgs_dir, "a", "aaaa");
+        make_extracted(pkgs_dir, "b", "aaaa");
+        make_extracted(pkgs_dir, "c", "cccc");
+
+        // the invalid b cannot be removed
+        fs::path locked = pkgs_dir / "b-1.0-0" / "info";
+        fs::permissions(locked, fs::perms::owner_read | fs::perms::owner_exec);
+        bool enforced = !std::ofstream(locked / "probe");
+        if (enforced)
+        {
+            MultiPackageCache caches({ pkgs_dir });
+            EXPECT_THROW(caches.query(make_package_info("b", "bbbb")), std::runtime_error);
+
+            MultiPackageCache batched_caches({ pkgs_dir });
+            auto res = batched_caches.query({ make_package_info("a", "aaaa"),
+                                              make_package_info("b", "bbbb"),
+                                              make_package_info("c", "cccc") });
+            EXPECT_EQ(res[0], pkgs_dir);
+            EXPECT_TRUE(res[1].empty());
+            EXPECT_EQ(res[2], pkgs_dir);
+        }
+        fs::permissions(locked, fs::perms::owner_all);
+    }
+#endif
+}  // namespace mamba
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include "mamba/core/package_handling.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        fs::path make_package_dir(const fs::path& root)
+        {
+            fs::path pkg_dir = root / "pkg";
+            fs::create_directories(pkg_dir / "info");
+            fs::create_directories(pkg_dir / "lib");
+            std::ofstream(pkg_dir / "info" / "index.json") << "{\"name\": \"pkg\"}";
+            std::ofstream(pkg_dir / "lib" / "data.txt") << std::string(100000, 'x');
+            fs::create_symlink("data.txt", pkg_dir / "lib" / "link.txt");
+            return pkg_dir;
+        }
+
+        std::string read_file(const fs::path& p)
+        {
+            std::ifstream f(p);
+            return std::string(std::istreambuf_iterator<char>(f), {});
+        }
+    }
+
+    TEST(package_handling, create_and_extract)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path pkg_dir = make_package_dir(tmp_dir.path());
+
+        for (std::string ext : { ".tar.bz2", ".conda" })
+        {
+            fs::path pkg_file = tmp_dir.path() / ("pkg-1.0-0" + ext);
+            create_package(pkg_dir, pkg_file, 1, 2);
+            fs::path extracted = extract(pkg_file);
+
+            EXPECT_EQ(read_file(extracted / "info" / "index.json"), "{\"name\": \"pkg\"}");
+            EXPECT_EQ(read_file(extracted / "lib" / "data.txt"), std::string(100000, 'x'));
+            EXPECT_TRUE(fs::is_symlink(extracted / "lib" / "link.txt"));
+            EXPECT_EQ(fs::read_symlink(extracted / "lib" / "link.txt"), "data.txt");
+            fs::remove_all(extracted);
+        }
+    }
+
+    TEST(package_handling, transmute_many)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path pkg_dir = make_package_dir(tmp_dir.path());
+
+        std::vector<std::pair<fs::path, fs::path>> pkgs;
+        for (std::string name : { "a-1.0-0", "b-1.0-0", "c-1.0-0" })
+        {
+            fs::path source = tmp_dir.path() / (name + ".tar.bz2");
+            create_package(pkg_dir, source, 1);
+            pkgs.emplace_back(source, tmp_dir.path() / (name + ".conda"));
+        }
+
+        EXPECT_TRUE(transmute(pkgs, 1, 1, 2));
+        for (const auto& [source, target] : pkgs)
+        {
+            fs::path extracted = extract(target);
+            EXPECT_EQ(read_file(extracted / "lib" / "data.txt"), std::string(100000, 'x'));
+        }
+    }
+}  // namespace mamba
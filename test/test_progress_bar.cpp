@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "mamba/core/context.hpp"
+#include "mamba/core/output.hpp"
+#include "mamba/core/progress_bar.hpp"
+
+namespace mamba
+{
+    TEST(progress_bar, multi_render)
+    {
+        auto& ctx = Context::instance();
+        bool no_progress_bars = ctx.no_progress_bars;
+        ctx.no_progress_bars = false;
+
+        MultiBarManager manager;
+        ProgressProxy a = manager.add_progress_bar("a", 0);
+        ProgressProxy b = manager.add_progress_bar("b", 0);
+
+        // the updates from the workers only change the state of the bars
+        std::thread worker([&]() {
+            a.set_progress(10, 100);
+            a.set_transfer(10, 100, 1);
+            b.set_progress(50, 100);
+            b.set_postfix("Extracting");
+        });
+        worker.join();
+
+        testing::internal::CaptureStdout();
+        manager.render(false);
+        std::string out = testing::internal::GetCapturedStdout();
+        EXPECT_NE(out.find("a  "), std::string::npos);
+        EXPECT_NE(out.find("10  B /    100  B"), std::string::npos);
+        EXPECT_NE(out.find("Extracting"), std::string::npos);
+
+        // a completed bar is drawn once with its final message, above the
+        // active ones
+        a.mark_as_completed("a is done");
+        testing::internal::CaptureStdout();
+        manager.render(false);
+        out = testing::internal::GetCapturedStdout();
+        EXPECT_LT(out.find("a is done"), out.find("Extracting"));
+
+        testing::internal::CaptureStdout();
+        manager.render(false);
+        out = testing::internal::GetCapturedStdout();
+        EXPECT_EQ(out.find("a is done"), std::string::npos);
+        EXPECT_NE(out.find("Extracting"), std::string::npos);
+
+        // activated and completed between two frames
+        b.mark_as_completed("b is done");
+        testing::internal::CaptureStdout();
+        manager.print("message", false);
+        out = testing::internal::GetCapturedStdout();
+        EXPECT_LT(out.find("b is done"), out.find("message"));
+
+        ctx.no_progress_bars = no_progress_bars;
+    }
+
+    TEST(progress_bar, aggregated_render)
+    {
+        auto& ctx = Context::instance();
+        bool no_progress_bars = ctx.no_progress_bars;
+        ctx.no_progress_bars = false;
+
+        AggregatedBarManager manager;
+        std::vector<ProgressProxy> bars;
+        for (int i = 0; i < 4; ++i)
+        {
+            bars.push_back(manager.add_progress_bar("pkg" + std::to_string(i), 100));
+        }
+
+        std::vector<std::thread> workers;
+        for (auto& bar : bars)
+        {
+            workers.emplace_back([&bar]() {
+                bar.set_progress(100, 100);
+                bar.mark_as_completed("Finished");
+                bar.mark_as_extracted();
+            });
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        testing::internal::CaptureStdout();
+        manager.render(false);
+        std::string out = testing::internal::GetCapturedStdout();
+        std::size_t finished = 0;
+        for (auto pos = out.find("Finished"); pos != std::string::npos;
+             pos = out.find("Finished", pos + 1))
+        {
+            ++finished;
+        }
+        EXPECT_EQ(finished, 4);
+        EXPECT_NE(out.find("Downloading"), std::string::npos);
+        EXPECT_NE(out.find("4 / 4"), std::string::npos);
+
+        // nothing left to draw
+        testing::internal::CaptureStdout();
+        manager.render(false);
+        out = testing::internal::GetCapturedStdout();
+        EXPECT_EQ(out.find("Downloading"), std::string::npos);
+
+        ctx.no_progress_bars = no_progress_bars;
+    }
+}  // namespace mamba
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include "mamba/core/pool.hpp"
+#include "mamba/core/query.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        // c -> b -> a, d -> a 0.1.0
+        const char* repodata = R"({
+            "info": { "subdir": "linux-64" },
+            "packages": {
+                "a-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": [],
+                    "name": "a", "version": "0.1.0", "subdir": "linux-64"
+                },
+                "b-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": ["a", "a >=0.1"],
+                    "name": "b", "version": "0.1.0", "subdir": "linux-64"
+                },
+                "c-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": ["b"],
+                    "name": "c", "version": "0.1.0", "subdir": "linux-64"
+                },
+                "d-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": ["a 0.1.0"],
+                    "name": "d", "version": "0.1.0", "subdir": "linux-64"
+                }
+            }
+        })";
+
+        std::set<std::string> names(const query_result& res)
+        {
+            std::set<std::string> names;
+            auto j = res.json();
+            for (const auto& pkg : j["result"]["pkgs"])
+            {
+                names.insert(pkg["name"].get<std::string>());
+            }
+            return names;
+        }
+    }
+
+    TEST(query, whoneeds)
+    {
+        TemporaryDirectory tmp_dir;
+        std::ofstream(tmp_dir.path() / "repodata.json") << repodata;
+        MPool pool;
+        MRepo repo(pool,
+                   "channel",
+                   tmp_dir.path() / "repodata.json",
+                   { "https://conda.anaconda.org/channel/linux-64/repodata.json", false, "", "" });
+        Query query(pool);
+
+        EXPECT_EQ(pool.whatrequires(pool_str2id(pool, "a", 0)).size(), 2);
+        EXPECT_TRUE(pool.whatrequires(pool_str2id(pool, "c", 0)).empty());
+
+        EXPECT_EQ(names(query.whoneeds("a", false)), std::set<std::string>({ "b", "d" }));
+        EXPECT_EQ(names(query.whoneeds("a >0.1.0", false)), std::set<std::string>({ "b" }));
+        EXPECT_EQ(names(query.whoneeds("a", true)),
+                  std::set<std::string>({ "a", "b", "c", "d" }));
+        EXPECT_EQ(names(query.whoneeds("b", true)), std::set<std::string>({ "b", "c" }));
+    }
+
+    TEST(query, depends)
+    {
+        TemporaryDirectory tmp_dir;
+        std::ofstream(tmp_dir.path() / "repodata.json") << repodata;
+        MPool pool;
+        MRepo repo(pool,
+                   "channel",
+                   tmp_dir.path() / "repodata.json",
+                   { "https://conda.anaconda.org/channel/linux-64/repodata.json", false, "", "" });
+        Query query(pool);
+
+        EXPECT_EQ(names(query.depends("c", false)), std::set<std::string>({ "b", "c" }));
+        EXPECT_EQ(names(query.depends("c", true)), std::set<std::string>({ "a", "b", "c" }));
+    }
+
+    TEST(query, render)
+    {
+        TemporaryDirectory tmp_dir;
+        std::ofstream(tmp_dir.path() / "repodata.json") << repodata;
+        MPool pool;
+        MRepo repo(pool,
+                   "channel",
+                   tmp_dir.path() / "repodata.json",
+                   { "https://conda.anaconda.org/channel/linux-64/repodata.json", false, "", "" });
+        Query query(pool);
+
+        std::stringstream tree;
+        query.depends("c", true).tree(tree);
+        EXPECT_EQ(tree.str(),
+                  "c[0.1.0]\n  └─ b[0.1.0]\n     └─ a[0.1.0]\n"
+                  "     └─ \033[2ma already visited\033[00m\n");
+
+        auto res = query.whoneeds("a", false);
+        res.sort("name");
+        auto j = res.json();
+        ASSERT_EQ(j["result"]["pkgs"].size(), 2);
+        EXPECT_EQ(j["result"]["pkgs"][0]["name"], "b");
+        EXPECT_EQ(j["result"]["pkgs"][0]["channel"],
+                  "https://conda.anaconda.org/channel/linux-64");
+        EXPECT_EQ(j["result"]["pkgs"][0]["depends"],
+                  nlohmann::json::array({ "a", "a >=0.1" }));
+        EXPECT_EQ(j["result"]["pkgs"][1]["name"], "d");
+
+        // a copy keeps its own ordering
+        auto copy = res;
+        copy.reset().groupby("name").sort("version");
+        EXPECT_EQ(copy.json()["result"]["pkgs"], j["result"]["pkgs"]);
+
+        std::stringstream missing;
+        std::ofstream(tmp_dir.path() / "missing.json") << R"({
+            "info": { "subdir": "linux-64" },
+            "packages": {
+                "e-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": ["f"],
+                    "name": "e", "version": "0.1.0", "subdir": "linux-64"
+                }
+            }
+        })";
+        MRepo other(pool,
+                    "other",
+                    tmp_dir.path() / "missing.json",
+                    { "https://conda.anaconda.org/other/linux-64/repodata.json", false, "", "" });
+        pool.create_whatprovides();
+        query.depends("e", true).tree(missing);
+        EXPECT_EQ(missing.str(), "e[0.1.0]\n  └─ f >>> NOT FOUND <<<\n");
+    }
+}  // namespace mamba
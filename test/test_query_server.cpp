@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "mamba/core/context.hpp"
+#include "mamba/core/query_server.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        void write_repodata(const fs::path& channel, const std::string& platform, bool with_b)
+        {
+            fs::create_directories(channel / platform);
+            std::string packages = R"(
+                "a-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": [],
+                    "name": "a", "version": "0.1.0", "subdir": ")"
+                                   + platform + R"("
+                })";
+            if (with_b)
+            {
+                packages += R"(,
+                "b-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": ["a"],
+                    "name": "b", "version": "0.1.0", "subdir": ")"
+                            + platform + R"("
+                })";
+            }
+            std::ofstream(channel / platform / "repodata.json")
+                << R"({ "info": { "subdir": ")" << platform << R"(" }, "packages": {)" << packages
+                << "} }";
+        }
+
+        class QueryServerTest : public ::testing::Test
+        {
+        protected:
+            QueryServerTest()
+                : pkgs_dirs(Context::instance().pkgs_dirs)
+            {
+                Context::instance().pkgs_dirs = { tmp_dir.path() / "pkgs" };
+                write_repodata(channel(), Context::instance().platform, false);
+                write_repodata(channel(), "noarch", false);
+            }
+
+            ~QueryServerTest()
+            {
+                Context::instance().pkgs_dirs = pkgs_dirs;
+            }
+
+            fs::path channel()
+            {
+                return tmp_dir.path() / "channel";
+            }
+
+            std::string request(const std::string& type, const std::string& query)
+            {
+                return nlohmann::json({ { "type", type },
+                                        { "query", query },
+                                        { "channels", { "file://" + channel().string() } } })
+                    .dump();
+            }
+
+            TemporaryDirectory tmp_dir;
+            std::vector<fs::path> pkgs_dirs;
+        };
+
+#ifndef _WIN32
+        int connect(const fs::path& socket_path)
+        {
+            int client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+            for (int i = 0; i < 100; ++i)
+            {
+                if (::connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+                {
+                    // a test never waits forever on the server
+                    timeval timeout{ 10, 0 };
+                    ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                    return client;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+            ::close(client);
+            return -1;
+        }
+
+        // the answer of a request, empty when the server closed the connection
+        std::string send_request(int client, const std::string& request)
+        {
+            std::string data = request + "\n";
+            if (::send(client, data.data(), data.size(), 0) != static_cast<ssize_t>(data.size()))
+            {
+                return "";
+            }
+            std::string answer;
+            char c;
+            while (::recv(client, &c, 1, 0) == 1 && c != '\n')
+            {
+                answer += c;
+            }
+            return answer;
+        }
+#endif
+    }
+
+    TEST_F(QueryServerTest, handle)
+    {
+        QueryServer server;
+        auto res = nlohmann::json::parse(server.handle(request("find", "a")));
+        EXPECT_EQ(res["result"]["status"], "OK");
+        EXPECT_EQ(res["result"]["pkgs"].size(), 2);
+
+        res = nlohmann::json::parse(server.handle(request("whoneeds", "a")));
+        EXPECT_EQ(res["result"]["pkgs"].size(), 0);
+        EXPECT_EQ(server.pool_count(), 1);
+
+        // new repodata, only read on reload
+        write_repodata(channel(), "noarch", true);
+        res = nlohmann::json::parse(server.handle(request("whoneeds", "a")));
+        EXPECT_EQ(res["result"]["pkgs"].size(), 0);
+        res = nlohmann::json::parse(server.handle(R"({"type": "reload"})"));
+        EXPECT_EQ(res["result"]["status"], "OK");
+        res = nlohmann::json::parse(server.handle(request("whoneeds", "a")));
+        ASSERT_EQ(res["result"]["pkgs"].size(), 1);
+        EXPECT_EQ(res["result"]["pkgs"][0]["name"], "b");
+        EXPECT_EQ(server.pool_count(), 1);
+
+        res = nlohmann::json::parse(server.handle(request("unknown", "a")));
+        EXPECT_EQ(res["result"]["status"], "ERROR");
+        res = nlohmann::json::parse(server.handle("not json"));
+        EXPECT_EQ(res["result"]["status"], "ERROR");
+    }
+
+    TEST_F(QueryServerTest, failed_reload)
+    {
+        QueryServer server;
+        auto res = nlohmann::json::parse(server.handle(request("find", "a")));
+        EXPECT_EQ(res["result"]["pkgs"].size(), 2);
+
+        // the pool is kept when its new repodata can't be loaded
+        write_repodata(channel(), "noarch", true);
+        std::ofstream(channel() / "noarch" / "repodata.json") << "{ broken";
+        res = nlohmann::json::parse(server.handle(R"({"type": "reload"})"));
+        EXPECT_EQ(res["result"]["status"], "ERROR");
+        res = nlohmann::json::parse(server.handle(request("find", "a")));
+        EXPECT_EQ(res["result"]["status"], "OK");
+        EXPECT_EQ(res["result"]["pkgs"].size(), 2);
+        EXPECT_EQ(server.pool_count(), 1);
+
+        // and none is kept when the first load fails
+        fs::path other = tmp_dir.path() / "other";
+        write_repodata(other, Context::instance().platform, false);
+        write_repodata(other, "noarch", false);
+        std::ofstream(other / "noarch" / "repodata.json") << "{ broken";
+        std::string broken = nlohmann::json({ { "type", "find" },
+                                              { "query", "a" },
+                                              { "channels", { "file://" + other.string() } } })
+                                 .dump();
+        for (int i = 0; i < 2; ++i)
+        {
+            res = nlohmann::json::parse(server.handle(broken));
+            EXPECT_EQ(res["result"]["status"], "ERROR");
+        }
+        EXPECT_EQ(server.pool_count(), 1);
+    }
+
+#ifndef _WIN32
+    TEST_F(QueryServerTest, serve)
+    {
+        auto channels = Context::instance().channels;
+        Context::instance().channels = { "file://" + channel().string() };
+        fs::path socket_path = tmp_dir.path() / "query.sock";
+        QueryServer server;
+        std::thread serving([&]() { server.serve(socket_path, std::chrono::milliseconds(300)); });
+
+        // an idle client doesn't hold the others
+        int idle = connect(socket_path);
+        ASSERT_GE(idle, 0);
+        int client = connect(socket_path);
+        ASSERT_GE(client, 0);
+        // the pool of the configured channels is loaded at startup, before the
+        // socket accepts clients, so repodata written now is not seen
+        write_repodata(channel(), "noarch", true);
+        auto res = nlohmann::json::parse(send_request(client, R"({"type": "find", "query": "a"})"));
+        EXPECT_EQ(res["result"]["status"], "OK");
+        EXPECT_EQ(res["result"]["pkgs"].size(), 2);
+        res = nlohmann::json::parse(send_request(client, R"({"type": "find", "query": "b"})"));
+        EXPECT_EQ(res["result"]["pkgs"].size(), 0);
+
+        // and is closed after the idle timeout
+        char c;
+        EXPECT_EQ(::recv(idle, &c, 1, 0), 0);
+        ::close(idle);
+        ::close(client);
+
+        client = connect(socket_path);
+        ASSERT_GE(client, 0);
+        res = nlohmann::json::parse(send_request(client, R"({"type": "shutdown"})"));
+        EXPECT_EQ(res["result"]["status"], "OK");
+        EXPECT_EQ(::recv(client, &c, 1, 0), 0);
+        ::close(client);
+        serving.join();
+        EXPECT_FALSE(fs::exists(socket_path));
+        EXPECT_EQ(server.pool_count(), 1);
+        Context::instance().channels = channels;
+    }
+
+    TEST_F(QueryServerTest, serve_not_a_socket)
+    {
+        fs::path file = tmp_dir.path() / "file.txt";
+        std::ofstream(file) << "content";
+        QueryServer server;
+        EXPECT_THROW(server.serve(file), std::runtime_error);
+        EXPECT_EQ(read_contents(file), "content");
+    }
+#endif
+}  // namespace mamba
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include "mamba/core/context.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/prefix_data.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/solution_cache.hpp"
+#include "mamba/core/solver.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        const char* repodata = R"({
+            "info": { "subdir": "linux-64" },
+            "packages": {
+                "a-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": [],
+                    "name": "a", "version": "0.1.0", "subdir": "linux-64"
+                },
+                "a-0.2.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": [],
+                    "name": "a", "version": "0.2.0", "subdir": "linux-64"
+                },
+                "b-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": ["a"],
+                    "name": "b", "version": "0.1.0", "subdir": "linux-64"
+                }
+            }
+        })";
+
+        // (solvable, type) steps of the transaction
+        std::vector<std::pair<Id, Id>> solve(MPool& pool,
+                                             const std::string& spec,
+                                             bool& from_cache)
+        {
+            MSolver solver(pool, { { SOLVER_FLAG_ALLOW_DOWNGRADE, 1 } });
+            solver.add_jobs({ spec }, SOLVER_INSTALL);
+            EXPECT_TRUE(solver.solve());
+            from_cache = solver.from_cache();
+
+            // without libsolv solver, the accessors of a cached solution don't crash
+            if (from_cache)
+            {
+                EXPECT_EQ(solver.problems_to_str(), "");
+                EXPECT_THROW(static_cast<Solver*>(solver), std::runtime_error);
+            }
+            else
+            {
+                EXPECT_NE(static_cast<Solver*>(solver), nullptr);
+            }
+
+            Transaction* transaction = solver.create_transaction();
+            transaction_order(transaction, 0);
+            std::vector<std::pair<Id, Id>> res;
+            for (int i = 0; i < transaction->steps.count; ++i)
+            {
+                Id p = transaction->steps.elements[i];
+                res.emplace_back(p,
+                                 transaction_type(transaction, p, SOLVER_TRANSACTION_SHOW_ALL));
+            }
+            transaction_free(transaction);
+            return res;
+        }
+    }
+
+    TEST(solution_cache, reuse_solution)
+    {
+        TemporaryDirectory tmp_dir;
+        auto& ctx = Context::instance();
+        auto pkgs_dirs = ctx.pkgs_dirs;
+        ctx.pkgs_dirs = { tmp_dir.path() / "pkgs" };
+        ctx.solution_cache = true;
+
+        std::ofstream(tmp_dir.path() / "repodata.json") << repodata;
+        MPool pool;
+        MRepo repo(pool,
+                   "channel",
+                   tmp_dir.path() / "repodata.json",
+                   { "https://conda.anaconda.org/channel/linux-64/repodata.json",
+                     false,
+                     "etag",
+                     "mod" });
+
+        bool from_cache;
+        auto solved = solve(pool, "b", from_cache);
+        EXPECT_FALSE(from_cache);
+        EXPECT_EQ(solved.size(), 2);
+
+        auto cached = solve(pool, "b", from_cache);
+        EXPECT_TRUE(from_cache);
+        EXPECT_EQ(cached, solved);
+
+        solve(pool, "a 0.1.0", from_cache);
+        EXPECT_FALSE(from_cache);
+
+        ctx.pkgs_dirs = pkgs_dirs;
+        ctx.solution_cache = false;
+    }
+
+    TEST(solution_cache, installed_packages)
+    {
+        TemporaryDirectory tmp_dir;
+        auto& ctx = Context::instance();
+        auto pkgs_dirs = ctx.pkgs_dirs;
+        ctx.pkgs_dirs = { tmp_dir.path() / "pkgs" };
+        ctx.solution_cache = true;
+
+        std::ofstream(tmp_dir.path() / "repodata.json") << repodata;
+        MPool pool;
+        MRepo repo(pool,
+                   "channel",
+                   tmp_dir.path() / "repodata.json",
+                   { "https://conda.anaconda.org/channel/linux-64/repodata.json",
+                     false,
+                     "etag",
+                     "mod" });
+
+        PrefixData prefix_data(tmp_dir.path() / "prefix");
+        PackageInfo installed_a("a", "0.1.0", "abc", 0);
+        installed_a.subdir = "linux-64";
+        installed_a.fn = "a-0.1.0-abc.tar.bz2";
+        prefix_data.m_package_records.insert({ "a", installed_a });
+        MRepo installed(pool, prefix_data);
+
+        // the erased installed package is not part of the cached solution
+        bool from_cache;
+        auto solved = solve(pool, "a 0.2.0", from_cache);
+        EXPECT_FALSE(from_cache);
+        auto cached = solve(pool, "a 0.2.0", from_cache);
+        EXPECT_TRUE(from_cache);
+        EXPECT_EQ(cached, solved);
+        ASSERT_EQ(solved.size(), 2);
+        EXPECT_TRUE(solved[0].second == SOLVER_TRANSACTION_UPGRADED
+                    || solved[1].second == SOLVER_TRANSACTION_UPGRADED);
+
+        ctx.pkgs_dirs = pkgs_dirs;
+        ctx.solution_cache = false;
+    }
+
+    TEST(solution_cache, key)
+    {
+        MPool pool;
+        Queue jobs;
+        queue_init(&jobs);
+        auto key = SolutionCache::key(pool, jobs, {});
+        EXPECT_EQ(key.size(), 64);
+        EXPECT_EQ(key, SolutionCache::key(pool, jobs, {}));
+        EXPECT_NE(key, SolutionCache::key(pool, jobs, { { SOLVER_FLAG_ALLOW_DOWNGRADE, 1 } }));
+
+        queue_push2(&jobs, SOLVER_INSTALL | SOLVER_SOLVABLE_PROVIDES, pool_str2id(pool, "a", 1));
+        EXPECT_NE(key, SolutionCache::key(pool, jobs, {}));
+        queue_free(&jobs);
+    }
+}  // namespace mamba
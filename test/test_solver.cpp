@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+
+#include "mamba/core/channel.hpp"
+#include "mamba/core/pool.hpp"
+#include "mamba/core/prefix_data.hpp"
+#include "mamba/core/repo.hpp"
+#include "mamba/core/solver.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        const char* repodata = R"({
+            "info": { "subdir": "linux-64" },
+            "packages": {
+                "a-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": [],
+                    "name": "a", "version": "0.1.0", "subdir": "linux-64"
+                }
+            }
+        })";
+    }
+
+    TEST(solver, channel_specific_job)
+    {
+        TemporaryDirectory tmp_dir;
+        std::ofstream(tmp_dir.path() / "repodata.json") << repodata;
+
+        MPool pool;
+        MRepo first(pool,
+                    "first",
+                    tmp_dir.path() / "repodata.json",
+                    { "https://conda.anaconda.org/first/linux-64/repodata.json", false, "", "" });
+        MRepo second(pool,
+                     "second",
+                     tmp_dir.path() / "repodata.json",
+                     { "https://conda.anaconda.org/second/linux-64/repodata.json", false, "", "" });
+
+        EXPECT_EQ(pool.repo_channel(first.repo()),
+                  &make_channel("https://conda.anaconda.org/first/linux-64"));
+        EXPECT_NE(pool.repo_channel(first.repo()), pool.repo_channel(second.repo()));
+
+        for (auto* repo : { first.repo(), second.repo() })
+        {
+            MSolver solver(pool);
+            solver.add_jobs({ concat(repo == first.repo() ? "first" : "second", "::a") },
+                            SOLVER_INSTALL);
+            ASSERT_TRUE(solver.solve());
+
+            Transaction* transaction = solver.create_transaction();
+            ASSERT_EQ(transaction->steps.count, 1);
+            EXPECT_EQ(pool_id2solvable(pool, transaction->steps.elements[0])->repo, repo);
+            transaction_free(transaction);
+        }
+    }
+
+    TEST(solver, stats)
+    {
+        TemporaryDirectory tmp_dir;
+        std::ofstream(tmp_dir.path() / "repodata.json") << repodata;
+
+        MPool pool;
+        MRepo repo(pool,
+                   "channel",
+                   tmp_dir.path() / "repodata.json",
+                   { "https://conda.anaconda.org/channel/linux-64/repodata.json", false, "", "" });
+
+        // the debug settings of the pool are kept, its messages still reach the callback
+        Pool* p = pool;
+        int messages = 0;
+        auto callback = [](Pool*, void* data, int, const char*) { ++*static_cast<int*>(data); };
+        pool_setdebugcallback(p, callback, &messages);
+        int debugmask = p->debugmask |= SOLV_DEBUG_STATS;
+
+        MSolver solver(pool);
+        solver.add_jobs({ "a" }, SOLVER_INSTALL);
+        ASSERT_TRUE(solver.solve());
+        EXPECT_GT(messages, 0);
+        EXPECT_EQ(p->debugcallbackdata, &messages);
+        EXPECT_EQ(p->debugmask, debugmask);
+        pool_setdebugcallback(p, nullptr, nullptr);
+
+        const auto& stats = solver.stats();
+        EXPECT_GT(stats.pool_creation, 0);
+        EXPECT_GE(stats.solving, 0);
+        // the system solvable and a
+        EXPECT_EQ(stats.solvables, 3);
+        EXPECT_GT(stats.rules, 0);
+        EXPECT_LE(stats.learnt_rules, stats.rules);
+        EXPECT_GT(stats.decisions, 0);
+        EXPECT_EQ(stats.to_json()["decisions"], stats.decisions);
+    }
+
+    TEST(solver, prune_incompatible)
+    {
+        TemporaryDirectory tmp_dir;
+        std::ofstream(tmp_dir.path() / "repodata.json") << R"({
+            "info": { "subdir": "linux-64" },
+            "packages": {
+                "a-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": ["__glibc >=2.17"],
+                    "name": "a", "version": "0.1.0", "subdir": "linux-64"
+                },
+                "a-0.2.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": ["__glibc >=2.99"],
+                    "name": "a", "version": "0.2.0", "subdir": "linux-64"
+                },
+                "c-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": ["__cuda"],
+                    "name": "c", "version": "0.1.0", "subdir": "linux-64"
+                },
+                "d-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": [],
+                    "name": "d", "version": "0.1.0", "subdir": "linux-64"
+                },
+                "d-0.2.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": [],
+                    "name": "d", "version": "0.2.0", "subdir": "linux-64"
+                }
+            }
+        })";
+
+        MPool pool;
+        MRepo repo(pool,
+                   "channel",
+                   tmp_dir.path() / "repodata.json",
+                   { "https://conda.anaconda.org/channel/linux-64/repodata.json", false, "", "" });
+        PrefixData prefix_data(tmp_dir.path() / "prefix");
+        prefix_data.add_virtual_packages({ PackageInfo("__glibc", "2.31", "0", 0) });
+        MRepo installed(pool, prefix_data);
+
+        // a 0.2.0, c and d 0.2.0
+        EXPECT_EQ(pool.prune_incompatible({ "d 0.1.0" }), 3);
+
+        MSolver solver(pool);
+        EXPECT_EQ(solver.stats().pruned_solvables, 3);
+        solver.add_jobs({ "a", "d" }, SOLVER_INSTALL);
+        ASSERT_TRUE(solver.solve());
+
+        Transaction* transaction = solver.create_transaction();
+        std::set<std::string> installed_versions;
+        for (int i = 0; i < transaction->steps.count; ++i)
+        {
+            Solvable* s = pool_id2solvable(pool, transaction->steps.elements[i]);
+            installed_versions.insert(
+                concat(pool_id2str(pool, s->name), " ", pool_id2str(pool, s->evr)));
+        }
+        transaction_free(transaction);
+        EXPECT_EQ(installed_versions, std::set<std::string>({ "a 0.1.0", "d 0.1.0" }));
+    }
+
+    TEST(solver, prune_unreachable)
+    {
+        TemporaryDirectory tmp_dir;
+        std::ofstream(tmp_dir.path() / "repodata.json") << R"({
+            "info": { "subdir": "linux-64" },
+            "packages": {
+                "a-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": [],
+                    "name": "a", "version": "0.1.0", "subdir": "linux-64"
+                },
+                "b-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": ["a >=0.1"],
+                    "name": "b", "version": "0.1.0", "subdir": "linux-64"
+                },
+                "c-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": ["d"],
+                    "name": "c", "version": "0.1.0", "subdir": "linux-64"
+                },
+                "d-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": [],
+                    "name": "d", "version": "0.1.0", "subdir": "linux-64"
+                },
+                "e-0.2.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": [], "constrains": ["f <1"],
+                    "name": "e", "version": "0.2.0", "subdir": "linux-64"
+                },
+                "f-0.1.0-abc.tar.bz2": {
+                    "build": "abc", "build_number": 0, "depends": [],
+                    "name": "f", "version": "0.1.0", "subdir": "linux-64"
+                }
+            }
+        })";
+
+        MPool pool;
+        MRepo repo(pool,
+                   "channel",
+                   tmp_dir.path() / "repodata.json",
+                   { "https://conda.anaconda.org/channel/linux-64/repodata.json", false, "", "" });
+        PrefixData prefix_data(tmp_dir.path() / "prefix");
+        prefix_data.m_package_records.insert({ "e", PackageInfo("e", "0.1.0", "abc", 0) });
+        MRepo installed(pool, prefix_data);
+
+        // c and d, f is reached through the constraints of e
+        EXPECT_EQ(pool.prune_unreachable({ "b" }), 2);
+
+        MSolver solver(pool);
+        solver.add_jobs({ "b" }, SOLVER_INSTALL);
+        ASSERT_TRUE(solver.solve());
+        EXPECT_EQ(solver.stats().pruned_solvables, 2);
+
+        MSolver unreachable(pool);
+        unreachable.add_jobs({ "c" }, SOLVER_INSTALL);
+        EXPECT_FALSE(unreachable.solve());
+    }
+}  // namespace mamba
@@ -13,6 +13,18 @@ namespace mamba
         // EXPECT_EQ(to_lower(a), "thisisarandomttteeessst");
     }
 
+    TEST(util, parse_human_readable_filesize)
+    {
+        EXPECT_EQ(parse_human_readable_filesize("512"), 512);
+        EXPECT_EQ(parse_human_readable_filesize("2K"), 2048);
+        EXPECT_EQ(parse_human_readable_filesize("1.5kb"), 1536);
+        EXPECT_EQ(parse_human_readable_filesize(" 3M "), 3 * 1024 * 1024);
+        EXPECT_EQ(parse_human_readable_filesize("20GB"), std::size_t(20) * 1024 * 1024 * 1024);
+        EXPECT_THROW(parse_human_readable_filesize(""), std::runtime_error);
+        EXPECT_THROW(parse_human_readable_filesize("12X"), std::runtime_error);
+        EXPECT_THROW(parse_human_readable_filesize("-1G"), std::runtime_error);
+    }
+
     TEST(util, split)
     {
         std::string a = "hello.again.it's.me.mario";
@@ -79,4 +79,31 @@ namespace mamba
         EXPECT_EQ(res2, 5);
     }
 #endif
+
+    TEST(thread_utils, parallel_for)
+    {
+        std::vector<int> res(1000, 0);
+        parallel_for(res.size(), 4, [&res](std::size_t i) { res[i] = static_cast<int>(i); });
+        for (std::size_t i = 0; i < res.size(); ++i)
+        {
+            EXPECT_EQ(res[i], static_cast<int>(i));
+        }
+
+        std::atomic<int> count(0);
+        parallel_for(10, 0, [&count](std::size_t) {
+            parallel_for(10, 0, [&count](std::size_t) { ++count; });
+        });
+        EXPECT_EQ(count.load(), 100);
+    }
+
+    TEST(thread_utils, parallel_for_exception)
+    {
+        EXPECT_THROW(parallel_for(100,
+                                  4,
+                                  [](std::size_t i) {
+                                      if (i == 42)
+                                          throw std::runtime_error("error");
+                                  }),
+                     std::runtime_error);
+    }
 }  // namespace mamba
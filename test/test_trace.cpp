@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <thread>
+
+#include "mamba/core/trace.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    TEST(trace, disabled)
+    {
+        TraceSpan span("test", "disabled");
+        span.arg("size", 1);
+        EXPECT_FALSE(span.active());
+    }
+
+    TEST(trace, chrome_trace)
+    {
+        TemporaryDirectory tmp_dir;
+        fs::path trace_file = tmp_dir.path() / "trace.json";
+        auto& tracer = Tracer::instance();
+        tracer.start(trace_file);
+        {
+            TraceSpan span("test", "outer");
+            span.arg("size", 42);
+            EXPECT_TRUE(span.active());
+            std::thread([]() { TraceSpan("test", "inner"); }).join();
+
+            auto end = Tracer::clock::now();
+            tracer.async("download", "pkg", end - std::chrono::milliseconds(5), end);
+        }
+        tracer.stop();
+        EXPECT_FALSE(tracer.enabled());
+
+        nlohmann::json j;
+        std::ifstream(trace_file) >> j;
+        std::map<std::string, nlohmann::json> spans;
+        std::size_t async_events = 0;
+        for (const auto& event : j["traceEvents"])
+        {
+            if (event["ph"] == "X")
+            {
+                spans[event["name"]] = event;
+            }
+            else if (event["ph"] == "b" || event["ph"] == "e")
+            {
+                EXPECT_EQ(event["name"], "pkg");
+                ++async_events;
+            }
+        }
+        EXPECT_EQ(async_events, 2);
+        ASSERT_EQ(spans.size(), 2);
+        EXPECT_EQ(spans["outer"]["args"]["size"], 42);
+        EXPECT_NE(spans["outer"]["tid"], spans["inner"]["tid"]);
+        EXPECT_LE(spans["outer"]["ts"].get<double>(), spans["inner"]["ts"].get<double>());
+        EXPECT_GE(spans["outer"]["dur"].get<double>(), spans["inner"]["dur"].get<double>());
+    }
+}  // namespace mamba
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#include <future>
+
+#include "mamba/core/prefix_data.hpp"
+#include "mamba/core/transaction_journal.hpp"
+#include "mamba/core/util.hpp"
+
+namespace mamba
+{
+    namespace
+    {
+        void write_file(const fs::path& path, const std::string& content)
+        {
+            fs::create_directories(path.parent_path());
+            std::ofstream f(path);
+            f << content;
+        }
+
+        std::string read_file(const fs::path& path)
+        {
+            std::ifstream f(path);
+            std::string content;
+            std::getline(f, content);
+            return content;
+        }
+
+        // Removes a.txt, overwrites b.txt and creates c.txt
+        void change_prefix(TransactionJournal& journal, const fs::path& prefix)
+        {
+            journal.remove(prefix / "lib" / "a.txt");
+            journal.create(prefix / "lib" / "b.txt");
+            write_file(prefix / "lib" / "b.txt", "new b");
+            journal.create(prefix / "lib" / "new" / "c.txt");
+            write_file(prefix / "lib" / "new" / "c.txt", "c");
+        }
+
+        void expect_initial_state(const fs::path& prefix)
+        {
+            EXPECT_EQ(read_file(prefix / "lib" / "a.txt"), "a");
+            EXPECT_EQ(read_file(prefix / "lib" / "b.txt"), "b");
+            EXPECT_FALSE(fs::exists(prefix / "lib" / "new"));
+            EXPECT_FALSE(fs::exists(TransactionJournal::journal_dir(prefix)));
+        }
+    }
+
+    class TransactionJournalTest : public ::testing::Test
+    {
+    protected:
+        TransactionJournalTest()
+        {
+            write_file(prefix / "lib" / "a.txt", "a");
+            write_file(prefix / "lib" / "b.txt", "b");
+            fs::create_directories(prefix / "conda-meta");
+        }
+
+        TemporaryDirectory tmp_dir;
+        fs::path prefix = tmp_dir.path();
+    };
+
+    TEST_F(TransactionJournalTest, rollback)
+    {
+        TransactionJournal journal(prefix);
+        change_prefix(journal, prefix);
+        EXPECT_FALSE(fs::exists(prefix / "lib" / "a.txt"));
+
+        journal.rollback();
+        expect_initial_state(prefix);
+    }
+
+    TEST_F(TransactionJournalTest, commit)
+    {
+        {
+            TransactionJournal journal(prefix);
+            change_prefix(journal, prefix);
+            journal.commit();
+        }
+        EXPECT_FALSE(fs::exists(prefix / "lib" / "a.txt"));
+        EXPECT_EQ(read_file(prefix / "lib" / "b.txt"), "new b");
+        EXPECT_EQ(read_file(prefix / "lib" / "new" / "c.txt"), "c");
+        EXPECT_FALSE(fs::exists(TransactionJournal::journal_dir(prefix)));
+        EXPECT_FALSE(TransactionJournal::recover(prefix));
+    }
+
+    TEST_F(TransactionJournalTest, rollback_when_not_committed)
+    {
+        {
+            TransactionJournal journal(prefix);
+            change_prefix(journal, prefix);
+        }
+        expect_initial_state(prefix);
+    }
+
+    TEST_F(TransactionJournalTest, recover)
+    {
+        // the state of the prefix when the process died
+        TemporaryDirectory crashed_dir;
+        fs::path crashed = crashed_dir.path() / "crashed";
+        {
+            TransactionJournal journal(prefix);
+            change_prefix(journal, prefix);
+            fs::copy(prefix, crashed, fs::copy_options::recursive);
+        }
+
+        // loading the prefix does not roll back
+        PrefixData prefix_data(crashed.string());
+        prefix_data.load();
+        EXPECT_TRUE(TransactionJournal::pending(crashed));
+
+        EXPECT_TRUE(TransactionJournal::recover(crashed));
+        expect_initial_state(crashed);
+        EXPECT_FALSE(TransactionJournal::pending(crashed));
+    }
+
+    TEST_F(TransactionJournalTest, recover_waits_for_transaction)
+    {
+        auto journal = std::make_unique<TransactionJournal>(prefix);
+        change_prefix(*journal, prefix);
+
+        // a recovery from another thread of the process does not see the
+        // running transaction as interrupted
+        auto recovered = std::async(std::launch::async,
+                                    [this]() { return TransactionJournal::recover(prefix); });
+        EXPECT_EQ(recovered.wait_for(std::chrono::milliseconds(200)),
+                  std::future_status::timeout);
+        journal->commit();
+        EXPECT_FALSE(recovered.get());
+        EXPECT_EQ(read_file(prefix / "lib" / "new" / "c.txt"), "c");
+
+        // the lock file is kept for the processes waiting on it
+        EXPECT_TRUE(fs::exists(prefix / "conda-meta" / ".transaction.lock"));
+    }
+
+    TEST_F(TransactionJournalTest, rollback_created_directories)
+    {
+        {
+            TransactionJournal journal(prefix);
+            change_prefix(journal, prefix);
+            // not journaled, e.g. written by a post-link script
+            write_file(prefix / "lib" / "new" / "sub" / "cache.txt", "cache");
+        }
+        expect_initial_state(prefix);
+    }
+}  // namespace mamba